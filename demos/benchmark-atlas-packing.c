@@ -0,0 +1,153 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "freetype-gl.h"
+
+
+// ------------------------------------------------------- global variables ---
+const char * font_filename = "fonts/Liberastika-Regular.ttf";
+const size_t atlas_size = 4096;
+const int min_size = 8;
+const int max_size = 48;
+
+
+// ------------------------------------------------------------ trace_fonts ---
+// Record the bitmap size of every glyph of a face, for a range of sizes,
+// in the order a text would most likely request them.
+ivec2 * trace_fonts( const char * filename, size_t * count )
+{
+    FT_Library library;
+    FT_Face face;
+    FT_ULong charcode;
+    FT_UInt gindex;
+    ivec2 * trace = NULL;
+    size_t capacity = 0;
+    int size;
+
+    *count = 0;
+    if( FT_Init_FreeType( &library ) )
+        return NULL;
+    if( FT_New_Face( library, filename, 0, &face ) )
+    {
+        FT_Done_FreeType( library );
+        return NULL;
+    }
+
+    for( size = min_size; size <= max_size; size += 2 )
+    {
+        FT_Set_Char_Size( face, size * 64, 0, 72, 72 );
+        charcode = FT_Get_First_Char( face, &gindex );
+        while( gindex )
+        {
+            if( !FT_Load_Glyph( face, gindex, FT_LOAD_DEFAULT ) )
+            {
+                if( *count == capacity )
+                {
+                    capacity = capacity ? 2 * capacity : 1024;
+                    trace = realloc( trace, capacity * sizeof(ivec2) );
+                }
+                // Same one pixel padding as texture_font_load_glyph_gi
+                trace[*count].x = ((face->glyph->metrics.width + 63) >> 6) + 1;
+                trace[*count].y = ((face->glyph->metrics.height + 63) >> 6) + 1;
+                ++*count;
+            }
+            charcode = FT_Get_Next_Char( face, charcode, &gindex );
+        }
+    }
+    FT_Done_Face( face );
+    FT_Done_FreeType( library );
+    return trace;
+}
+
+
+// ------------------------------------------------------------- read_trace ---
+// Read a trace of "width height" lines.
+ivec2 * read_trace( const char * filename, size_t * count )
+{
+    FILE * file = fopen( filename, "r" );
+    ivec2 * trace = NULL, region;
+    size_t capacity = 0;
+
+    *count = 0;
+    if( !file )
+        return NULL;
+    while( fscanf( file, "%d %d", &region.x, &region.y ) == 2 )
+    {
+        if( *count == capacity )
+        {
+            capacity = capacity ? 2 * capacity : 1024;
+            trace = realloc( trace, capacity * sizeof(ivec2) );
+        }
+        trace[(*count)++] = region;
+    }
+    fclose( file );
+    return trace;
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv )
+{
+    texture_atlas_t * atlas;
+    ivec2 * trace;
+    ivec4 region;
+    size_t count, i, placed = 0, top = 0;
+    unsigned long checksum = 0;
+    clock_t start;
+    double elapsed;
+
+    if( argc > 1 )
+    {
+        trace = read_trace( argv[1], &count );
+        printf( "Trace                   : %s\n", argv[1] );
+    }
+    else
+    {
+        trace = trace_fonts( font_filename, &count );
+        printf( "Trace                   : %s, %d to %dpt\n",
+                font_filename, min_size, max_size );
+    }
+    if( !trace )
+    {
+        fprintf( stderr, "Cannot read trace\n" );
+        return EXIT_FAILURE;
+    }
+
+    atlas = texture_atlas_new( atlas_size, atlas_size, 1 );
+    start = clock( );
+    for( i = 0; i < count; ++i )
+    {
+        region = texture_atlas_get_region( atlas, trace[i].x, trace[i].y );
+        if( region.x < 0 )
+            continue;
+        placed++;
+        if( (size_t)(region.y + region.height) > top )
+            top = region.y + region.height;
+        checksum = checksum * 31 + region.x * 4099 + region.y;
+    }
+    elapsed = (double)(clock( ) - start) / CLOCKS_PER_SEC;
+
+    printf( "Regions                 : %zu placed, %zu rejected\n",
+            placed, count - placed );
+    printf( "Atlas                   : %zux%zu, %zu rows used\n",
+            atlas->width, atlas->height, top );
+    printf( "Occupancy               : %.2f%% of used rows\n",
+            100.0 * atlas->used / (double)(atlas->width * top) );
+    printf( "Placement checksum      : %08lx\n", checksum & 0xFFFFFFFFul );
+    printf( "Time                    : %.3f s (%.2f us per region)\n",
+            elapsed, elapsed * 1e6 / count );
+
+    texture_atlas_delete( atlas );
+    free( trace );
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freetype-gl.h"
+#include "vertex-buffer.h"
+
+
+// ------------------------------------------------------- global variables ---
+const size_t widget_count = 10000;
+const size_t frame_count = 200;
+
+
+// -------------------------------------------------------------- push_quad ---
+void push_quad( vertex_buffer_t * buffer, size_t id )
+{
+    float x = (float) ( id % 100 ), y = (float) ( id / 100 ), z = (float) id;
+    float quad[4][3] = { {x,y,z}, {x,y+1,z}, {x+1,y+1,z}, {x+1,y,z} };
+    GLuint indices[6] = { 0,1,2, 0,2,3 };
+
+    vertex_buffer_push_back( buffer, quad, 4, indices, 6 );
+}
+
+
+// -------------------------------------------------------------- same_draw ---
+// Whether the draws of a batch read the indices of its items, in order,
+// with the same base vertices
+int same_draw( vertex_buffer_batch_t * batch, const vertex_buffer_t * buffer,
+               size_t draws )
+{
+    const GLsizei * counts = (const GLsizei *) batch->counts->items;
+    const GLint * firsts = (const GLint *) batch->firsts->items;
+    const GLint * bases = (const GLint *) batch->base_vertices->items;
+    size_t i, j = 0;
+    GLint offset = 0;
+
+    for( i = 0; i < vector_size( batch->items ); ++i )
+    {
+        const ivec2 * entry = (const ivec2 *) vector_get( batch->items, i );
+        const ivec4 * item = (const ivec4 *) vector_get( buffer->items,
+                                                         entry->x );
+        if( item->icount == 0 )
+        {
+            continue;
+        }
+        if( j >= draws || bases[j] != entry->y ||
+            firsts[j] + offset != item->istart )
+        {
+            return 0;
+        }
+        offset += item->icount;
+        if( offset > counts[j] )
+        {
+            return 0;
+        }
+        if( offset == counts[j] )
+        {
+            ++j;
+            offset = 0;
+        }
+    }
+    return j == draws && offset == 0;
+}
+
+
+// ------------------------------------------------------------------ frame ---
+// Batch the visible widgets, every step-th one being hidden, and build
+// the draws, timed
+int frame( vertex_buffer_batch_t * batch, const vertex_buffer_t * buffer,
+           const char * name, size_t step, int reversed, int base )
+{
+    size_t i, j, draws = 0;
+    clock_t start = clock( );
+
+    for( i = 0; i < frame_count; ++i )
+    {
+        vertex_buffer_batch_clear( batch );
+        for( j = 0; j < widget_count; ++j )
+        {
+            size_t index = reversed ? widget_count - 1 - j : j;
+            if( step && index % step == 0 )
+            {
+                continue;
+            }
+            vertex_buffer_batch_add( batch, index, base ? index / 1000 : 0 );
+        }
+        draws = vertex_buffer_batch_build( batch, buffer );
+    }
+    printf( "%-24s: %5zu items, %5zu draws, %6.1f us per frame\n",
+            name, vector_size( batch->items ), draws,
+            (double)(clock( ) - start) * 1e6 / CLOCKS_PER_SEC / frame_count );
+    if( !same_draw( batch, buffer, draws ) )
+    {
+        fprintf( stderr, "%s: draws differ from the items\n", name );
+        return 0;
+    }
+    return 1;
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv )
+{
+    vertex_buffer_t * buffer = vertex_buffer_new( "vertex:3f" );
+    vertex_buffer_batch_t * batch = vertex_buffer_batch_new( );
+    size_t i;
+    int success = 1;
+
+    for( i = 0; i < widget_count; ++i )
+    {
+        push_quad( buffer, i );
+    }
+
+    // Without batching, each widget is one vertex_buffer_render_item call
+    printf( "Widgets                 : %zu, one draw each unbatched\n",
+            widget_count );
+    success &= frame( batch, buffer, "All visible", 0, 0, 0 );
+    success &= frame( batch, buffer, "Every 100th hidden", 100, 0, 0 );
+    success &= frame( batch, buffer, "Every 7th hidden", 7, 0, 0 );
+    success &= frame( batch, buffer, "Drawn back to front", 0, 1, 0 );
+    success &= frame( batch, buffer, "Ten base vertices", 0, 0, 1 );
+
+    vertex_buffer_batch_delete( batch );
+    vertex_buffer_delete( buffer );
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
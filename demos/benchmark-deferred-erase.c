@@ -0,0 +1,194 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freetype-gl.h"
+#include "text-buffer.h"
+
+
+// ------------------------------------------------------- global variables ---
+const char * font_filename = "fonts/Vera.ttf";
+const float font_size = 14;
+const size_t quad_count = 20000;
+const size_t frame_count = 5000;
+const size_t line_count = 500;
+const size_t edit_count = 500;
+const float max_waste = 0.5;
+
+
+// --------------------------------------------------------- same_triangles ---
+// Whether both buffers draw the same triangles in the same order, leaving
+// out degenerate ones
+int same_triangles( const vertex_buffer_t * a, const vertex_buffer_t * b )
+{
+    const GLuint * x = (const GLuint *) a->indices->items;
+    const GLuint * y = (const GLuint *) b->indices->items;
+    size_t stride = a->vertices->item_size;
+    size_t i = 0, j = 0, k;
+
+    for( ;; )
+    {
+        while( i < a->indices->size && x[i] == x[i+1] && x[i] == x[i+2] )
+            i += 3;
+        while( j < b->indices->size && y[j] == y[j+1] && y[j] == y[j+2] )
+            j += 3;
+        if( i >= a->indices->size || j >= b->indices->size )
+            return i >= a->indices->size && j >= b->indices->size;
+        for( k = 0; k < 3; ++k )
+        {
+            if( memcmp( vector_get( a->vertices, x[i+k] ),
+                        vector_get( b->vertices, y[j+k] ), stride ) )
+                return 0;
+        }
+        i += 3;
+        j += 3;
+    }
+}
+
+
+// -------------------------------------------------------------- push_quad ---
+void push_quad( vertex_buffer_t * buffer, size_t id )
+{
+    float x = (float) ( id % 80 ), y = (float) ( id / 80 ), z = (float) id;
+    float quad[4][3] = { {x,y,z}, {x,y+1,z}, {x+1,y+1,z}, {x+1,y,z} };
+    GLuint indices[6] = { 0,1,2, 0,2,3 };
+
+    vertex_buffer_push_back( buffer, quad, 4, indices, 6 );
+}
+
+
+// --------------------------------------------------------------- log_view ---
+// A log view of quads, the oldest one erased for each new one, timed
+double log_view( vertex_buffer_t * buffer )
+{
+    clock_t start;
+    size_t i;
+
+    for( i = 0; i < quad_count; ++i )
+    {
+        push_quad( buffer, i );
+    }
+    start = clock( );
+    for( i = 0; i < frame_count; ++i )
+    {
+        vertex_buffer_erase( buffer, 0 );
+        push_quad( buffer, quad_count + i );
+    }
+    return (double)(clock( ) - start) / CLOCKS_PER_SEC;
+}
+
+
+// ------------------------------------------------------------- edit_lines ---
+// Random line edits of a page, timed
+double edit_lines( text_buffer_t * buffer, markup_t * markup )
+{
+    char line[128];
+    clock_t start;
+    size_t i, index;
+    vec2 pen = {{0, 0}};
+
+    for( i = 0; i < line_count; ++i )
+    {
+        snprintf( line, sizeof(line), "%04zu: The quick brown fox jumps over "
+                  "the lazy dog.\n", i );
+        text_buffer_add_text( buffer, &pen, markup, line, 0 );
+    }
+    srand( 1 );
+    start = clock( );
+    for( i = 0; i < edit_count; ++i )
+    {
+        index = rand( ) % line_count;
+        snprintf( line, sizeof(line), "%04zu: edited %zu\n", index, i );
+        text_buffer_replace_lines( buffer, &pen, index, index + 1,
+                                   markup, line, 0 );
+    }
+    text_buffer_erase_lines( buffer, &pen, 0, 10 );
+    return (double)(clock( ) - start) / CLOCKS_PER_SEC;
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv )
+{
+    texture_atlas_t * atlas = texture_atlas_new( 512, 512, 1 );
+    vertex_buffer_t * immediate = vertex_buffer_new( "vertex:3f" );
+    vertex_buffer_t * deferred = vertex_buffer_new( "vertex:3f" );
+    text_buffer_t * page = text_buffer_new( );
+    text_buffer_t * deferred_page = text_buffer_new( );
+    vec4 black = {{0.0, 0.0, 0.0, 1.0}};
+    double immediate_time, deferred_time;
+    markup_t markup;
+    int success = 1;
+
+    if( argc > 1 )
+    {
+        font_filename = argv[1];
+    }
+
+    memset( &markup, 0, sizeof(markup) );
+    markup.font = texture_font_new_from_file( atlas, font_size,
+                                              font_filename );
+    if( !markup.font )
+    {
+        fprintf( stderr, "Cannot load font %s\n", font_filename );
+        return EXIT_FAILURE;
+    }
+    markup.gamma = 1.0;
+    markup.foreground_color = black;
+
+    printf( "Font                    : %s, %gpt\n", font_filename, font_size );
+
+    vertex_buffer_defer_erase( deferred, max_waste );
+    immediate_time = log_view( immediate );
+    deferred_time = log_view( deferred );
+    printf( "Log view                : %zu quads, %zu frames\n",
+            quad_count, frame_count );
+    printf( "Erasing the oldest quad : %.2f us, %.2f us immediately (x%.0f)\n",
+            deferred_time * 1e6 / frame_count,
+            immediate_time * 1e6 / frame_count,
+            immediate_time / deferred_time );
+    printf( "Dead vertices           : %zu of %zu\n",
+            deferred->dead_vertices, deferred->vertices->size );
+    if( !same_triangles( deferred, immediate ) )
+    {
+        fprintf( stderr, "Log view: deferred erase draws differently\n" );
+        success = 0;
+    }
+    vertex_buffer_compact( deferred );
+    if( deferred->dead_vertices ||
+        deferred->vertices->size != immediate->vertices->size ||
+        deferred->indices->size != immediate->indices->size ||
+        !same_triangles( deferred, immediate ) )
+    {
+        fprintf( stderr, "Log view: compaction draws differently\n" );
+        success = 0;
+    }
+
+    vertex_buffer_defer_erase( deferred_page->buffer, max_waste );
+    immediate_time = edit_lines( page, &markup );
+    deferred_time = edit_lines( deferred_page, &markup );
+    printf( "Editing a line          : %.3f ms, %.3f ms immediately (x%.1f)\n",
+            deferred_time * 1e3 / edit_count,
+            immediate_time * 1e3 / edit_count,
+            immediate_time / deferred_time );
+    if( !same_triangles( deferred_page->buffer, page->buffer ) )
+    {
+        fprintf( stderr, "Line edits: deferred erase draws differently\n" );
+        success = 0;
+    }
+
+    vertex_buffer_delete( immediate );
+    vertex_buffer_delete( deferred );
+    text_buffer_delete( page );
+    text_buffer_delete( deferred_page );
+    texture_font_delete( markup.font );
+    texture_atlas_delete( atlas );
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
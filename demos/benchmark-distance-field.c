@@ -0,0 +1,135 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "freetype-gl.h"
+
+
+// ------------------------------------------------------- global variables ---
+const char * font_filename = "fonts/Liberastika-Regular.ttf";
+const size_t atlas_size = 2048;
+const float font_size = 32;
+
+
+// -------------------------------------------------------------- load_font ---
+// Load every glyph the face maps a codepoint to, in the given mode
+texture_font_t * load_font( rendermode_t rendermode, sdf_method_t sdf_method,
+                            const char * name )
+{
+    texture_atlas_t * atlas = texture_atlas_new( atlas_size, atlas_size, 1 );
+    texture_font_t * font;
+    FT_ULong charcode;
+    FT_UInt gindex;
+    size_t count = 0, missed = 0;
+    clock_t start;
+    double elapsed;
+
+    font = texture_font_new_from_file( atlas, font_size, font_filename );
+    if( !font )
+    {
+        fprintf( stderr, "Cannot load font %s\n", font_filename );
+        exit( EXIT_FAILURE );
+    }
+    font->mode = MODE_ALWAYS_OPEN;
+    font->rendermode = rendermode;
+    font->sdf_method = sdf_method;
+
+    start = clock( );
+    charcode = FT_Get_First_Char( font->face, &gindex );
+    while( gindex )
+    {
+        missed += !texture_font_load_glyph_gi( font, gindex, charcode );
+        count++;
+        charcode = FT_Get_Next_Char( font->face, charcode, &gindex );
+    }
+    elapsed = (double)(clock( ) - start) / CLOCKS_PER_SEC;
+    printf( "%-24s: %.3f s (%.1f us per glyph, %zu missed)\n",
+            name, elapsed, elapsed * 1e6 / count, missed );
+
+    return font;
+}
+
+
+// ---------------------------------------------------------------- compare ---
+// Compare the distance fields of the glyphs of two fonts, pixel by pixel
+void compare( texture_font_t * reference, texture_font_t * font )
+{
+    texture_atlas_t * atlas = reference->atlas;
+    texture_glyph_t * a, * b;
+    FT_ULong charcode;
+    FT_UInt gindex;
+    size_t x, y, x0, y0, pixels = 0, flipped = 0, error = 0, max_error = 0;
+
+    charcode = FT_Get_First_Char( reference->face, &gindex );
+    while( gindex )
+    {
+        a = texture_font_find_glyph_gi( reference, charcode );
+        b = texture_font_find_glyph_gi( font, charcode );
+        charcode = FT_Get_Next_Char( reference->face, charcode, &gindex );
+        if( !a || !b || a->width != b->width || a->height != b->height )
+            continue;
+        x0 = (size_t)(a->s0 * atlas->width + 0.5f);
+        y0 = (size_t)(a->t0 * atlas->height + 0.5f);
+        for( y = y0; y < y0 + a->height; ++y )
+        {
+            for( x = x0; x < x0 + a->width; ++x )
+            {
+                int u = atlas->data[y * atlas->width + x];
+                int v = font->atlas->data[y * atlas->width + x];
+                size_t d = abs( u - v );
+
+                pixels++;
+                error += d;
+                if( d > max_error )
+                    max_error = d;
+                // The edge is at 127.5, see the distance field shaders
+                if( (u > 127) != (v > 127) )
+                    flipped++;
+            }
+        }
+    }
+
+    printf( "Pixels compared         : %zu\n", pixels );
+    printf( "Mean absolute error     : %.3f\n", error / (double)pixels );
+    printf( "Maximum absolute error  : %zu\n", max_error );
+    printf( "Inside/outside flips    : %zu (%.4f%%)\n",
+            flipped, 100.0 * flipped / pixels );
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv )
+{
+    texture_font_t * normal, * edtaa3, * dead_reckoning;
+
+    if( argc > 1 )
+    {
+        font_filename = argv[1];
+    }
+    printf( "Font                    : %s, %gpt\n", font_filename, font_size );
+
+    normal = load_font( RENDER_NORMAL, SDF_EDTAA3, "Normal" );
+    edtaa3 = load_font( RENDER_SIGNED_DISTANCE_FIELD, SDF_EDTAA3,
+                        "Distance field, EDTAA3" );
+    dead_reckoning = load_font( RENDER_SIGNED_DISTANCE_FIELD,
+                                SDF_DEAD_RECKONING,
+                                "Dead reckoning" );
+    compare( edtaa3, dead_reckoning );
+
+    texture_atlas_delete( normal->atlas );
+    texture_font_delete( normal );
+    texture_atlas_delete( edtaa3->atlas );
+    texture_font_delete( edtaa3 );
+    texture_atlas_delete( dead_reckoning->atlas );
+    texture_font_delete( dead_reckoning );
+
+    return EXIT_SUCCESS;
+}
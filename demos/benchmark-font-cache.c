@@ -0,0 +1,160 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "freetype-gl.h"
+
+
+// ------------------------------------------------------- global variables ---
+const char * font_filename = "fonts/Liberastika-Regular.ttf";
+const char * cache_filename = "benchmark-font-cache.bin";
+const size_t atlas_size = 1024;
+const float font_size = 24;
+const size_t max_glyphs = 1000;
+
+
+// --------------------------------------------------------------- new_font ---
+texture_font_t * new_font( float size )
+{
+    texture_atlas_t * atlas = texture_atlas_new( atlas_size, atlas_size, 1 );
+    texture_font_t * font;
+
+    font = texture_font_new_from_file( atlas, size, font_filename );
+    if( !font )
+    {
+        fprintf( stderr, "Cannot load font %s\n", font_filename );
+        exit( EXIT_FAILURE );
+    }
+    font->mode = MODE_ALWAYS_OPEN;
+    font->rendermode = RENDER_SIGNED_DISTANCE_FIELD;
+    return font;
+}
+
+
+// ------------------------------------------------------------ delete_font ---
+void delete_font( texture_font_t * font )
+{
+    texture_atlas_t * atlas = font->atlas;
+
+    texture_font_delete( font );
+    texture_atlas_delete( atlas );
+}
+
+
+// ---------------------------------------------------------------- compare ---
+// Whether both fonts have the same glyphs, kerning pairs and atlas content
+int compare( texture_font_t * a, texture_font_t * b,
+             const uint32_t * codepoints, size_t count )
+{
+    texture_glyph_t * x, * y;
+    size_t i;
+
+    for( i = 0; i < count; ++i )
+    {
+        x = texture_font_find_glyph_gi( a, codepoints[i] );
+        y = texture_font_find_glyph_gi( b, codepoints[i] );
+        if( !x || !y || x->codepoint != y->codepoint ||
+            x->width != y->width || x->height != y->height ||
+            x->offset_x != y->offset_x || x->offset_y != y->offset_y ||
+            x->advance_x != y->advance_x || x->s0 != y->s0 ||
+            x->t0 != y->t0 || x->s1 != y->s1 || x->t1 != y->t1 ||
+            x->kerning->size != y->kerning->size ||
+            memcmp( x->kerning->items, y->kerning->items,
+                    x->kerning->size * sizeof(kerning_t) ) )
+            return 0;
+    }
+    return a->atlas->pages == b->atlas->pages &&
+           a->atlas->used == b->atlas->used &&
+           !memcmp( a->atlas->data, b->atlas->data,
+                    a->atlas->pages * atlas_size * atlas_size );
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv )
+{
+    texture_font_t * font, * cached;
+    uint32_t * codepoints;
+    size_t count = 0, missed;
+    FT_ULong charcode;
+    FT_UInt gindex;
+    clock_t start;
+    double render_time, load_time;
+    int success = 1;
+
+    if( argc > 1 )
+    {
+        font_filename = argv[1];
+    }
+
+    // Every codepoint the face maps, up to max_glyphs
+    font = new_font( font_size );
+    codepoints = malloc( max_glyphs * sizeof(uint32_t) );
+    charcode = FT_Get_First_Char( font->face, &gindex );
+    while( gindex && count < max_glyphs )
+    {
+        codepoints[count++] = charcode;
+        charcode = FT_Get_Next_Char( font->face, charcode, &gindex );
+    }
+    printf( "Font                    : %s, %gpt\n", font_filename, font_size );
+    printf( "Glyphs                  : %zu, distance field\n", count );
+
+    start = clock( );
+    missed = texture_font_load_glyphs_batch( font, codepoints, count, NULL );
+    render_time = (double)(clock( ) - start) / CLOCKS_PER_SEC;
+    printf( "Rendering               : %.3f s, %zu missed\n",
+            render_time, missed );
+    if( !texture_font_save_cache( font, cache_filename ) )
+    {
+        fprintf( stderr, "Cannot write %s\n", cache_filename );
+        return EXIT_FAILURE;
+    }
+
+    cached = new_font( font_size );
+    start = clock( );
+    if( !texture_font_load_cache( cached, cache_filename ) )
+    {
+        fprintf( stderr, "Cannot load %s\n", cache_filename );
+        success = 0;
+    }
+    load_time = (double)(clock( ) - start) / CLOCKS_PER_SEC;
+    printf( "Loading the cache       : %.3f s (x%.0f)\n",
+            load_time, render_time / load_time );
+    if( success && !compare( font, cached, codepoints, count ) )
+    {
+        fprintf( stderr, "Cached glyphs differ from the rendered ones\n" );
+        success = 0;
+    }
+    delete_font( cached );
+
+    // A cache must not be used for other settings
+    cached = new_font( font_size + 1 );
+    if( texture_font_load_cache( cached, cache_filename ) )
+    {
+        fprintf( stderr, "Cache loaded for another size\n" );
+        success = 0;
+    }
+    delete_font( cached );
+
+    // Nor replace glyphs already rendered in the atlas
+    if( texture_font_load_cache( font, cache_filename ) )
+    {
+        fprintf( stderr, "Cache loaded in a non-empty atlas\n" );
+        success = 0;
+    }
+
+    delete_font( font );
+    remove( cache_filename );
+    free( codepoints );
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
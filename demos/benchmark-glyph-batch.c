@@ -0,0 +1,141 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "freetype-gl.h"
+
+
+// ------------------------------------------------------- global variables ---
+const char * font_filename = "fonts/Liberastika-Regular.ttf";
+const size_t atlas_size = 1024;
+const float font_size = 24;
+const size_t max_glyphs = 1500;
+size_t thread_count = 4;
+
+
+// -------------------------------------------------------------- wall_time ---
+// Wall clock time in seconds, clock() would add up the time of every thread.
+// Without threads, clock() is all there is (and all that is needed).
+double wall_time( void )
+{
+#ifdef FREETYPE_GL_USE_PTHREADS
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec + now.tv_nsec * 1e-9;
+#else
+    return (double)clock( ) / CLOCKS_PER_SEC;
+#endif
+}
+
+
+// -------------------------------------------------------------- rows_used ---
+// Rows of the atlas below the highest column of the skyline
+size_t rows_used( const texture_atlas_t * atlas )
+{
+    size_t x, top = 0;
+
+    for( x = 1; x < atlas->width - 1; ++x )
+    {
+        if( (size_t)atlas->skyline[atlas->skyline_size + x].max > top )
+            top = atlas->skyline[atlas->skyline_size + x].max;
+    }
+    return top;
+}
+
+
+// ----------------------------------------------------------------- report ---
+void report( const char * name, const texture_atlas_t * atlas,
+             size_t missed, double elapsed )
+{
+    size_t top = rows_used( atlas );
+
+    printf( "%-24s: %.3f s, %zu missed, %zu rows used, %.2f%% occupancy\n",
+            name, elapsed, missed, top,
+            100.0 * atlas->used / (double)(atlas->width * top) );
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv )
+{
+    texture_atlas_t * atlas;
+    texture_font_t * font;
+    uint32_t * codepoints;
+    size_t count = 0, missed, i;
+    char name[32];
+    FT_ULong charcode;
+    FT_UInt gindex;
+    double start;
+
+    if( argc > 1 )
+    {
+        font_filename = argv[1];
+    }
+    if( argc > 2 )
+    {
+        thread_count = atoi( argv[2] );
+    }
+
+    // Every codepoint the face maps, up to max_glyphs
+    atlas = texture_atlas_new( atlas_size, atlas_size, 1 );
+    font = texture_font_new_from_file( atlas, font_size, font_filename );
+    if( !font )
+    {
+        fprintf( stderr, "Cannot load font %s\n", font_filename );
+        return EXIT_FAILURE;
+    }
+    font->mode = MODE_ALWAYS_OPEN;
+    codepoints = malloc( max_glyphs * sizeof(uint32_t) );
+    charcode = FT_Get_First_Char( font->face, &gindex );
+    while( gindex && count < max_glyphs )
+    {
+        codepoints[count++] = charcode;
+        charcode = FT_Get_Next_Char( font->face, charcode, &gindex );
+    }
+    printf( "Font                    : %s, %gpt\n", font_filename, font_size );
+    printf( "Glyphs                  : %zu\n", count );
+
+    missed = 0;
+    start = wall_time( );
+    for( i = 0; i < count; ++i )
+    {
+        missed += !texture_font_load_glyph_gi(
+            font, FT_Get_Char_Index( font->face, codepoints[i] ), codepoints[i] );
+    }
+    report( "One by one", atlas, missed, wall_time( ) - start );
+    texture_font_delete( font );
+    texture_atlas_delete( atlas );
+
+    atlas = texture_atlas_new( atlas_size, atlas_size, 1 );
+    font = texture_font_new_from_file( atlas, font_size, font_filename );
+    font->mode = MODE_ALWAYS_OPEN;
+    start = wall_time( );
+    missed = texture_font_load_glyphs_batch( font, codepoints, count, NULL );
+    report( "Batch", atlas, missed, wall_time( ) - start );
+    texture_font_delete( font );
+    texture_atlas_delete( atlas );
+
+    atlas = texture_atlas_new( atlas_size, atlas_size, 1 );
+    font = texture_font_new_from_file( atlas, font_size, font_filename );
+    font->mode = MODE_ALWAYS_OPEN;
+    font->threads = thread_count;
+    start = wall_time( );
+    missed = texture_font_load_glyphs_batch( font, codepoints, count, NULL );
+    sprintf( name, "Batch, %zu threads", thread_count );
+    report( name, atlas, missed, wall_time( ) - start );
+    texture_font_delete( font );
+    texture_atlas_delete( atlas );
+
+    free( codepoints );
+
+    return EXIT_SUCCESS;
+}
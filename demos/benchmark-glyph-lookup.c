@@ -0,0 +1,202 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "freetype-gl.h"
+
+
+// ------------------------------------------------------- typedef & struct ---
+// Glyph lookup as done before texture_glyph_map_t: a vector of pages of 256
+// glyph pointers, each pointing to a run of rendermode variants.
+typedef struct {
+    texture_glyph_t ***pages;
+    size_t page_count;
+    size_t memory;
+} paged_glyphs_t;
+
+
+// ------------------------------------------------------- global variables ---
+const char * font_filename = "fonts/Liberastika-Regular.ttf";
+const size_t query_count = 1000000;
+const size_t repeat_count = 10;
+
+
+// ------------------------------------------------------- paged_glyphs_add ---
+void paged_glyphs_add( paged_glyphs_t * self, uint32_t codepoint,
+                       texture_glyph_t * glyph )
+{
+    size_t i = codepoint >> 8;
+    size_t j = codepoint & 0xFF;
+
+    if( i >= self->page_count )
+    {
+        self->pages = realloc( self->pages, (i+1) * sizeof(texture_glyph_t **) );
+        memset( self->pages + self->page_count, 0,
+                (i+1 - self->page_count) * sizeof(texture_glyph_t **) );
+        self->memory += (i+1 - self->page_count) * sizeof(texture_glyph_t **);
+        self->page_count = i+1;
+    }
+    if( !self->pages[i] )
+    {
+        self->pages[i] = calloc( 0x100, sizeof(texture_glyph_t *) );
+        self->memory += 0x100 * sizeof(texture_glyph_t *);
+    }
+    self->pages[i][j] = glyph;
+}
+
+
+// ------------------------------------------------------ paged_glyphs_find ---
+texture_glyph_t * paged_glyphs_find( paged_glyphs_t * self, uint32_t codepoint,
+                                     rendermode_t rendermode,
+                                     float outline_thickness )
+{
+    size_t i = codepoint >> 8;
+    texture_glyph_t * glyph;
+
+    if( i >= self->page_count || !self->pages[i] )
+        return NULL;
+    glyph = self->pages[i][codepoint & 0xFF];
+    if( glyph && (glyph->rendermode != rendermode ||
+                  glyph->outline_thickness != outline_thickness) )
+        return NULL;
+    return glyph;
+}
+
+
+// ------------------------------------------------------- glyph_map_memory ---
+size_t glyph_map_memory( const texture_glyph_map_t * map )
+{
+    return sizeof(texture_glyph_map_t) +
+           map->capacity * sizeof(texture_glyph_slot_t);
+}
+
+
+// ----------------------------------------------------------- time_lookups ---
+double time_lookups( texture_font_t * font, const uint32_t * queries,
+                     size_t * found )
+{
+    clock_t start = clock( );
+    size_t i, j;
+
+    *found = 0;
+    for( j = 0; j < repeat_count; ++j )
+    {
+        for( i = 0; i < query_count; ++i )
+        {
+            *found += texture_font_find_glyph_gi( font, queries[i] ) != NULL;
+        }
+    }
+    return (double)(clock( ) - start) / CLOCKS_PER_SEC;
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv )
+{
+    texture_atlas_t * atlas;
+    texture_font_t * font;
+    paged_glyphs_t paged = { NULL, 0, 0 };
+    uint32_t * codepoints, * queries;
+    size_t codepoint_count = 0, i, j, found;
+    FT_ULong charcode;
+    FT_UInt gindex;
+    clock_t start;
+    double map_time, paged_time;
+
+    if( argc > 1 )
+    {
+        font_filename = argv[1];
+    }
+
+    atlas = texture_atlas_new( 2048, 2048, 1 );
+    font = texture_font_new_from_file( atlas, 12, font_filename );
+    if( !font )
+    {
+        fprintf( stderr, "Cannot load font %s\n", font_filename );
+        return EXIT_FAILURE;
+    }
+    font->mode = MODE_ALWAYS_OPEN;
+
+    // Load every glyph the face maps a codepoint to
+    codepoints = malloc( font->face->num_glyphs * sizeof(uint32_t) * 2 );
+    charcode = FT_Get_First_Char( font->face, &gindex );
+    while( gindex && codepoint_count < (size_t)font->face->num_glyphs * 2 )
+    {
+        if( texture_font_load_glyph_gi( font, gindex, charcode ) )
+            codepoints[codepoint_count++] = charcode;
+        charcode = FT_Get_Next_Char( font->face, charcode, &gindex );
+    }
+    for( i = 0; i < codepoint_count; ++i )
+    {
+        paged_glyphs_add( &paged, codepoints[i],
+                          texture_font_find_glyph_gi( font, codepoints[i] ) );
+    }
+
+    printf( "Font                    : %s\n", font_filename );
+    printf( "Glyphs                  : %zu\n", codepoint_count );
+    printf( "Glyph map memory        : %zu bytes\n",
+            glyph_map_memory( font->glyphs ) );
+    printf( "Paged table memory      : %zu bytes\n", paged.memory );
+
+    // Same pseudo random sequence of hits and misses for both lookups
+    queries = malloc( query_count * sizeof(uint32_t) );
+    srand( 1 );
+    for( i = 0; i < query_count; ++i )
+    {
+        queries[i] = codepoints[rand() % codepoint_count] + (rand() & 1);
+    }
+
+    map_time = time_lookups( font, queries, &found );
+    printf( "Glyph map lookup        : %.1f ns (%zu hits)\n",
+            map_time * 1e9 / (query_count * repeat_count), found );
+
+    found = 0;
+    start = clock( );
+    for( j = 0; j < repeat_count; ++j )
+    {
+        for( i = 0; i < query_count; ++i )
+        {
+            found += paged_glyphs_find( &paged, queries[i], font->rendermode,
+                                        font->outline_thickness ) != NULL;
+        }
+    }
+    paged_time = (double)(clock( ) - start) / CLOCKS_PER_SEC;
+    printf( "Paged table lookup      : %.1f ns (%zu hits)\n",
+            paged_time * 1e9 / (query_count * repeat_count), found );
+
+    // Outlined glyphs share the map with the plain ones
+    font->rendermode = RENDER_OUTLINE_EDGE;
+    font->outline_thickness = 1;
+    for( i = 0; i < codepoint_count; ++i )
+    {
+        texture_font_load_glyph_gi( font, FT_Get_Char_Index( font->face,
+                                                             codepoints[i] ),
+                                    codepoints[i] );
+    }
+    map_time = time_lookups( font, queries, &found );
+    printf( "Outlined glyph lookup   : %.1f ns (%zu hits)\n",
+            map_time * 1e9 / (query_count * repeat_count), found );
+    printf( "Glyph map memory        : %zu bytes, with outlined glyphs\n",
+            glyph_map_memory( font->glyphs ) );
+
+    for( i = 0; i < paged.page_count; ++i )
+    {
+        free( paged.pages[i] );
+    }
+    free( paged.pages );
+    free( queries );
+    free( codepoints );
+    texture_font_delete( font );
+    texture_atlas_delete( atlas );
+
+    return EXIT_SUCCESS;
+}
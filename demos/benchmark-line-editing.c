@@ -0,0 +1,233 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "freetype-gl.h"
+#include "text-buffer.h"
+
+
+// ------------------------------------------------------- global variables ---
+const char * font_filename = "fonts/Vera.ttf";
+const float font_size = 14;
+const size_t line_count = 500;
+const size_t edit_count = 200;
+
+
+// ------------------------------------------------------- typedef & struct ---
+// Lines as a terminal would keep them
+typedef struct {
+    char * text;
+    markup_t * markup;
+} line_t;
+
+line_t * lines;
+size_t count;
+
+
+// ------------------------------------------------------------ layout_page ---
+// Lay out every line from scratch
+void layout_page( text_buffer_t * buffer, vec2 * pen )
+{
+    size_t i;
+
+    text_buffer_clear( buffer );
+    pen->x = 0; pen->y = 0;
+    for( i = 0; i < count; ++i )
+    {
+        text_buffer_add_text( buffer, pen, lines[i].markup, lines[i].text, 0 );
+    }
+}
+
+
+// ------------------------------------------------------------ insert_line ---
+void insert_line( size_t index, const char * text, markup_t * markup )
+{
+    memmove( lines + index + 1, lines + index,
+             ( count - index ) * sizeof(line_t) );
+    lines[index].text = strdup( text );
+    lines[index].markup = markup;
+    count++;
+}
+
+
+// ------------------------------------------------------------- erase_line ---
+void erase_line( size_t index )
+{
+    free( lines[index].text );
+    memmove( lines + index, lines + index + 1,
+             ( count - index - 1 ) * sizeof(line_t) );
+    count--;
+}
+
+
+// ---------------------------------------------------------------- compare ---
+// Whether both buffers draw the same items and lines, wherever their
+// vertices are stored
+int compare( const text_buffer_t * a, const vec2 * a_pen,
+             const text_buffer_t * b, const vec2 * b_pen )
+{
+    const vertex_buffer_t * x = a->buffer, * y = b->buffer;
+    size_t i, j;
+
+    if( x->items->size != y->items->size || a->lines->size != b->lines->size ||
+        a->line_start != b->line_start ||
+        fabsf( a_pen->x - b_pen->x ) > 1e-3 ||
+        fabsf( a_pen->y - b_pen->y ) > 1e-3 ||
+        fabsf( a->bounds.left - b->bounds.left ) > 1e-3 ||
+        fabsf( a->bounds.top - b->bounds.top ) > 1e-3 ||
+        fabsf( a->bounds.width - b->bounds.width ) > 1e-3 ||
+        fabsf( a->bounds.height - b->bounds.height ) > 1e-3 )
+        return 0;
+    for( i = 0; i < x->items->size; ++i )
+    {
+        const ivec4 * p = vector_get( x->items, i );
+        const ivec4 * q = vector_get( y->items, i );
+
+        if( p->vcount != q->vcount || p->icount != q->icount ||
+            memcmp( vector_get( x->vertices, p->vstart ),
+                    vector_get( y->vertices, q->vstart ),
+                    p->vcount * x->vertices->item_size ) )
+            return 0;
+        for( j = 0; j < (size_t) p->icount; ++j )
+        {
+            GLuint u = *(GLuint *) vector_get( x->indices, p->istart + j );
+            GLuint v = *(GLuint *) vector_get( y->indices, q->istart + j );
+            if( u - p->vstart != v - q->vstart )
+                return 0;
+        }
+    }
+    for( i = 0; i < a->lines->size; ++i )
+    {
+        const line_info_t * p = vector_get( a->lines, i );
+        const line_info_t * q = vector_get( b->lines, i );
+
+        if( p->line_start != q->line_start ||
+            fabsf( p->bounds.top - q->bounds.top ) > 1e-3 ||
+            fabsf( p->bounds.left - q->bounds.left ) > 1e-3 ||
+            fabsf( p->bounds.width - q->bounds.width ) > 1e-3 ||
+            fabsf( p->bounds.height - q->bounds.height ) > 1e-3 )
+            return 0;
+    }
+    return 1;
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv )
+{
+    texture_atlas_t * atlas = texture_atlas_new( 512, 512, 1 );
+    text_buffer_t * edited = text_buffer_new( );
+    text_buffer_t * rebuilt = text_buffer_new( );
+    vec4 black = {{0.0, 0.0, 0.0, 1.0}};
+    markup_t markup, big;
+    char line[128];
+    size_t i, index;
+    clock_t start;
+    double edit_time, rebuild_time;
+    vec2 pen, other;
+    int success = 1;
+
+    if( argc > 1 )
+    {
+        font_filename = argv[1];
+    }
+
+    memset( &markup, 0, sizeof(markup) );
+    markup.font = texture_font_new_from_file( atlas, font_size,
+                                              font_filename );
+    if( !markup.font )
+    {
+        fprintf( stderr, "Cannot load font %s\n", font_filename );
+        return EXIT_FAILURE;
+    }
+    markup.gamma = 1.0;
+    markup.foreground_color = black;
+    big = markup;
+    big.font = texture_font_new_from_file( atlas, 2 * font_size,
+                                           font_filename );
+
+    // A terminal page
+    lines = malloc( ( line_count + 10 ) * sizeof(line_t) );
+    count = 0;
+    for( i = 0; i < line_count; ++i )
+    {
+        snprintf( line, sizeof(line), "%04zu: The quick brown fox jumps over "
+                  "the lazy dog, %zu times.\n", i, i * 7919 % 1000 );
+        insert_line( i, line, &markup );
+    }
+    layout_page( edited, &pen );
+    printf( "Font                    : %s, %gpt\n", font_filename, font_size );
+    printf( "Page                    : %zu lines, %zu glyphs\n",
+            line_count, edited->buffer->items->size );
+
+    // Editing lines in place or laying out the whole page again
+    srand( 1 );
+    start = clock( );
+    for( i = 0; i < edit_count; ++i )
+    {
+        index = rand( ) % count;
+        snprintf( line, sizeof(line), "%04zu: edited %zu\n", index, i );
+        erase_line( index );
+        insert_line( index, line, &markup );
+        text_buffer_replace_lines( edited, &pen, index, index + 1,
+                                   &markup, line, 0 );
+    }
+    edit_time = (double)(clock( ) - start) / CLOCKS_PER_SEC;
+    start = clock( );
+    for( i = 0; i < edit_count; ++i )
+    {
+        layout_page( rebuilt, &other );
+    }
+    rebuild_time = (double)(clock( ) - start) / CLOCKS_PER_SEC;
+    printf( "Editing a line          : %.3f ms, %.3f ms to rebuild (x%.0f)\n",
+            edit_time * 1e3 / edit_count, rebuild_time * 1e3 / edit_count,
+            rebuild_time / edit_time );
+    if( !compare( edited, &pen, rebuilt, &other ) )
+    {
+        fprintf( stderr, "Edited lines differ from a rebuilt page\n" );
+        success = 0;
+    }
+
+    // Edits changing the number and the height of lines, then appending
+    text_buffer_erase_lines( edited, &pen, 10, 14 );
+    for( i = 10; i < 14; ++i )
+        erase_line( 10 );
+    text_buffer_replace_lines( edited, &pen, 20, 21, &markup,
+                               "split\nin two\n", 0 );
+    erase_line( 20 );
+    insert_line( 20, "split\n", &markup );
+    insert_line( 21, "in two\n", &markup );
+    text_buffer_replace_lines( edited, &pen, 29, 29, &big, "Big\n", 0 );
+    insert_line( 29, "Big\n", &big );
+    text_buffer_replace_lines( edited, &pen, count - 1, count, &markup,
+                               "last\n", 0 );
+    erase_line( count - 1 );
+    insert_line( count, "last\n", &markup );
+    text_buffer_add_text( edited, &pen, &markup, "appended", 0 );
+    insert_line( count, "appended", &markup );
+    layout_page( rebuilt, &other );
+    if( !compare( edited, &pen, rebuilt, &other ) )
+    {
+        fprintf( stderr, "Erased and inserted lines differ from a rebuilt "
+                 "page\n" );
+        success = 0;
+    }
+
+    for( i = 0; i < count; ++i )
+        free( lines[i].text );
+    free( lines );
+    text_buffer_delete( edited );
+    text_buffer_delete( rebuilt );
+    texture_font_delete( markup.font );
+    texture_font_delete( big.font );
+    texture_atlas_delete( atlas );
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
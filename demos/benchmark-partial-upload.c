@@ -0,0 +1,153 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freetype-gl.h"
+#include "text-buffer.h"
+#include "gpu-recorder.h"
+
+
+// ------------------------------------------------------- global variables ---
+const char * font_filename = "fonts/Vera.ttf";
+const float font_size = 14;
+const size_t line_count = 500;
+
+
+// ----------------------------------------------------------------- upload ---
+// Upload through the recording backend, check GPU memory matches the
+// buffer and report what was sent
+int upload( vertex_buffer_t * buffer, gpu_recorder_t * gpu, const char * name )
+{
+    size_t vsize = buffer->vertices->size * buffer->vertices->item_size;
+    size_t isize = buffer->indices->size * buffer->indices->item_size;
+    size_t bytes;
+    int same;
+
+    gpu->transfers = 0;
+    gpu->bytes[0] = gpu->bytes[1] = 0;
+    same = gpu_recorder_upload( gpu, buffer );
+    bytes = gpu->bytes[0] + gpu->bytes[1];
+    printf( "%-24s: %3zu transfers, %7zu bytes of %7zu (%5.1f%%)\n",
+            name, gpu->transfers, bytes, vsize + isize,
+            vsize + isize ? 100.0 * bytes / ( vsize + isize ) : 0.0 );
+    if( !same )
+    {
+        fprintf( stderr, "%s: GPU memory differs from the buffer\n", name );
+        return 0;
+    }
+    return 1;
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv )
+{
+    texture_atlas_t * atlas = texture_atlas_new( 512, 512, 1 );
+    text_buffer_t * buffer = text_buffer_new( );
+    vertex_buffer_t * plain = vertex_buffer_new( "vertex:3f" );
+    vec4 black = {{0.0, 0.0, 0.0, 1.0}};
+    vec4 red = {{1.0, 0.0, 0.0, 1.0}};
+    float quad[4][3] = { {0,0,0}, {0,1,0}, {1,1,0}, {1,0,0} };
+    GLuint indices[6] = { 0,1,2, 0,2,3 };
+    gpu_recorder_t gpu, other;
+    markup_t markup, highlight;
+    char line[128];
+    size_t i;
+    vec2 pen;
+    int success = 1;
+
+    if( argc > 1 )
+    {
+        font_filename = argv[1];
+    }
+
+    memset( &markup, 0, sizeof(markup) );
+    markup.font = texture_font_new_from_file( atlas, font_size,
+                                              font_filename );
+    if( !markup.font )
+    {
+        fprintf( stderr, "Cannot load font %s\n", font_filename );
+        return EXIT_FAILURE;
+    }
+    markup.gamma = 1.0;
+    markup.foreground_color = black;
+    highlight = markup;
+    highlight.foreground_color = red;
+    memset( &gpu, 0, sizeof(gpu) );
+    memset( &other, 0, sizeof(other) );
+    printf( "Font                    : %s, %gpt\n", font_filename, font_size );
+
+    // A terminal page, edited the way a terminal would
+    pen.x = 0; pen.y = 0;
+    for( i = 0; i < line_count; ++i )
+    {
+        snprintf( line, sizeof(line), "%04zu: The quick brown fox jumps over "
+                  "the lazy dog.\n", i );
+        text_buffer_add_text( buffer, &pen, &markup, line, 0 );
+    }
+    success &= upload( buffer->buffer, &gpu, "Page" );
+    success &= upload( buffer->buffer, &gpu, "Nothing changed" );
+
+    text_buffer_add_text( buffer, &pen, &markup, "$ ls", 0 );
+    success &= upload( buffer->buffer, &gpu, "Typing at the end" );
+
+    text_buffer_replace_lines( buffer, &pen, line_count, line_count,
+                               &markup, "$ ls -l", 0 );
+    success &= upload( buffer->buffer, &gpu, "Editing the last line" );
+
+    text_buffer_replace_lines( buffer, &pen, 20, 21, &highlight,
+                               "0020: The quick brown fox jumps over "
+                               "the lazy dog.\n", 0 );
+    success &= upload( buffer->buffer, &gpu, "Editing line 20" );
+
+    text_buffer_replace_lines( buffer, &pen, line_count - 20,
+                               line_count - 19, &highlight,
+                               "Highlighted\n", 0 );
+    success &= upload( buffer->buffer, &gpu, "Editing a line near end" );
+
+    text_buffer_erase_lines( buffer, &pen, 0, 10 );
+    success &= upload( buffer->buffer, &gpu, "Scrolling 10 lines" );
+
+    text_buffer_align( buffer, &pen, ALIGN_CENTER );
+    success &= upload( buffer->buffer, &gpu, "Centering" );
+
+    text_buffer_clear( buffer );
+    pen.x = 0; pen.y = 0;
+    text_buffer_add_text( buffer, &pen, &markup, "Cleared\n", 0 );
+    success &= upload( buffer->buffer, &gpu, "Clearing" );
+
+    // Scattered edits of a plain buffer, more than there are dirty ranges
+    for( i = 0; i < 1000; ++i )
+    {
+        vertex_buffer_push_back( plain, quad, 4, indices, 6 );
+    }
+    success &= upload( plain, &other, "Quads" );
+    for( i = 0; i < 3 * VERTEX_BUFFER_MAX_RANGES; ++i )
+    {
+        ivec4 * item = (ivec4 *) vector_get( plain->items, i * 37 );
+        float * vertex = (float *) vector_get( plain->vertices,
+                                               item->vstart );
+        vertex[2] = (float) i;
+        vertex_buffer_invalidate_vertices( plain, item->vstart,
+                                           item->vstart + 1 );
+    }
+    success &= upload( plain, &other, "Scattered edits" );
+    vertex_buffer_erase( plain, 500 );
+    success &= upload( plain, &other, "Erasing a quad" );
+    vertex_buffer_erase_range( plain, 990, 999 );
+    success &= upload( plain, &other, "Erasing the last quads" );
+
+    gpu_recorder_clear( &gpu );
+    gpu_recorder_clear( &other );
+    vertex_buffer_delete( plain );
+    text_buffer_delete( buffer );
+    texture_font_delete( markup.font );
+    texture_atlas_delete( atlas );
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,129 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pixel-convert.h"
+
+
+// ------------------------------------------------------- typedef & struct ---
+typedef void (*convert_t)( unsigned char *, const unsigned char *, size_t );
+
+typedef struct {
+    const char * name;
+    convert_t simd;
+    convert_t scalar;
+    size_t src_depth;
+    size_t dst_depth;
+} conversion_t;
+
+
+// ------------------------------------------------------- global variables ---
+// One row of a 136 pixels color emoji strike, as in NotoColorEmoji
+const size_t row_width = 136;
+const size_t row_count = 128;
+const size_t repeat_count = 2000;
+
+const conversion_t conversions[] = {
+    { "BGRA to RGBA", convert_bgra_to_rgba, convert_bgra_to_rgba_scalar, 4, 4 },
+    { "BGRA to grey", convert_bgra_to_grey, convert_bgra_to_grey_scalar, 4, 1 },
+    { "Grey to RGBA", convert_grey_to_rgba, convert_grey_to_rgba_scalar, 1, 4 },
+};
+
+
+// -------------------------------------------------------- time_conversion ---
+double time_conversion( convert_t convert, unsigned char * dst,
+                        const unsigned char * src, const conversion_t * c )
+{
+    clock_t start = clock( );
+    size_t i, j;
+
+    for( i = 0; i < repeat_count; ++i )
+    {
+        for( j = 0; j < row_count; ++j )
+        {
+            convert( dst + j * row_width * c->dst_depth,
+                     src + j * row_width * c->src_depth, row_width );
+        }
+    }
+    return (double)(clock( ) - start) / CLOCKS_PER_SEC;
+}
+
+
+// ------------------------------------------------------------------ check ---
+// Compare both versions on random pixels, for every row length up to 64 so
+// that every remainder of the vector loops is covered
+int check( const conversion_t * c, const unsigned char * src, size_t size )
+{
+    unsigned char * a = malloc( size * 4 );
+    unsigned char * b = malloc( size * 4 );
+    size_t count, offset, mismatches = 0;
+
+    for( count = 0; count <= 64; ++count )
+    {
+        for( offset = 0; offset + count <= size / 4; offset += 1021 )
+        {
+            memset( a, 0x55, count * c->dst_depth + 1 );
+            memset( b, 0x55, count * c->dst_depth + 1 );
+            c->simd( a, src + offset * c->src_depth, count );
+            c->scalar( b, src + offset * c->src_depth, count );
+            mismatches += memcmp( a, b, count * c->dst_depth + 1 ) != 0;
+        }
+    }
+    c->simd( a, src, size / c->src_depth );
+    c->scalar( b, src, size / c->src_depth );
+    mismatches += memcmp( a, b, size / c->src_depth * c->dst_depth ) != 0;
+
+    free( a );
+    free( b );
+    return mismatches == 0;
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv )
+{
+    size_t size = 1 << 24, i, j;
+    unsigned char * src = malloc( size );
+    unsigned char * dst = malloc( row_width * row_count * 4 );
+    double simd_time, scalar_time;
+    int success = 1;
+
+    // Random pixels, with alpha premultiplied as in FreeType color bitmaps
+    srand( 1 );
+    for( i = 0; i < size; i += 4 )
+    {
+        src[i+3] = rand( ) & 0xFF;
+        for( j = 0; j < 3; ++j )
+            src[i+j] = rand( ) % (src[i+3] + 1);
+    }
+
+    printf( "Rows                    : %zu x %zu pixels, %zu times\n",
+            row_count, row_width, repeat_count );
+    for( i = 0; i < sizeof(conversions) / sizeof(conversions[0]); ++i )
+    {
+        const conversion_t * c = &conversions[i];
+
+        if( !check( c, src, size ) )
+        {
+            fprintf( stderr, "%s: SIMD and scalar versions differ\n", c->name );
+            success = 0;
+        }
+        scalar_time = time_conversion( c->scalar, dst, src, c );
+        simd_time = time_conversion( c->simd, dst, src, c );
+        printf( "%-24s: %.2f ns per pixel, %.2f scalar (x%.1f)\n", c->name,
+                simd_time * 1e9 / (repeat_count * row_count * row_width),
+                scalar_time * 1e9 / (repeat_count * row_count * row_width),
+                scalar_time / simd_time );
+    }
+
+    free( src );
+    free( dst );
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,157 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freetype-gl.h"
+#include "text-buffer.h"
+#include "gpu-recorder.h"
+
+
+// ------------------------------------------------------- global variables ---
+const char * font_filename = "fonts/Vera.ttf";
+const float font_size = 14;
+const size_t line_count = 300;
+const size_t edit_count = 100;
+
+
+// ----------------------------------------------------------------- upload ---
+// Upload through the recording backend, checking GPU memory matches the
+// buffer
+int upload( vertex_buffer_t * buffer, gpu_recorder_t * gpu, const char * name )
+{
+    if( !gpu_recorder_upload( gpu, buffer ) )
+    {
+        fprintf( stderr, "%s: GPU memory differs from the buffer\n", name );
+        return 0;
+    }
+    return 1;
+}
+
+
+// ------------------------------------------------------------------ check ---
+// Whether a buffer draws with the index type it should
+int check( vertex_buffer_t * buffer, GLenum type, const char * name )
+{
+    printf( "%-24s: %6zu vertices, %s indices\n", name,
+            buffer->vertices->size,
+            buffer->GPU_itype == GL_UNSIGNED_SHORT ? "16-bit" : "32-bit" );
+    if( buffer->GPU_itype != type )
+    {
+        fprintf( stderr, "%s: wrong index type\n", name );
+        return 0;
+    }
+    return 1;
+}
+
+
+// ------------------------------------------------------------------- page ---
+// A page edited line by line, returning index bytes uploaded
+size_t page( markup_t * markup, int short_indices, int * success )
+{
+    text_buffer_t * buffer = text_buffer_new( );
+    vec2 pen = {{0, 0}};
+    char line[128];
+    gpu_recorder_t gpu;
+    size_t i, index, bytes;
+
+    memset( &gpu, 0, sizeof(gpu) );
+    vertex_buffer_short_indices( buffer->buffer, short_indices );
+    for( i = 0; i < line_count; ++i )
+    {
+        snprintf( line, sizeof(line), "%04zu: The quick brown fox jumps over "
+                  "the lazy dog.\n", i );
+        text_buffer_add_text( buffer, &pen, markup, line, 0 );
+    }
+    *success &= upload( buffer->buffer, &gpu, "Page" );
+    srand( 1 );
+    for( i = 0; i < edit_count; ++i )
+    {
+        index = rand( ) % line_count;
+        snprintf( line, sizeof(line), "%04zu: edited %zu\n", index, i );
+        text_buffer_replace_lines( buffer, &pen, index, index + 1,
+                                   markup, line, 0 );
+        *success &= upload( buffer->buffer, &gpu, "Line edit" );
+    }
+    text_buffer_erase_lines( buffer, &pen, 0, 10 );
+    *success &= upload( buffer->buffer, &gpu, "Scrolling" );
+    *success &= check( buffer->buffer,
+                       short_indices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                       short_indices ? "Edited page" : "Edited page, 32-bit" );
+
+    bytes = gpu.bytes[1];
+    gpu_recorder_clear( &gpu );
+    text_buffer_delete( buffer );
+    return bytes;
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv )
+{
+    texture_atlas_t * atlas = texture_atlas_new( 512, 512, 1 );
+    vertex_buffer_t * buffer = vertex_buffer_new( "vertex:3f" );
+    float quad[4][3] = { {0,0,0}, {0,1,0}, {1,1,0}, {1,0,0} };
+    GLuint indices[6] = { 0,1,2, 0,2,3 };
+    vec4 black = {{0.0, 0.0, 0.0, 1.0}};
+    size_t i, short_bytes, int_bytes;
+    markup_t markup;
+    gpu_recorder_t gpu;
+    int success = 1;
+
+    if( argc > 1 )
+    {
+        font_filename = argv[1];
+    }
+
+    memset( &markup, 0, sizeof(markup) );
+    markup.font = texture_font_new_from_file( atlas, font_size,
+                                              font_filename );
+    if( !markup.font )
+    {
+        fprintf( stderr, "Cannot load font %s\n", font_filename );
+        return EXIT_FAILURE;
+    }
+    markup.gamma = 1.0;
+    markup.foreground_color = black;
+    printf( "Font                    : %s, %gpt\n", font_filename, font_size );
+
+    short_bytes = page( &markup, 1, &success );
+    int_bytes = page( &markup, 0, &success );
+    printf( "Index uploads           : %zu bytes, %zu bytes 32-bit "
+            "(%.0f%%)\n", short_bytes, int_bytes,
+            100.0 * short_bytes / int_bytes );
+
+    // Growing past the 16-bit limit, then shrinking well below it
+    memset( &gpu, 0, sizeof(gpu) );
+    vertex_buffer_short_indices( buffer, 1 );
+    for( i = 0; i < 16384; ++i )
+    {
+        vertex_buffer_push_back( buffer, quad, 4, indices, 6 );
+    }
+    success &= upload( buffer, &gpu, "At the limit" );
+    success &= check( buffer, GL_UNSIGNED_SHORT, "At the limit" );
+    vertex_buffer_push_back( buffer, quad, 4, indices, 6 );
+    success &= upload( buffer, &gpu, "Past the limit" );
+    success &= check( buffer, GL_UNSIGNED_INT, "Past the limit" );
+    vertex_buffer_erase_range( buffer, 0, 4000 );
+    success &= upload( buffer, &gpu, "Below the limit" );
+    success &= check( buffer, GL_UNSIGNED_INT, "Below the limit" );
+    vertex_buffer_erase_range( buffer, 0, 4500 );
+    success &= upload( buffer, &gpu, "Half the limit" );
+    success &= check( buffer, GL_UNSIGNED_SHORT, "Half the limit" );
+    vertex_buffer_erase( buffer, 100 );
+    vertex_buffer_insert( buffer, 10, quad, 4, indices, 6 );
+    success &= upload( buffer, &gpu, "Insert and erase" );
+
+    gpu_recorder_clear( &gpu );
+    vertex_buffer_delete( buffer );
+    texture_font_delete( markup.font );
+    texture_atlas_delete( atlas );
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
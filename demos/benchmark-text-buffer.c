@@ -0,0 +1,313 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "freetype-gl.h"
+#include "text-buffer.h"
+#include "utf8-utils.h"
+
+
+// ------------------------------------------------------- global variables ---
+const char * font_filename = "fonts/Vera.ttf";
+const float font_size = 16;
+const size_t repeat_count = 200;
+const char * paragraph =
+    "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Ut enim ad "
+    "minim veniam, quis nostrud exercitation ullamco laboris nisi ut aliquip "
+    "ex ea commodo consequat.\nDuis aute irure dolor in reprehenderit in "
+    "voluptate velit esse cillum dolore eu fugiat nulla pariatur. Déjà vu, "
+    "façade, naïve: AVAST Wa To.\n";
+
+
+// ----------------------------------------------------------- add_per_char ---
+// Add text one character at a time, as text_buffer_add_text used to
+void add_per_char( text_buffer_t * buffer, vec2 * pen, markup_t * markup,
+                   const char * text )
+{
+    const char * previous = NULL;
+    size_t i;
+
+    if( vertex_buffer_size( buffer->buffer ) == 0 )
+    {
+        buffer->origin = *pen;
+        buffer->line_left = pen->x;
+        buffer->bounds.left = pen->x;
+        buffer->bounds.top = pen->y;
+    }
+    for( i = 0; text[i]; i += utf8_surrogate_len( text + i ) )
+    {
+        text_buffer_add_char( buffer, pen, markup, text + i, previous );
+        previous = text + i;
+    }
+    buffer->last_pen_y = pen->y;
+}
+
+
+// ---------------------------------------------------------------- compare ---
+// Whether both buffers have the same vertices, indices and items
+int compare( const text_buffer_t * a, const text_buffer_t * b )
+{
+    const vector_t * vectors[3][2] = {
+        { a->buffer->vertices, b->buffer->vertices },
+        { a->buffer->indices, b->buffer->indices },
+        { a->buffer->items, b->buffer->items } };
+    size_t i;
+
+    for( i = 0; i < 3; ++i )
+    {
+        if( vectors[i][0]->size != vectors[i][1]->size ||
+            memcmp( vectors[i][0]->items, vectors[i][1]->items,
+                    vectors[i][0]->size * vectors[i][0]->item_size ) )
+            return 0;
+    }
+    return a->lines->size == b->lines->size &&
+           !memcmp( &a->bounds, &b->bounds, sizeof(vec4) );
+}
+
+
+// ------------------------------------------------------------ same_packed ---
+// Whether packed vertices are the float ones, up to quantization
+int same_packed( const text_buffer_t * packed, const text_buffer_t * full )
+{
+    const glyph_vertex_packed_t * p = packed->buffer->vertices->items;
+    const glyph_vertex_t * f = full->buffer->vertices->items;
+    size_t i;
+
+    if( packed->buffer->vertices->size != full->buffer->vertices->size ||
+        packed->buffer->indices->size != full->buffer->indices->size ||
+        memcmp( packed->buffer->indices->items, full->buffer->indices->items,
+                full->buffer->indices->size * sizeof(GLuint) ) )
+        return 0;
+    for( i = 0; i < full->buffer->vertices->size; ++i, ++p, ++f )
+    {
+        if( p->x != f->x || p->y != f->y || p->layer ||
+            fabsf( p->u - f->u * 65535 ) > .5f ||
+            fabsf( p->v - f->v * 65535 ) > .5f ||
+            fabsf( p->r - f->r * 255 ) > .5f ||
+            fabsf( p->g - f->g * 255 ) > .5f ||
+            fabsf( p->b - f->b * 255 ) > .5f ||
+            fabsf( p->a - f->a * 255 ) > .5f ||
+            fabsf( p->shift - f->shift * 127 ) > .5f ||
+            fabsf( p->gamma - f->gamma * 32 ) > .5f )
+            return 0;
+    }
+    return 1;
+}
+
+
+// --------------------------------------------------------- same_instanced ---
+// Whether instances expand to the float vertices, corner by corner
+int same_instanced( const text_buffer_t * instanced,
+                    const text_buffer_t * full )
+{
+    const float corners[4][2] = { {0,0}, {0,1}, {1,1}, {1,0} };
+    const glyph_instance_t * instance = instanced->buffer->vertices->items;
+    const glyph_vertex_t * f = full->buffer->vertices->items;
+    size_t i, j;
+
+    if( instanced->buffer->items->size != full->buffer->items->size ||
+        instanced->buffer->indices->size ||
+        4 * instanced->buffer->vertices->size !=
+        full->buffer->vertices->size )
+        return 0;
+    for( i = 0; i < instanced->buffer->vertices->size; ++i, ++instance )
+    {
+        for( j = 0; j < 4; ++j, ++f )
+        {
+            float x = corners[j][0], y = corners[j][1];
+            if( instance->x + x * instance->width != f->x ||
+                instance->y + y * instance->height != f->y ||
+                (x ? instance->s1 : instance->s0) != f->u ||
+                (y ? instance->t1 : instance->t0) != f->v ||
+                (x ? instance->shift1 : instance->shift0) != f->shift ||
+                instance->r != f->r || instance->g != f->g ||
+                instance->b != f->b || instance->a != f->a ||
+                instance->gamma != f->gamma || instance->layer )
+                return 0;
+        }
+    }
+    return 1;
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv )
+{
+    texture_atlas_t * atlas = texture_atlas_new( 512, 512, 1 );
+    text_buffer_t * bulk = text_buffer_new( );
+    text_buffer_t * per_char = text_buffer_new( );
+    text_buffer_t * packed;
+    text_buffer_t * instanced;
+    markup_t markups[2];
+    const char * names[2] = { "Plain", "Underline, background" };
+    vec4 black = {{0.0, 0.0, 0.0, 1.0}};
+    vec4 yellow = {{1.0, 1.0, 0.0, 1.0}};
+    char * text;
+    size_t i, j, k, glyphs;
+    clock_t start;
+    double bulk_time, per_char_time, packed_time, instanced_time;
+    size_t full_size, packed_size, instanced_size;
+    vec2 pen, other;
+    int success = 1;
+
+    if( argc > 1 )
+    {
+        font_filename = argv[1];
+    }
+
+    packed = text_buffer_new_with_format( GLYPH_VERTEX_PACKED );
+    instanced = text_buffer_new_with_format( GLYPH_VERTEX_INSTANCED );
+    memset( markups, 0, sizeof(markups) );
+    markups[0].font = texture_font_new_from_file( atlas, font_size,
+                                                  font_filename );
+    if( !markups[0].font )
+    {
+        fprintf( stderr, "Cannot load font %s\n", font_filename );
+        return EXIT_FAILURE;
+    }
+    markups[0].gamma = 1.0;
+    markups[0].foreground_color = black;
+    markups[1] = markups[0];
+    markups[1].underline = 1;
+    markups[1].underline_color = black;
+    markups[1].background_color = yellow;
+
+    // A page of text, made of the same paragraph
+    text = malloc( 20 * strlen( paragraph ) + 1 );
+    text[0] = 0;
+    for( i = 0; i < 20; ++i )
+        strcat( text, paragraph );
+    glyphs = utf8_strlen( text );
+    printf( "Font                    : %s, %gpt\n", font_filename, font_size );
+    printf( "Text                    : %zu characters, %zu times\n",
+            glyphs, repeat_count );
+
+    for( i = 0; i < 2; ++i )
+    {
+        // Glyphs are loaded once, layout is what is timed
+        pen.x = 0; pen.y = 0;
+        text_buffer_add_text( bulk, &pen, &markups[i], text, 0 );
+        text_buffer_clear( bulk );
+
+        start = clock( );
+        for( j = 0; j < repeat_count; ++j )
+        {
+            text_buffer_clear( bulk );
+            pen.x = 0; pen.y = 0;
+            text_buffer_add_text( bulk, &pen, &markups[i], text, 0 );
+        }
+        bulk_time = (double)(clock( ) - start) / CLOCKS_PER_SEC;
+
+        start = clock( );
+        for( j = 0; j < repeat_count; ++j )
+        {
+            text_buffer_clear( per_char );
+            other.x = 0; other.y = 0;
+            add_per_char( per_char, &other, &markups[i], text );
+        }
+        per_char_time = (double)(clock( ) - start) / CLOCKS_PER_SEC;
+
+        printf( "%-24s: %.1f M glyphs/s, %.1f per character (x%.1f)\n",
+                names[i], glyphs * repeat_count / bulk_time * 1e-6,
+                glyphs * repeat_count / per_char_time * 1e-6,
+                per_char_time / bulk_time );
+
+        // Both must lay out the same, including when appending to a line
+        for( k = 0; k < 2; ++k )
+        {
+            text_buffer_add_text( bulk, &pen, &markups[1-i], paragraph, 0 );
+            add_per_char( per_char, &other, &markups[1-i], paragraph );
+        }
+        if( !compare( bulk, per_char ) ||
+            pen.x != other.x || pen.y != other.y )
+        {
+            fprintf( stderr, "%s: layouts differ\n", names[i] );
+            success = 0;
+        }
+        text_buffer_clear( bulk );
+        text_buffer_clear( per_char );
+
+        // Packed vertices, what is uploaded to the GPU is what they save.
+        // Vertices are compared once lines are centered, which moves them,
+        // and once more when they are then right aligned
+        start = clock( );
+        for( j = 0; j < repeat_count; ++j )
+        {
+            text_buffer_clear( packed );
+            other.x = 0; other.y = 0;
+            text_buffer_add_text( packed, &other, &markups[i], text, 0 );
+        }
+        packed_time = (double)(clock( ) - start) / CLOCKS_PER_SEC;
+        pen.x = 0; pen.y = 0;
+        text_buffer_add_text( bulk, &pen, &markups[i], text, 0 );
+        full_size = bulk->buffer->vertices->size *
+                    bulk->buffer->vertices->item_size;
+        packed_size = packed->buffer->vertices->size *
+                      packed->buffer->vertices->item_size;
+        printf( "%-24s: %.1f M glyphs/s, %zu kB of vertices, %zu kB as "
+                "floats (x%.1f)\n", "  packed",
+                glyphs * repeat_count / packed_time * 1e-6,
+                packed_size / 1024, full_size / 1024,
+                (double) full_size / packed_size );
+        text_buffer_align( bulk, &pen, ALIGN_CENTER );
+        text_buffer_align( packed, &other, ALIGN_CENTER );
+        if( !same_packed( packed, bulk ) )
+        {
+            fprintf( stderr, "%s: packed vertices differ\n", names[i] );
+            success = 0;
+        }
+        text_buffer_align( bulk, &pen, ALIGN_RIGHT );
+        text_buffer_align( packed, &other, ALIGN_RIGHT );
+        if( !same_packed( packed, bulk ) )
+        {
+            fprintf( stderr, "%s: right aligned packed vertices differ\n",
+                     names[i] );
+            success = 0;
+        }
+
+        // Instances, one per quad without indices
+        start = clock( );
+        for( j = 0; j < repeat_count; ++j )
+        {
+            text_buffer_clear( instanced );
+            other.x = 0; other.y = 0;
+            text_buffer_add_text( instanced, &other, &markups[i], text, 0 );
+        }
+        instanced_time = (double)(clock( ) - start) / CLOCKS_PER_SEC;
+        full_size += bulk->buffer->indices->size * sizeof(GLuint);
+        instanced_size = instanced->buffer->vertices->size *
+                         instanced->buffer->vertices->item_size;
+        printf( "%-24s: %.1f M glyphs/s, %zu kB of instances, %zu kB of "
+                "vertices and indices (x%.1f)\n", "  instanced",
+                glyphs * repeat_count / instanced_time * 1e-6,
+                instanced_size / 1024, full_size / 1024,
+                (double) full_size / instanced_size );
+        text_buffer_align( instanced, &other, ALIGN_CENTER );
+        text_buffer_align( instanced, &other, ALIGN_RIGHT );
+        if( !same_instanced( instanced, bulk ) )
+        {
+            fprintf( stderr, "%s: instances differ\n", names[i] );
+            success = 0;
+        }
+        text_buffer_clear( bulk );
+        text_buffer_clear( packed );
+        text_buffer_clear( instanced );
+    }
+
+    text_buffer_delete( instanced );
+    text_buffer_delete( packed );
+    text_buffer_delete( bulk );
+    text_buffer_delete( per_char );
+    texture_font_delete( markups[0].font );
+    texture_atlas_delete( atlas );
+    free( text );
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
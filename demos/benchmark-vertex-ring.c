@@ -0,0 +1,230 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freetype-gl.h"
+#include "vertex-buffer.h"
+#include "vertex-ring.h"
+#include "gpu-recorder.h"
+
+
+// ------------------------------------------------------- global variables ---
+const char * font_filename = "fonts/VeraMono.ttf";
+const float font_size = 13;
+const size_t visible_lines = 200;
+const size_t line_count = 20000;
+const size_t max_length = 100;
+
+
+// ------------------------------------------------------- typedef & struct ---
+typedef struct {
+    float x, y, z;
+    float s, t;
+    float r, g, b, a;
+} vertex_t;
+
+
+// -------------------------------------------------------------- make_line ---
+// Glyph quads of a log line, lines going down from y = 0
+size_t make_line( texture_font_t * font, size_t number,
+                  vertex_t * vertices, GLuint * indices )
+{
+    char text[128];
+    float x = 0, y = -(float) number * font->height;
+    size_t i, n = 0;
+
+    snprintf( text, sizeof(text), "[%06zu] %.*s", number,
+              (int) ( number * 7919 % ( max_length - 10 ) ),
+              "Lorem ipsum dolor sit amet, consectetur adipiscing elit, "
+              "sed do eiusmod tempor incididunt ut labore et dolore magna "
+              "aliqua" );
+    for( i = 0; text[i]; ++i )
+    {
+        texture_glyph_t * glyph = texture_font_get_glyph( font, text + i );
+        float x0 = x + glyph->offset_x, y0 = y + glyph->offset_y;
+        float x1 = x0 + glyph->width, y1 = y0 - glyph->height;
+        vertex_t quad[4] = {
+            { x0,y0,0, glyph->s0,glyph->t0, 0,0,0,1 },
+            { x0,y1,0, glyph->s0,glyph->t1, 0,0,0,1 },
+            { x1,y1,0, glyph->s1,glyph->t1, 0,0,0,1 },
+            { x1,y0,0, glyph->s1,glyph->t0, 0,0,0,1 } };
+        GLuint quad_indices[6] = { 0,1,2, 0,2,3 };
+        size_t j;
+
+        memcpy( vertices + 4 * n, quad, sizeof(quad) );
+        for( j = 0; j < 6; ++j )
+        {
+            indices[6 * n + j] = 4 * n + quad_indices[j];
+        }
+        x += glyph->advance_x;
+        ++n;
+    }
+    return n;
+}
+
+
+// ---------------------------------------------------------- same_as_ring ---
+// Whether the ring draws what the buffer draws, following the index
+// segments vertex_ring_render draws
+int same_as_ring( const vertex_ring_t * ring, const vertex_buffer_t * buffer )
+{
+    const vertex_ring_span_t * span = &ring->indices;
+    const GLuint * x = (const GLuint *) ring->buffer->indices->items;
+    const GLuint * y = (const GLuint *) buffer->indices->items;
+    size_t segments[2][2] = { { 0, 0 }, { 0, 0 } };
+    size_t i, j, k = 0;
+
+    if( span->used && span->head > span->tail )
+    {
+        segments[0][0] = span->tail;
+        segments[0][1] = span->head;
+    }
+    else if( span->used )
+    {
+        segments[0][0] = span->tail;
+        segments[0][1] = span->end;
+        segments[1][1] = span->head;
+    }
+    for( i = 0; i < 2; ++i )
+    {
+        for( j = segments[i][0]; j < segments[i][1]; ++j, ++k )
+        {
+            if( k >= buffer->indices->size ||
+                memcmp( vector_get( ring->buffer->vertices, x[j] ),
+                        vector_get( buffer->vertices, y[k] ),
+                        sizeof(vertex_t) ) )
+                return 0;
+        }
+    }
+    return k == buffer->indices->size;
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv )
+{
+    texture_atlas_t * atlas = texture_atlas_new( 512, 512, 1 );
+    texture_font_t * font;
+    const char * format = "vertex:3f,tex_coord:2f,color:4f";
+    vertex_buffer_t * immediate = vertex_buffer_new( format );
+    vertex_buffer_t * deferred = vertex_buffer_new( format );
+    vertex_ring_t * ring;
+    vertex_t * vertices;
+    GLuint * indices;
+    gpu_recorder_t ring_gpu, buffer_gpu;
+    size_t i, n, kept;
+    clock_t start;
+    double ring_time = 0, immediate_time = 0, deferred_time = 0;
+    int success = 1;
+
+    if( argc > 1 )
+    {
+        font_filename = argv[1];
+    }
+
+    font = texture_font_new_from_file( atlas, font_size, font_filename );
+    if( !font )
+    {
+        fprintf( stderr, "Cannot load font %s\n", font_filename );
+        return EXIT_FAILURE;
+    }
+    vertices = malloc( 4 * max_length * sizeof(vertex_t) );
+    indices = malloc( 6 * max_length * sizeof(GLuint) );
+    ring = vertex_ring_new( format, 4 * max_length * visible_lines / 2,
+                            6 * max_length * visible_lines / 2 );
+    vertex_buffer_defer_erase( deferred, 0.5 );
+    memset( &ring_gpu, 0, sizeof(ring_gpu) );
+    memset( &buffer_gpu, 0, sizeof(buffer_gpu) );
+    printf( "Font                    : %s, %gpt\n", font_filename, font_size );
+
+    // Lines are streamed, the ring expiring the oldest ones as it needs.
+    // Buffers erase the oldest ones to keep the same lines.
+    for( i = 0; i < line_count; ++i )
+    {
+        n = make_line( font, i, vertices, indices );
+
+        start = clock( );
+        vertex_ring_push_back( ring, vertices, 4 * n, indices, 6 * n );
+        ring_time += clock( ) - start;
+
+        start = clock( );
+        while( vertex_buffer_size( immediate ) >= vertex_ring_size( ring ) )
+        {
+            vertex_buffer_erase( immediate, 0 );
+        }
+        vertex_buffer_push_back( immediate, vertices, 4 * n, indices, 6 * n );
+        immediate_time += clock( ) - start;
+
+        start = clock( );
+        while( vertex_buffer_size( deferred ) >= vertex_ring_size( ring ) )
+        {
+            vertex_buffer_erase( deferred, 0 );
+        }
+        vertex_buffer_push_back( deferred, vertices, 4 * n, indices, 6 * n );
+        deferred_time += clock( ) - start;
+
+        // One frame per line
+        if( !gpu_recorder_upload( &ring_gpu, ring->buffer ) ||
+            !gpu_recorder_upload( &buffer_gpu, immediate ) )
+        {
+            fprintf( stderr, "Line %zu: GPU memory differs\n", i );
+            success = 0;
+            break;
+        }
+        if( ( i % 1009 == 0 || i == line_count - 1 ) &&
+            !same_as_ring( ring, immediate ) )
+        {
+            fprintf( stderr, "Line %zu: ring draws differently\n", i );
+            success = 0;
+            break;
+        }
+    }
+
+    // Expiring explicitly, then everything
+    kept = vertex_ring_size( ring );
+    n = kept / 2;
+    vertex_ring_expire( ring, n );
+    vertex_buffer_erase_range( immediate, 0, n );
+    if( !same_as_ring( ring, immediate ) )
+    {
+        fprintf( stderr, "Expired lines: ring draws differently\n" );
+        success = 0;
+    }
+    vertex_ring_clear( ring );
+    if( vertex_ring_size( ring ) || ring->vertices.used || ring->indices.used )
+    {
+        fprintf( stderr, "Cleared ring is not empty\n" );
+        success = 0;
+    }
+
+    printf( "Log lines               : %zu, %zu kept\n",
+            line_count, kept );
+    printf( "Appending a line        : %.2f us, %.2f us erasing, "
+            "%.2f us deferred\n",
+            ring_time * 1e6 / CLOCKS_PER_SEC / line_count,
+            immediate_time * 1e6 / CLOCKS_PER_SEC / line_count,
+            deferred_time * 1e6 / CLOCKS_PER_SEC / line_count );
+    printf( "Uploads per line        : %.1f kB, %.1f kB erasing (x%.0f)\n",
+            ( ring_gpu.bytes[0] + ring_gpu.bytes[1] ) / 1024.0 / line_count,
+            ( buffer_gpu.bytes[0] + buffer_gpu.bytes[1] ) / 1024.0 / line_count,
+            (double) ( buffer_gpu.bytes[0] + buffer_gpu.bytes[1] ) /
+            ( ring_gpu.bytes[0] + ring_gpu.bytes[1] ) );
+
+    gpu_recorder_clear( &ring_gpu );
+    gpu_recorder_clear( &buffer_gpu );
+    free( vertices );
+    free( indices );
+    vertex_ring_delete( ring );
+    vertex_buffer_delete( immediate );
+    vertex_buffer_delete( deferred );
+    texture_font_delete( font );
+    texture_atlas_delete( atlas );
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
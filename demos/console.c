@@ -296,14 +296,35 @@ console_render( console_t *self )
 
     if( self->lines->size || self->prompt[0] != '\0' || self->input[0] != '\0' )
     {
+        const ivec4 * dirty;
+        size_t dirty_count, i;
+
         glBindTexture( GL_TEXTURE_2D, self->atlas->id );
         glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
         glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
         glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
         glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-        glTexImage2D( GL_TEXTURE_2D, 0, GL_RED, self->atlas->width,
-                      self->atlas->height, 0, GL_RED, GL_UNSIGNED_BYTE,
-                      self->atlas->data );
+
+        // Only upload the rows of the atlas modified since the last frame
+        dirty = texture_atlas_get_dirty( self->atlas, &dirty_count );
+        for( i = 0; i < dirty_count; ++i )
+        {
+            if( dirty[i].width == self->atlas->width &&
+                dirty[i].height == self->atlas->height )
+            {
+                glTexImage2D( GL_TEXTURE_2D, 0, GL_RED, self->atlas->width,
+                              self->atlas->height, 0, GL_RED, GL_UNSIGNED_BYTE,
+                              self->atlas->data );
+            }
+            else
+            {
+                glTexSubImage2D( GL_TEXTURE_2D, 0, 0, dirty[i].y,
+                                 self->atlas->width, dirty[i].height,
+                                 GL_RED, GL_UNSIGNED_BYTE,
+                                 self->atlas->data + dirty[i].y * self->atlas->width );
+            }
+        }
+        texture_atlas_clear_dirty( self->atlas );
     }
 
     // Cursor (we use the black character (NULL) as texture )
@@ -0,0 +1,73 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "gpu-recorder.h"
+
+
+// ---------------------------------------------------- gpu_recorder_record ---
+void
+gpu_recorder_record( vertex_buffer_t * buffer,
+                     const vertex_buffer_transfer_t * transfer,
+                     void * data )
+{
+    gpu_recorder_t * self = (gpu_recorder_t *) data;
+    int k = transfer->target == GL_ELEMENT_ARRAY_BUFFER;
+
+    if( transfer->allocate )
+    {
+        free( self->data[k] );
+        self->data[k] = malloc( transfer->allocate );
+        self->size[k] = transfer->allocate;
+        memset( self->data[k], 0xcd, transfer->allocate );
+    }
+    if( transfer->offset + transfer->size > self->size[k] )
+    {
+        self->overflow = 1;
+        return;
+    }
+    memcpy( self->data[k] + transfer->offset, transfer->data, transfer->size );
+    self->transfers++;
+    self->bytes[k] += transfer->size;
+}
+
+
+// ---------------------------------------------------- gpu_recorder_upload ---
+int
+gpu_recorder_upload( gpu_recorder_t * self,
+                     vertex_buffer_t * buffer )
+{
+    const GLuint * indices = (const GLuint *) buffer->indices->items;
+    size_t vsize = buffer->vertices->size * buffer->vertices->item_size;
+    size_t i;
+
+    vertex_buffer_upload_with( buffer, gpu_recorder_record, self );
+    if( self->overflow ||
+        ( vsize && memcmp( self->data[0], buffer->vertices->items, vsize ) ) )
+    {
+        return 0;
+    }
+    for( i = 0; i < buffer->indices->size; ++i )
+    {
+        if( buffer->GPU_itype == GL_UNSIGNED_SHORT
+            ? ((const GLushort *) self->data[1])[i] != indices[i]
+            : ((const GLuint *) self->data[1])[i] != indices[i] )
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+// ----------------------------------------------------- gpu_recorder_clear ---
+void
+gpu_recorder_clear( gpu_recorder_t * self )
+{
+    free( self->data[0] );
+    free( self->data[1] );
+    memset( self, 0, sizeof(*self) );
+}
@@ -0,0 +1,115 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#ifndef __GPU_RECORDER_H__
+#define __GPU_RECORDER_H__
+
+#include <stddef.h>
+#include "vertex-buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+namespace ftgl {
+#endif
+
+/**
+ * @file   gpu-recorder.h
+ *
+ * @defgroup gpu-recorder GPU recorder
+ *
+ * A vertex_buffer_upload_with backend that keeps GPU memory in main memory,
+ * for the upload benchmarks to count what is sent and check it ends up
+ * matching the buffer.
+ *
+ * <b>Example Usage</b>:
+ * @code
+ * #include "gpu-recorder.h"
+ *
+ * int main( int arrgc, char *argv[] )
+ * {
+ *     gpu_recorder_t gpu;
+ *
+ *     memset( &gpu, 0, sizeof(gpu) );
+ *     if( !gpu_recorder_upload( &gpu, buffer ) )
+ *         return 1;
+ *     printf( "%zu bytes\n", gpu.bytes[0] + gpu.bytes[1] );
+ *     gpu_recorder_clear( &gpu );
+ *
+ *     return 0;
+ * }
+ * @endcode
+ *
+ * @{
+ */
+
+/**
+ * GPU memory as the recording backend sees it: one copy of the vertices
+ * (index 0) and one of the indices (index 1). Zero it before use.
+ */
+typedef struct
+{
+    /** Contents of each GPU buffer */
+    char * data[2];
+
+    /** Size of each GPU buffer */
+    size_t size[2];
+
+    /** Number of transfers recorded */
+    size_t transfers;
+
+    /** Bytes sent to each GPU buffer */
+    size_t bytes[2];
+
+    /** Whether a transfer went past the end of its GPU buffer */
+    int overflow;
+} gpu_recorder_t;
+
+
+/**
+ * Record a transfer, to be given to vertex_buffer_upload_with along with a
+ * gpu_recorder_t. Newly allocated GPU memory is filled with garbage, so
+ * that bytes never sent show up.
+ *
+ * @param buffer    the buffer being uploaded
+ * @param transfer  the transfer to record
+ * @param data      a gpu_recorder_t
+ */
+  void
+  gpu_recorder_record( vertex_buffer_t * buffer,
+                       const vertex_buffer_transfer_t * transfer,
+                       void * data );
+
+
+/**
+ * Upload a buffer through the recording backend, adding to the counts.
+ *
+ * @param self    a GPU recorder
+ * @param buffer  the buffer to upload
+ *
+ * @return 1 if GPU memory matches the buffer afterwards, indices being
+ *         compared in the type the buffer draws them with, 0 otherwise
+ */
+  int
+  gpu_recorder_upload( gpu_recorder_t * self,
+                       vertex_buffer_t * buffer );
+
+
+/**
+ * Free the GPU memory of a recorder.
+ *
+ * @param self  a GPU recorder
+ */
+  void
+  gpu_recorder_clear( gpu_recorder_t * self );
+
+
+/** @} */
+
+#ifdef __cplusplus
+}
+}
+#endif
+
+#endif /* __GPU_RECORDER_H__ */
@@ -36,8 +36,10 @@ mat4 model, view, projection;
 
 const char *text = "صِف خَلقَ خَودِ كَمِثلِ الشَمسِ إِذ بَزَغَت — يَحظى الضَجيعُ بِها نَجلاءَ مِعطارِ";
 const char *font_filename      = "fonts/amiri-regular.ttf";
-const hb_direction_t direction = HB_DIRECTION_RTL;
-const hb_script_t script       = HB_SCRIPT_ARABIC;
+// Guessed from the text (Arabic, right to left), as texture_font_load_glyphs
+// does, so that the text is shaped once for both
+const hb_direction_t direction = HB_DIRECTION_INVALID;
+const hb_script_t script       = HB_SCRIPT_INVALID;
 const char *language           = "ar";
 
 
@@ -59,24 +61,21 @@ void init( void )
     vbuffer = vertex_buffer_new( "vertex:3f,tex_coord:2f,"
                                 "color:4f,ashift:1f,agamma:1f" );
 
-    /* Create a buffer for harfbuzz to use */
-    hb_buffer_t *buffer = hb_buffer_create();
-
     for (i=0; i < 20; ++i)
     {
-        hb_buffer_set_language( buffer,
-                                hb_language_from_string(language, strlen(language)) );
-        hb_buffer_add_utf8( buffer, text, strlen(text), 0, strlen(text) );
-        hb_buffer_guess_segment_properties( buffer );
-        hb_shape( fonts[i]->hb_ft_font, buffer, NULL, 0 );
-
-        unsigned int         glyph_count;
-        hb_glyph_info_t     *glyph_info =
-            hb_buffer_get_glyph_infos(buffer, &glyph_count);
-        hb_glyph_position_t *glyph_pos =
-            hb_buffer_get_glyph_positions(buffer, &glyph_count);
-
-        texture_font_load_glyphs( fonts[i], text, language );
+        /* Shaping results are cached by the font, so that shaping the same
+         * text again (e.g. every frame) costs a lookup */
+        const texture_shaping_t *shaping =
+            texture_font_shape( fonts[i], text, language, script, direction,
+                                NULL, 0 );
+        if( !shaping )
+        {
+            fprintf( stderr, "Cannot shape text at size %d\n", (int) (12+i) );
+            continue;
+        }
+        unsigned int               glyph_count = shaping->glyph_count;
+        const hb_glyph_info_t     *glyph_info = shaping->glyph_info;
+        const hb_glyph_position_t *glyph_pos = shaping->glyph_pos;
 
         float gamma = 1.0;
         float shift = 0.0;
@@ -129,8 +128,6 @@ void init( void )
             x += x_advance;
             y += y_advance;
         }
-        /* clean up the buffer, but don't kill it just yet */
-        hb_buffer_reset(buffer);
     }
 
     glClearColor(1,1,1,1);
@@ -9,6 +9,8 @@
 #include <string.h>
 #include "edtaa3func.h"
 
+#define SQRT2F 1.4142136f
+
 
 double *
 make_distance_mapd( double *data, unsigned int width, unsigned int height )
@@ -103,3 +105,196 @@ make_distance_mapb( unsigned char *img,
 
     return out;
 }
+
+/*
+ * Single precision version of edgedf() from edtaa3func.c: distance from the
+ * centre of an edge pixel of greyscale value a to the edge, given the edge
+ * normal (gx,gy) or the direction the pixel is seen from.
+ */
+static float
+edgedff( float gx, float gy, float a )
+{
+    float glength, temp, a1;
+
+    if( gx == 0 || gy == 0 )
+        return 0.5f - a;
+
+    glength = sqrtf( gx*gx + gy*gy );
+    gx = fabsf( gx / glength );
+    gy = fabsf( gy / glength );
+    if( gx < gy )
+    {
+        temp = gx;
+        gx = gy;
+        gy = temp;
+    }
+    a1 = 0.5f*gy/gx;
+    if( a < a1 )
+        return 0.5f*(gx + gy) - sqrtf( 2.0f*gx*gy*a );
+    else if( a < 1.0f - a1 )
+        return (0.5f - a)*gx;
+    return -0.5f*(gx + gy) + sqrtf( 2.0f*gx*gy*(1.0f - a) );
+}
+
+/*
+ * Dead reckoning distance transform: each pixel keeps a reference to the
+ * object pixel closest to it, which one forward and one backward scan
+ * propagate to the neighbours. Unlike edtaa3() the number of scans is
+ * bounded, at the cost of a slightly larger error far from the edges.
+ */
+static void
+deadreckoning( const float *img, const float *gx, const float *gy,
+               unsigned int width, unsigned int height,
+               int *closest, float *dist )
+{
+    static const int forward[4][2] = { {-1,-1}, {0,-1}, {1,-1}, {-1,0} };
+    static const int backward[4][2] = { {1,0}, {-1,1}, {0,1}, {1,1} };
+    const int (*neighbours)[2];
+    int x, y, i, j, k, n, pass;
+    float d, dx, dy;
+
+    for( i = 0; i < (int)(width*height); ++i )
+    {
+        if( img[i] <= 0.0f )
+        {
+            closest[i] = -1;
+            dist[i] = FLT_MAX;
+        }
+        else
+        {
+            closest[i] = i;
+            dist[i] = img[i] < 1.0f ? edgedff( gx[i], gy[i], img[i] ) : 0.0f;
+        }
+    }
+
+    for( pass = 0; pass < 2; ++pass )
+    {
+        neighbours = pass ? backward : forward;
+        for( k = 0; k < (int)height; ++k )
+        {
+            y = pass ? (int)height - 1 - k : k;
+            for( j = 0; j < (int)width; ++j )
+            {
+                x = pass ? (int)width - 1 - j : j;
+                i = y*(int)width + x;
+                if( dist[i] <= 0.0f )
+                    continue;
+                for( n = 0; n < 4; ++n )
+                {
+                    int nx = x + neighbours[n][0];
+                    int ny = y + neighbours[n][1];
+                    int c;
+
+                    if( nx < 0 || ny < 0 || nx >= (int)width || ny >= (int)height )
+                        continue;
+                    c = closest[ny*width + nx];
+                    if( c < 0 || c == closest[i] )
+                        continue;
+
+                    // Same metric as distaa3() in edtaa3func.c. The edge
+                    // is at most sqrt(2)/2 away from the centre of an edge
+                    // pixel, so most candidates are rejected before any
+                    // square root.
+                    dx = (float)(x - c % (int)width);
+                    dy = (float)(y - c / (int)width);
+                    d = dx*dx + dy*dy;
+                    if( d >= (dist[i] + 0.7072f) * (dist[i] + 0.7072f) )
+                        continue;
+                    d = sqrtf( d ) + edgedff( dx, dy, img[c] );
+                    if( d < dist[i] )
+                    {
+                        closest[i] = c;
+                        dist[i] = d;
+                    }
+                }
+            }
+        }
+    }
+}
+
+unsigned char *
+make_distance_mapb_dr( unsigned char *img,
+                       unsigned int width, unsigned int height )
+{
+    size_t size = (size_t)width * height;
+    float * data    = (float *) malloc( size * sizeof(float) );
+    float * gx      = (float *) calloc( size, sizeof(float) );
+    float * gy      = (float *) calloc( size, sizeof(float) );
+    float * outside = (float *) malloc( size * sizeof(float) );
+    float * inside  = (float *) malloc( size * sizeof(float) );
+    int * closest   = (int *) malloc( size * sizeof(int) );
+    unsigned char *out = (unsigned char *) malloc( size * sizeof(unsigned char) );
+    unsigned char img_min = 255, img_max = 0;
+    float vmin = 0.0f;
+    unsigned int x, y;
+    size_t i;
+
+    // Map values to 0.0 - 1.0, as make_distance_mapb
+    for( i=0; i<size; ++i )
+    {
+        if( img[i] > img_max )
+            img_max = img[i];
+        if( img[i] < img_min )
+            img_min = img[i];
+    }
+    for( i=0; i<size; ++i )
+        data[i] = img_max ? (img[i]-img_min)/(float)img_max : 0.0f;
+
+    // Gradient at edge pixels, as computegradient() in edtaa3func.c. The
+    // gradient of 1-bitmap is its opposite, edgedff() ignores the sign.
+    for( y=1; y+1<height; ++y )
+    {
+        for( x=1; x+1<width; ++x )
+        {
+            float glength;
+            i = (size_t)y*width + x;
+            if( data[i] <= 0.0f || data[i] >= 1.0f )
+                continue;
+            gx[i] = -data[i-width-1] - SQRT2F*data[i-1] - data[i+width-1]
+                  +  data[i-width+1] + SQRT2F*data[i+1] + data[i+width+1];
+            gy[i] = -data[i-width-1] - SQRT2F*data[i-width] - data[i-width+1]
+                  +  data[i+width-1] + SQRT2F*data[i+width] + data[i+width+1];
+            glength = sqrtf( gx[i]*gx[i] + gy[i]*gy[i] );
+            if( glength > 0.0f )
+            {
+                gx[i] /= glength;
+                gy[i] /= glength;
+            }
+        }
+    }
+
+    // Transform background (0's), then foreground (1's)
+    deadreckoning( data, gx, gy, width, height, closest, outside );
+    for( i=0; i<size; ++i )
+        data[i] = 1.0f - data[i];
+    deadreckoning( data, gx, gy, width, height, closest, inside );
+
+    // Bipolar distance field, clamped to the largest inside distance
+    for( i=0; i<size; ++i )
+    {
+        if( outside[i] < 0.0f )
+            outside[i] = 0.0f;
+        if( inside[i] < 0.0f )
+            inside[i] = 0.0f;
+        outside[i] -= inside[i];
+        if( -outside[i] > vmin )
+            vmin = -outside[i];
+    }
+
+    // map values from -vmin - +vmin to 255 - 0
+    for( i=0; i<size; ++i )
+    {
+        float v = outside[i];
+        if     ( v < -vmin) v = -vmin;
+        else if( v > +vmin) v = +vmin;
+        out[i] = vmin > 0.0f ? (unsigned char)(255*(vmin-v)/(2*vmin)) : 0;
+    }
+
+    free( data );
+    free( gx );
+    free( gy );
+    free( outside );
+    free( inside );
+    free( closest );
+    return out;
+}
@@ -57,6 +57,23 @@ unsigned char *
 make_distance_mapb( unsigned char *img,
                     unsigned int width, unsigned int height );
 
+/**
+ * Create a distance field from the given image with a single precision
+ * dead reckoning transform. It scans the image a fixed number of times and
+ * needs less memory than make_distance_mapb, for a slightly larger error
+ * far from the edges.
+ *
+ * @param img     A greyscale image.
+ * @param width   The width of the given image.
+ * @param height  The height of the given image.
+ *
+ * @return        A newly allocated distance field, scaled as the one of
+ *                make_distance_mapb.  This image must be freed after usage.
+ */
+unsigned char *
+make_distance_mapb_dr( unsigned char *img,
+                       unsigned int width, unsigned int height );
+
 /** @} */
 
 #ifdef __cplusplus
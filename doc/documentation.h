@@ -88,6 +88,9 @@ These are convenient stuctures and files that facilitate text rendering.
 - @ref vertex-buffer<br/>
   Generic vertex buffer structure inspired by pyglet (python).
 
+- @ref vertex-ring<br/>
+  Vertex buffer of fixed capacity for text that is appended and expires.
+
 - @ref markup<br/>
   Simple structure that describes text properties.
 
@@ -39,6 +39,10 @@ FTGL_ERRORDEF_( Variable_Font_Weight_Not_Available,	0x0D,
 		"Variable font weight not available" )
 FTGL_ERRORDEF_( Variable_Font_Weight_Out_Of_Range, 	0x0E,
 		"Variable font weight out of range" )
+FTGL_ERRORDEF_( Font_Cache_Mismatch,			0x0F,
+		"Font cache does not match the font" )
+FTGL_ERRORDEF_( Texture_Atlas_Not_Empty,		0x10,
+		"Texture atlas is not empty" )
 
 FTGL_ERROR_END_LIST
 
@@ -24,6 +24,7 @@
 #include "distance-field.c"
 #include "edtaa3func.c"
 #include "ftgl-utils.c"
+#include "pixel-convert.c"
 #endif
 
 #ifdef __cplusplus
@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include "texture-font.h"
 #include "platform.h"
@@ -26,6 +27,39 @@ const struct {
 } FT_Errors[] =
 #include FT_ERRORS_H
 
+// ------------------------------------------------------- typedef & struct ---
+/* A cached shaping result, allocated in one block along with its glyphs,
+ * features and text */
+typedef struct texture_shaping_entry_t
+{
+    texture_shaping_t shaping;
+    struct texture_shaping_entry_t *next;  /* In the same bucket */
+    struct texture_shaping_entry_t *newer; /* In the least recently used list */
+    struct texture_shaping_entry_t *older;
+    uint32_t hash;
+    size_t size;
+    size_t length;
+    hb_language_t language;
+    hb_script_t script;
+    hb_direction_t direction;
+    unsigned int feature_count;
+    const hb_feature_t *features;
+    const char *text;
+} texture_shaping_entry_t;
+
+struct texture_shaping_cache_t
+{
+    /* Entries chained by hash, bucket_count being a power of two */
+    texture_shaping_entry_t **buckets;
+    size_t bucket_count;
+    size_t count;
+    texture_shaping_entry_t *newest;
+    texture_shaping_entry_t *oldest;
+
+    /* Buffer texts are shaped in, kept between calls */
+    hb_buffer_t *buffer;
+};
+
 // ------------------------------------------------- texture_font_load_face ---
 static int
 texture_font_load_face(texture_font_t *self, float size,
@@ -126,6 +160,129 @@ texture_glyph_delete( texture_glyph_t *self )
     free( self );
 }
 
+// ---------------------------------------------- texture_shaping_cache_new ---
+static struct texture_shaping_cache_t *
+texture_shaping_cache_new( void )
+{
+    struct texture_shaping_cache_t *self = calloc( 1, sizeof(*self) );
+    if( self == NULL ) {
+        return NULL;
+    }
+    self->bucket_count = 64;
+    self->buckets = calloc( self->bucket_count, sizeof(*self->buckets) );
+    self->buffer = hb_buffer_create();
+    if( self->buckets == NULL ) {
+        hb_buffer_destroy( self->buffer );
+        free( self );
+        return NULL;
+    }
+    return self;
+}
+
+// ------------------------------------------- texture_shaping_cache_delete ---
+static void
+texture_shaping_cache_delete( struct texture_shaping_cache_t *self )
+{
+    texture_shaping_entry_t *entry, *older;
+
+    for( entry = self->newest; entry; entry = older ) {
+        older = entry->older;
+        free( entry );
+    }
+    hb_buffer_destroy( self->buffer );
+    free( self->buckets );
+    free( self );
+}
+
+// --------------------------------------------------- texture_shaping_hash ---
+static uint32_t
+texture_shaping_hash( const char *text, size_t length, hb_language_t language,
+                      hb_script_t script, hb_direction_t direction,
+                      const hb_feature_t *features, unsigned int feature_count )
+{
+    const unsigned char *bytes = (const unsigned char *) features;
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    /* FNV-1a */
+    for( i = 0; i < length; ++i )
+        hash = (hash ^ (unsigned char) text[i]) * 16777619u;
+    for( i = 0; i < feature_count * sizeof(hb_feature_t); ++i )
+        hash = (hash ^ bytes[i]) * 16777619u;
+    hash = (hash ^ (uint32_t)(size_t) language) * 16777619u;
+    hash = (hash ^ (uint32_t) script) * 16777619u;
+    hash = (hash ^ (uint32_t) direction) * 16777619u;
+    return hash;
+}
+
+// ------------------------------------------------- texture_shaping_unlink ---
+/* Remove an entry from the cache, without freeing it */
+static void
+texture_shaping_unlink( texture_font_t *self, texture_shaping_entry_t *entry )
+{
+    struct texture_shaping_cache_t *cache = self->shaping_cache;
+    texture_shaping_entry_t **link;
+
+    link = &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+    while( *link != entry )
+        link = &(*link)->next;
+    *link = entry->next;
+
+    if( entry->newer )
+        entry->newer->older = entry->older;
+    else
+        cache->newest = entry->older;
+    if( entry->older )
+        entry->older->newer = entry->newer;
+    else
+        cache->oldest = entry->newer;
+
+    cache->count--;
+    self->shaping_cache_used -= entry->size;
+}
+
+// --------------------------------------------------- texture_shaping_link ---
+/* Add an entry to the cache as the most recently used one */
+static void
+texture_shaping_link( texture_font_t *self, texture_shaping_entry_t *entry )
+{
+    struct texture_shaping_cache_t *cache = self->shaping_cache;
+    texture_shaping_entry_t **buckets, *next;
+    size_t i;
+
+    /* Keep at most one entry per bucket on average */
+    if( cache->count >= cache->bucket_count &&
+        (buckets = calloc( 2 * cache->bucket_count, sizeof(*buckets) )) ) {
+        for( i = 0; i < cache->bucket_count; ++i ) {
+            for( ; cache->buckets[i]; cache->buckets[i] = next ) {
+                next = cache->buckets[i]->next;
+                cache->buckets[i]->next =
+                    buckets[cache->buckets[i]->hash & (2 * cache->bucket_count - 1)];
+                buckets[cache->buckets[i]->hash & (2 * cache->bucket_count - 1)] =
+                    cache->buckets[i];
+            }
+        }
+        free( cache->buckets );
+        cache->buckets = buckets;
+        cache->bucket_count *= 2;
+    }
+
+    i = entry->hash & (cache->bucket_count - 1);
+    entry->next = cache->buckets[i];
+    cache->buckets[i] = entry;
+
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if( cache->newest )
+        cache->newest->newer = entry;
+    else
+        cache->oldest = entry;
+    cache->newest = entry;
+
+    cache->count++;
+    self->shaping_cache_used += entry->size;
+}
+
 // ------------------------------------------------------ texture_font_init ---
 static int
 texture_font_init(texture_font_t *self)
@@ -149,6 +306,17 @@ texture_font_init(texture_font_t *self)
     self->filtering = 1;
     self->ft_face = 0;
     self->hb_ft_font = 0;
+    self->shaping_cache_size = 256 * 1024;
+    self->shaping_cache_used = 0;
+    self->shaping_hits = 0;
+    self->shaping_misses = 0;
+
+    self->shaping_cache = texture_shaping_cache_new();
+    if( !self->shaping_cache ) {
+        freetype_gl_error( Out_Of_Memory,
+			   "line %d: No more memory for allocating data\n", __LINE__);
+        return -1;
+    }
 
     // FT_LCD_FILTER_LIGHT   is (0x00, 0x55, 0x56, 0x55, 0x00)
     // FT_LCD_FILTER_DEFAULT is (0x10, 0x40, 0x70, 0x40, 0x10)
@@ -250,6 +418,8 @@ texture_font_delete( texture_font_t *self )
 
     vector_delete( self->glyphs );
 
+    if( self->shaping_cache )
+        texture_shaping_cache_delete( self->shaping_cache );
     FT_Done_Face( self->ft_face );
     hb_font_destroy( self->hb_ft_font );
 
@@ -315,6 +485,7 @@ texture_font_load_glyphs( texture_font_t * self,
     FT_GlyphSlot slot;
     FT_Bitmap ft_bitmap;
 
+    const texture_shaping_t *shaping;
     unsigned int glyph_count;
     FT_UInt glyph_index;
     texture_glyph_t *glyph;
@@ -322,8 +493,7 @@ texture_font_load_glyphs( texture_font_t * self,
     int ft_glyph_top = 0;
     int ft_glyph_left = 0;
 
-    hb_buffer_t *buffer;
-    hb_glyph_info_t *glyph_info;
+    const hb_glyph_info_t *glyph_info;
 
     ivec4 region;
     size_t missed = 0;
@@ -335,21 +505,16 @@ texture_font_load_glyphs( texture_font_t * self,
     height = self->atlas->height;
     depth  = self->atlas->depth;
 
-    FT_Init_FreeType(&library);
-
-    /* Create a buffer for harfbuzz to use */
-    buffer = hb_buffer_create();
-
-    hb_buffer_set_language( buffer,
-                            hb_language_from_string(language, strlen(language)) );
-
-    /* Layout the text */
-    hb_buffer_add_utf8( buffer, codepoints, strlen(codepoints), 0, strlen(codepoints) );
-    /* Guess text script and direction */
-    hb_buffer_guess_segment_properties( buffer );
-    hb_shape( self->hb_ft_font, buffer, NULL, 0 );
+    /* Layout the text, guessing its script and direction */
+    shaping = texture_font_shape( self, codepoints, language,
+                                  HB_SCRIPT_INVALID, HB_DIRECTION_INVALID,
+                                  NULL, 0 );
+    if( !shaping )
+        return 0;
+    glyph_count = shaping->glyph_count;
+    glyph_info = shaping->glyph_info;
 
-    glyph_info = hb_buffer_get_glyph_infos(buffer, &glyph_count);
+    FT_Init_FreeType(&library);
 
     for( i = 0; i < glyph_count; ++i ) {
         /* Check if codepoint has been already loaded */
@@ -521,13 +686,115 @@ texture_font_load_glyphs( texture_font_t * self,
         }
     }
 
-    /* clean up the buffer, but don't kill it just yet */
-    hb_buffer_reset(buffer);
+    return missed;
+}
 
-    /* Cleanup */
-    hb_buffer_destroy( buffer );
+// ----------------------------------------------------- texture_font_shape ---
+const texture_shaping_t *
+texture_font_shape( texture_font_t * self,
+                    const char * text,
+                    const char * language,
+                    hb_script_t script,
+                    hb_direction_t direction,
+                    const hb_feature_t * features,
+                    unsigned int feature_count )
+{
+    struct texture_shaping_cache_t *cache;
+    texture_shaping_entry_t *entry;
+    hb_buffer_t *buffer;
+    hb_language_t hb_language;
+    unsigned int glyph_count;
+    size_t length;
+    uint32_t hash;
+    char *block;
 
-    return missed;
+    assert( self );
+    assert( text );
+    assert( features || !feature_count );
+
+    cache = self->shaping_cache;
+    length = strlen( text );
+    hb_language = language ? hb_language_from_string( language, -1 )
+                           : HB_LANGUAGE_INVALID;
+    hash = texture_shaping_hash( text, length, hb_language, script, direction,
+                                 features, feature_count );
+
+    /* Look for the same text shaped with the same parameters */
+    for( entry = cache->buckets[hash & (cache->bucket_count - 1)];
+         entry; entry = entry->next ) {
+        if( entry->hash == hash && entry->length == length &&
+            entry->language == hb_language && entry->script == script &&
+            entry->direction == direction &&
+            entry->feature_count == feature_count &&
+            !memcmp( entry->text, text, length ) &&
+            (!feature_count ||
+             !memcmp( entry->features, features,
+                      feature_count * sizeof(hb_feature_t) )) ) {
+            texture_shaping_unlink( self, entry );
+            texture_shaping_link( self, entry );
+            self->shaping_hits++;
+            return &entry->shaping;
+        }
+    }
+    self->shaping_misses++;
+
+    buffer = cache->buffer;
+    hb_buffer_reset( buffer );
+    hb_buffer_add_utf8( buffer, text, length, 0, length );
+    if( hb_language != HB_LANGUAGE_INVALID )
+        hb_buffer_set_language( buffer, hb_language );
+    if( script != HB_SCRIPT_INVALID )
+        hb_buffer_set_script( buffer, script );
+    if( direction != HB_DIRECTION_INVALID )
+        hb_buffer_set_direction( buffer, direction );
+    hb_buffer_guess_segment_properties( buffer );
+    hb_shape( self->hb_ft_font, buffer, features, feature_count );
+    glyph_count = hb_buffer_get_length( buffer );
+
+    /* Copy the result, with the key, in one block */
+    block = malloc( sizeof(texture_shaping_entry_t) +
+                    glyph_count * (sizeof(hb_glyph_info_t) +
+                                   sizeof(hb_glyph_position_t)) +
+                    feature_count * sizeof(hb_feature_t) + length );
+    if( !block ) {
+        freetype_gl_error( Out_Of_Memory,
+			   "line %d: No more memory for allocating data\n", __LINE__);
+        return NULL;
+    }
+    entry = (texture_shaping_entry_t *) block;
+    block += sizeof(texture_shaping_entry_t);
+    entry->shaping.glyph_count = glyph_count;
+    entry->shaping.glyph_info = memcpy( block,
+        hb_buffer_get_glyph_infos( buffer, NULL ),
+        glyph_count * sizeof(hb_glyph_info_t) );
+    block += glyph_count * sizeof(hb_glyph_info_t);
+    entry->shaping.glyph_pos = memcpy( block,
+        hb_buffer_get_glyph_positions( buffer, NULL ),
+        glyph_count * sizeof(hb_glyph_position_t) );
+    block += glyph_count * sizeof(hb_glyph_position_t);
+    entry->features = (hb_feature_t *) block;
+    if( feature_count )
+        memcpy( block, features, feature_count * sizeof(hb_feature_t) );
+    block += feature_count * sizeof(hb_feature_t);
+    entry->text = memcpy( block, text, length );
+    entry->hash = hash;
+    entry->size = block + length - (char *) entry;
+    entry->length = length;
+    entry->language = hb_language;
+    entry->script = script;
+    entry->direction = direction;
+    entry->feature_count = feature_count;
+
+    /* Make room for it, keeping it whatever its size */
+    while( cache->oldest &&
+           self->shaping_cache_used + entry->size > self->shaping_cache_size ) {
+        texture_shaping_entry_t *oldest = cache->oldest;
+        texture_shaping_unlink( self, oldest );
+        free( oldest );
+    }
+    texture_shaping_link( self, entry );
+
+    return &entry->shaping;
 }
 
 
@@ -123,6 +123,32 @@ typedef struct texture_glyph_t
 
 } texture_glyph_t;
 
+/**
+ * Result of shaping a text, see texture_font_shape.
+ */
+typedef struct texture_shaping_t
+{
+    /**
+     * Number of glyphs
+     */
+    unsigned int glyph_count;
+
+    /**
+     * Glyph infos, whose codepoint is the index of the glyph in the face
+     */
+    const hb_glyph_info_t * glyph_info;
+
+    /**
+     * Glyph positions, in 26.6 fixed point (horizontal ones multiplied by
+     * hres)
+     */
+    const hb_glyph_position_t * glyph_pos;
+
+} texture_shaping_t;
+
+/* Cache of shaping results, private to texture-font.c */
+struct texture_shaping_cache_t;
+
 typedef enum font_location_t {
     TEXTURE_FONT_FILE = 0,
     TEXTURE_FONT_MEMORY,
@@ -258,6 +284,32 @@ typedef struct texture_font_t
      */
     float underline_thickness;
 
+    /**
+     * Shaping results of the texts last shaped with this font
+     */
+    struct texture_shaping_cache_t * shaping_cache;
+
+    /**
+     * Memory (in bytes) cached shaping results may use, 256 kB by
+     * default. The last result is kept whatever its size.
+     */
+    size_t shaping_cache_size;
+
+    /**
+     * Memory (in bytes) used by cached shaping results
+     */
+    size_t shaping_cache_used;
+
+    /**
+     * Number of texts whose shaping was found in the cache
+     */
+    size_t shaping_hits;
+
+    /**
+     * Number of texts that had to be shaped
+     */
+    size_t shaping_misses;
+
 } texture_font_t;
 
 
@@ -344,6 +396,33 @@ typedef struct texture_font_t
                             const char * codepoints,
                             const char *language );
 
+/**
+ * Shape a text, or get the result of shaping it if it was shaped recently
+ * with the same parameters. Texts that stay the same from frame to frame are
+ * thus only shaped once, as long as the cache is large enough.
+ *
+ * @param self          A valid texture font
+ * @param text          Text to shape in UTF-8 encoding
+ * @param language      Language of the text (BCP 47), or NULL to guess it
+ * @param script        Script of the text, or HB_SCRIPT_INVALID to guess it
+ * @param direction     Direction of the text, or HB_DIRECTION_INVALID to
+ *                      guess it
+ * @param features      Features to apply, may be NULL if feature_count is 0
+ * @param feature_count Number of features
+ *
+ * @return The shaping result, valid until the next call to this function
+ *         (or texture_font_load_glyphs) with the same font, or NULL if
+ *         there is not enough memory
+ */
+  const texture_shaping_t *
+  texture_font_shape( texture_font_t * self,
+                      const char * text,
+                      const char * language,
+                      hb_script_t script,
+                      hb_direction_t direction,
+                      const hb_feature_t * features,
+                      unsigned int feature_count );
+
 /**
  * Creates a new empty glyph
  *
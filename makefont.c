@@ -7,10 +7,17 @@
 #include "vec234.h"
 #include "vector.h"
 #include "freetype-gl.h"
+#include "utf8-utils.h"
 
+#include <ctype.h>
 #include <errno.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#ifdef FREETYPE_GL_USE_PTHREADS
+#   include <pthread.h>
+#   include <unistd.h>
+#endif
 
 
 #ifndef WIN32
@@ -20,113 +27,1370 @@
 #endif
 
 
+// ------------------------------------------------------- typedef & struct ---
+// Layout of a binary blob (see --blob), in the byte order of the machine
+// makefont runs on. The header is followed by the glyph index (one uint32_t
+// per codepoint of each 256 codepoints page, glyph number + 1 or 0 if there
+// is no glyph), the glyphs, their kerning pairs and, 16 bytes aligned, the
+// texture. Every record is 4 bytes aligned so that the blob can be used in
+// place.
+#define BLOB_MAGIC   "FTGLBLOB"
+#define BLOB_VERSION 1
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t tex_width, tex_height, tex_depth;
+    float size, height, linegap, ascender, descender;
+    uint32_t page_count, glyph_count, kerning_count;
+    uint32_t index_offset, glyphs_offset, kerning_offset, tex_offset;
+} blob_header_t;
+
+typedef struct
+{
+    uint32_t codepoint;
+    uint32_t width, height;
+    int32_t offset_x, offset_y;
+    float advance_x, advance_y;
+    float s0, t0, s1, t1;
+    uint32_t kerning_first, kerning_count;
+} blob_glyph_t;
+
+// Number of a glyph in a blob
+typedef struct
+{
+    texture_glyph_t * glyph;
+    uint32_t number;
+} glyph_number_t;
+
+// A font to make, from the command line or a line of a manifest
+typedef struct
+{
+    const char * font_filename;
+    const char * header_filename;
+    const char * blob_filename;
+    const char * variable_name;
+    const char * charset;
+    const char * atlas_name;
+    float font_size;
+    size_t texture_width;
+    rendermode_t rendermode;
+
+    // Threads rasterizing its glyphs
+    size_t threads;
+
+    // First job of the jobs sharing the atlas of this one
+    size_t group;
+
+    // Results
+    size_t missed;
+    double time;
+    float occupancy;
+    int success;
+} job_t;
+
+// Jobs of a manifest, shared by the threads running them
+typedef struct
+{
+    job_t * jobs;
+    size_t count;
+    size_t next;
+#ifdef FREETYPE_GL_USE_PTHREADS
+    pthread_mutex_t lock;
+#endif
+} batch_t;
+
+
+// ------------------------------------------------------- global variables ---
+const char * default_charset =
+    " !\"#$%&'()*+,-./0123456789:;<=>?"
+    "@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_"
+    "`abcdefghijklmnopqrstuvwxyz{|}~";
+
+const char * rendermode_names[] = {
+    "normal",
+    "outline edge",
+    "outline added",
+    "outline removed",
+    "signed distance field"
+};
+
+
 // ------------------------------------------------------------- print help ---
 void print_help()
 {
     fprintf( stderr, "Usage: makefont [--help] --font <font file> "
              "--header <header file> --size <font size> "
              "--variable <variable name> --texture <texture size> "
-             "--rendermode <one of 'normal', 'outline_edge', 'outline_positive', 'outline_negative' or 'sdf'>\n" );
+             "--rendermode <one of 'normal', 'outline_edge', 'outline_positive', 'outline_negative' or 'sdf'> "
+             "[--blob <blob file>] [--charset <charset file>] [--jobs <thread count>]\n"
+             "       makefont --manifest <manifest file> [--jobs <thread count>]\n"
+             "\n"
+             "Each line of a manifest describes a font with space separated\n"
+             "key=value pairs, the keys being the parameters above: font, header,\n"
+             "size, variable, texture, rendermode, blob and charset. Fonts with the\n"
+             "same atlas=<name> share one atlas, written once to <name>.h next to the\n"
+             "first of their headers (<name>.bin next to the first blob), which their\n"
+             "headers refer to. <name> must be a C identifier.\n"
+             "Empty lines and lines starting with # are skipped.\n" );
+}
+
+// ------------------------------------------------------- parse_rendermode ---
+int parse_rendermode( const char * name, rendermode_t * rendermode )
+{
+    if( 0 == strcmp( "normal", name ) )
+        *rendermode = RENDER_NORMAL;
+    else if( 0 == strcmp( "outline_edge", name ) )
+        *rendermode = RENDER_OUTLINE_EDGE;
+    else if( 0 == strcmp( "outline_positive", name ) )
+        *rendermode = RENDER_OUTLINE_POSITIVE;
+    else if( 0 == strcmp( "outline_negative", name ) )
+        *rendermode = RENDER_OUTLINE_NEGATIVE;
+    else if( 0 == strcmp( "sdf", name ) )
+        *rendermode = RENDER_SIGNED_DISTANCE_FIELD;
+    else
+        return 0;
+    return 1;
+}
+
+// ----------------------------------------------------------- read_charset ---
+// Characters of a UTF-8 file, line breaks left out
+char * read_charset( const char * filename )
+{
+    FILE * file = fopen( filename, "rb" );
+    char * charset;
+    size_t size = 0;
+    int c;
+
+    if( !file )
+        return NULL;
+    fseek( file, 0, SEEK_END );
+    charset = malloc( ftell( file ) + 1 );
+    rewind( file );
+    while( (c = fgetc( file )) != EOF )
+    {
+        if( c != '\n' && c != '\r' )
+            charset[size++] = c;
+    }
+    charset[size] = '\0';
+    fclose( file );
+    return charset;
+}
+
+size_t kerning_page_count(texture_glyph_t * glyph)
+{
+    if( vector_size(glyph->kerning) == 0 )
+        return 0;
+    return (((kerning_t *) vector_back( glyph->kerning ))->codepoint >> 8) + 1;
 }
 
 void print_glyph(FILE * file, texture_glyph_t * glyph)
 {
+    size_t kerning_count = kerning_page_count( glyph );
+
     // TextureFont
     fprintf( file, "  {%u, ", glyph->codepoint );
     fprintf( file, "%" PRIzu ", %" PRIzu ", ", glyph->width, glyph->height );
     fprintf( file, "%d, %d, ", glyph->offset_x, glyph->offset_y );
     fprintf( file, "%ff, %ff, ", glyph->advance_x, glyph->advance_y );
     fprintf( file, "%ff, %ff, %ff, %ff, ", glyph->s0, glyph->t0, glyph->s1, glyph->t1 );
-    fprintf( file, "%" PRIzu ", ", vector_size(glyph->kerning) );
-    if (vector_size(glyph->kerning) == 0) {
+    // Kerning pairs are expanded to 256 entries pages of preceding codepoints
+    fprintf( file, "%" PRIzu ", ", kerning_count );
+    if (kerning_count == 0) {
 	fprintf( file, "{{0}}" );
     } else {
-	int k;
+	size_t k, p = 0;
 	fprintf( file, "{ " );
-	for( k=0; k < vector_size(glyph->kerning); ++k ) {
-	    float *kerning = *(float **) vector_get( glyph->kerning, k);
+	for( k=0; k < kerning_count; ++k ) {
 	    int l;
 	    fprintf( file, "{" );
-	    for( l=0; l<0xff; l++ )
-		fprintf( file, " %ff,", kerning[l] );
-	    fprintf( file, " %ff }", kerning[0xFF] );
+	    for( l=0; l<0x100; l++ ) {
+		kerning_t *pair = NULL;
+		if( p < vector_size(glyph->kerning) ) {
+		    pair = (kerning_t *) vector_get( glyph->kerning, p );
+		    if( pair->codepoint == ((k << 8) | l) )
+			p++;
+		    else
+			pair = NULL;
+		}
+		fprintf( file, l < 0xFF ? " %ff," : " %ff }",
+			 pair ? pair->kerning : 0.0f );
+	    }
 
-	    if( k < (vector_size(glyph->kerning)-1))
+	    if( k < (kerning_count-1))
 		fprintf( file, ",\n" );
 	}
 	fprintf( file, " }" );
     }
     fprintf( file, " };\n" );
 }
-// ------------------------------------------------------------------- main ---
-int main( int argc, char **argv )
+// ----------------------------------------------------------- measure_font ---
+// Raise glyph_count to the number of 256 codepoints pages indexing the
+// glyphs of a font, and max_kerning_count to the number of 256 entries
+// kerning pages of its glyphs
+void measure_font( texture_font_t * font, size_t * glyph_count,
+                   size_t * max_kerning_count )
 {
-    FILE* test;
-    size_t i, j, k;
-    int arg;
+    texture_glyph_t * glyph;
+    size_t i;
+
+    for( i=0; i < font->glyphs->capacity; ++i )
+    {
+        texture_glyph_slot_t *slot = font->glyphs->slots + i;
+        if( slot->glyph && (slot->codepoint >> 8) >= *glyph_count )
+            *glyph_count = (slot->codepoint >> 8) + 1;
+    }
+    GLYPHS_ITERATOR(i, glyph, font->glyphs) {
+        size_t new_max = kerning_page_count(glyph);
+        if( new_max > *max_kerning_count )
+            *max_kerning_count = new_max;
+    }
+    GLYPHS_ITERATOR_END
+}
+
+// -------------------------------------------------------- compare_numbers ---
+// Order the numbered glyphs of a blob by address, to look them up
+int compare_numbers( const void * a, const void * b )
+{
+    uintptr_t x = (uintptr_t) ((const glyph_number_t *) a)->glyph;
+    uintptr_t y = (uintptr_t) ((const glyph_number_t *) b)->glyph;
+
+    return (x > y) - (x < y);
+}
+
+// ------------------------------------------------------------- write_blob ---
+// Write the atlas and the glyphs of a font to a binary blob, page_count pages
+// of 256 codepoints being indexed. The atlas is left out (tex_offset being 0)
+// when it is shared, and written once by write_atlas_blob.
+int write_blob( const char * filename, texture_font_t * font,
+                size_t page_count, int shared )
+{
+    texture_atlas_t * atlas = font->atlas;
+    size_t texture_size = atlas->width * atlas->height * atlas->depth;
+    size_t index_count = page_count * 0x100;
+    texture_glyph_t ** glyphs = malloc( font->glyphs->size * sizeof(*glyphs) );
+    glyph_number_t * numbers = malloc( font->glyphs->size * sizeof(*numbers) );
+    uint32_t * index = calloc( index_count, sizeof(uint32_t) );
+    glyph_number_t key, * number;
+    texture_glyph_t * glyph;
+    blob_header_t header;
+    blob_glyph_t record;
+    size_t i, j, glyph_count = 0, kerning_count = 0;
+    int success;
+    FILE * file;
+
+    if( !glyphs || !numbers || !index )
+    {
+        fprintf( stderr, "Out of memory.\n" );
+        free( glyphs );
+        free( numbers );
+        free( index );
+        return 0;
+    }
+    GLYPHS_ITERATOR(i, glyph, font->glyphs) {
+        numbers[glyph_count].glyph = glyph;
+        numbers[glyph_count].number = glyph_count + 1;
+        glyphs[glyph_count++] = glyph;
+        kerning_count += vector_size( glyph->kerning );
+    }
+    GLYPHS_ITERATOR_END
+
+    // Glyphs are numbered once and looked up by address, aliases sharing
+    // the number of their glyph
+    qsort( numbers, glyph_count, sizeof(*numbers), compare_numbers );
+    for( i = 0; i < index_count; ++i )
+    {
+        if( !(key.glyph = texture_font_find_glyph_gi( font, i )) )
+            continue;
+        number = bsearch( &key, numbers, glyph_count, sizeof(*numbers),
+                          compare_numbers );
+        index[i] = number ? number->number : 0;
+    }
+    free( numbers );
+
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, BLOB_MAGIC, sizeof(header.magic) );
+    header.version = BLOB_VERSION;
+    header.tex_width = atlas->width;
+    header.tex_height = atlas->height;
+    header.tex_depth = atlas->depth;
+    header.size = font->size;
+    header.height = font->height;
+    header.linegap = font->linegap;
+    header.ascender = font->ascender;
+    header.descender = font->descender;
+    header.page_count = page_count;
+    header.glyph_count = glyph_count;
+    header.kerning_count = kerning_count;
+    header.index_offset = sizeof(header);
+    header.glyphs_offset = header.index_offset + index_count * sizeof(uint32_t);
+    header.kerning_offset = header.glyphs_offset + glyph_count * sizeof(record);
+    header.tex_offset = shared ? 0 :
+        (header.kerning_offset + kerning_count * sizeof(kerning_t) + 15) & ~15u;
+
+    if( !(file = fopen( filename, "wb" )) )
+    {
+        free( glyphs );
+        free( index );
+        return 0;
+    }
+    success = fwrite( &header, sizeof(header), 1, file ) == 1 &&
+              fwrite( index, sizeof(uint32_t), index_count, file ) == index_count;
+    for( i = 0, j = 0; success && i < glyph_count; ++i )
+    {
+        glyph = glyphs[i];
+        record.codepoint = glyph->codepoint;
+        record.width = glyph->width;
+        record.height = glyph->height;
+        record.offset_x = glyph->offset_x;
+        record.offset_y = glyph->offset_y;
+        record.advance_x = glyph->advance_x;
+        record.advance_y = glyph->advance_y;
+        record.s0 = glyph->s0;
+        record.t0 = glyph->t0;
+        record.s1 = glyph->s1;
+        record.t1 = glyph->t1;
+        record.kerning_first = j;
+        record.kerning_count = vector_size( glyph->kerning );
+        j += record.kerning_count;
+        success = fwrite( &record, sizeof(record), 1, file ) == 1;
+    }
+    for( i = 0; success && i < glyph_count; ++i )
+    {
+        size_t count = vector_size( glyphs[i]->kerning );
+        success = fwrite( glyphs[i]->kerning->items, sizeof(kerning_t),
+                          count, file ) == count;
+    }
+    for( i = header.kerning_offset + kerning_count * sizeof(kerning_t);
+         success && i < header.tex_offset; ++i )
+    {
+        success = fputc( 0, file ) != EOF;
+    }
+    success = success && ( shared ||
+        fwrite( atlas->data, 1, texture_size, file ) == texture_size );
+    success = !fclose( file ) && success;
+
+    free( glyphs );
+    free( index );
+    return success;
+}
+
+// ------------------------------------------------------ print_blob_loader ---
+// Declarations of a font read in place from a blob written by write_blob
+void print_blob_loader( FILE * file, const char * variable_name )
+{
+    fprintf( file,
+        "#include <stddef.h>\n"
+        "#include <stdint.h>\n"
+        "#include <string.h>\n"
+        "#ifdef __cplusplus\n"
+        "extern \"C\" {\n"
+        "#endif\n"
+        "\n"
+        "typedef struct\n"
+        "{\n"
+        "    char magic[8];\n"
+        "    uint32_t version;\n"
+        "    uint32_t tex_width, tex_height, tex_depth;\n"
+        "    float size, height, linegap, ascender, descender;\n"
+        "    uint32_t page_count, glyph_count, kerning_count;\n"
+        "    uint32_t index_offset, glyphs_offset, kerning_offset, tex_offset;\n"
+        "} texture_font_blob_t;\n"
+        "\n"
+        "typedef struct\n"
+        "{\n"
+        "    uint32_t codepoint;\n"
+        "    uint32_t width, height;\n"
+        "    int32_t offset_x, offset_y;\n"
+        "    float advance_x, advance_y;\n"
+        "    float s0, t0, s1, t1;\n"
+        "    uint32_t kerning_first, kerning_count;\n"
+        "} texture_glyph_t;\n"
+        "\n"
+        "typedef struct\n"
+        "{\n"
+        "    uint32_t codepoint;\n"
+        "    float kerning;\n"
+        "} kerning_t;\n"
+        "\n"
+        "typedef struct\n"
+        "{\n"
+        "    size_t tex_width;\n"
+        "    size_t tex_height;\n"
+        "    size_t tex_depth;\n"
+        "    const unsigned char *tex_data;\n"
+        "    float size;\n"
+        "    float height;\n"
+        "    float linegap;\n"
+        "    float ascender;\n"
+        "    float descender;\n"
+        "    size_t glyphs_count;\n"
+        "    const uint32_t *glyph_index;\n"
+        "    const texture_glyph_t *glyphs;\n"
+        "    const kerning_t *kerning;\n"
+        "} texture_font_t;\n"
+        "\n"
+        "texture_font_t %s;\n"
+        "\n", variable_name );
+
+    fprintf( file,
+        "/* Point a font to the content of a blob, which must stay in memory and\n"
+        " * be 4 bytes aligned (16 bytes for the texture to be). Return 0 if the\n"
+        " * blob is not valid. The blob can be read from its file, or embedded\n"
+        " * with #embed or the .incbin assembler directive, e.g.:\n"
+        " *\n"
+        " *     _Alignas(16) static const unsigned char blob[] = {\n"
+        " *     #embed \"font.bin\"\n"
+        " *     };\n"
+        " *\n"
+        " * The blob of a font sharing an atlas holds no texture: tex_data is left\n"
+        " * NULL, to be pointed to the atlas blob, tex_width x tex_height x\n"
+        " * tex_depth bytes.\n"
+        " */\n"
+        "static inline int\n"
+        "texture_font_load_blob( texture_font_t *font, const void *blob, size_t size )\n"
+        "{\n"
+        "    const texture_font_blob_t *header = (const texture_font_blob_t *) blob;\n"
+        "    const unsigned char *bytes = (const unsigned char *) blob;\n"
+        "    const uint32_t *glyph_index;\n"
+        "    const texture_glyph_t *glyphs;\n"
+        "    size_t i;\n"
+        "\n"
+        "    /* Sections in order, 4 bytes aligned and within the blob, sums of\n"
+        "     * 32-bit fields being computed on 64 bits not to overflow */\n"
+        "    if( size < sizeof(*header) || ((uintptr_t) blob & 3) ||\n"
+        "        memcmp( header->magic, \"" BLOB_MAGIC "\", 8 ) ||\n"
+        "        header->version != %d ||\n"
+        "        ((header->index_offset | header->glyphs_offset |\n"
+        "          header->kerning_offset | header->tex_offset) & 3) ||\n"
+        "        header->index_offset < sizeof(*header) ||\n"
+        "        header->glyphs_offset < header->index_offset +\n"
+        "            (uint64_t) header->page_count * 0x100 * sizeof(uint32_t) ||\n"
+        "        header->kerning_offset < header->glyphs_offset +\n"
+        "            (uint64_t) header->glyph_count * sizeof(texture_glyph_t) ||\n"
+        "        size < header->kerning_offset +\n"
+        "            (uint64_t) header->kerning_count * sizeof(kerning_t) ||\n"
+        "        header->tex_depth < 1 || header->tex_depth > 4 ||\n"
+        "        (header->tex_offset &&\n"
+        "         (header->tex_offset < header->kerning_offset +\n"
+        "              (uint64_t) header->kerning_count * sizeof(kerning_t) ||\n"
+        "          size < header->tex_offset ||\n"
+        "          (uint64_t) header->tex_width * header->tex_height >\n"
+        "              (size - header->tex_offset) / header->tex_depth)) )\n"
+        "        return 0;\n"
+        "\n"
+        "    /* Glyph numbers and kerning ranges within their tables */\n"
+        "    glyph_index = (const uint32_t *) (bytes + header->index_offset);\n"
+        "    glyphs = (const texture_glyph_t *) (bytes + header->glyphs_offset);\n"
+        "    for( i = 0; i < (size_t) header->page_count * 0x100; ++i )\n"
+        "        if( glyph_index[i] > header->glyph_count )\n"
+        "            return 0;\n"
+        "    for( i = 0; i < header->glyph_count; ++i )\n"
+        "        if( glyphs[i].kerning_first > header->kerning_count ||\n"
+        "            glyphs[i].kerning_count >\n"
+        "                header->kerning_count - glyphs[i].kerning_first )\n"
+        "            return 0;\n"
+        "\n"
+        "    font->tex_width = header->tex_width;\n"
+        "    font->tex_height = header->tex_height;\n"
+        "    font->tex_depth = header->tex_depth;\n"
+        "    font->tex_data = header->tex_offset ? bytes + header->tex_offset : NULL;\n"
+        "    font->size = header->size;\n"
+        "    font->height = header->height;\n"
+        "    font->linegap = header->linegap;\n"
+        "    font->ascender = header->ascender;\n"
+        "    font->descender = header->descender;\n"
+        "    font->glyphs_count = header->page_count;\n"
+        "    font->glyph_index = glyph_index;\n"
+        "    font->glyphs = glyphs;\n"
+        "    font->kerning = (const kerning_t *) (bytes + header->kerning_offset);\n"
+        "    return 1;\n"
+        "}\n"
+        "\n"
+        "static inline const texture_glyph_t *\n"
+        "texture_font_find_glyph( const texture_font_t *font, uint32_t codepoint )\n"
+        "{\n"
+        "    uint32_t i;\n"
+        "\n"
+        "    if( (codepoint >> 8) >= font->glyphs_count )\n"
+        "        return NULL;\n"
+        "    i = font->glyph_index[codepoint];\n"
+        "    return i ? font->glyphs + i - 1 : NULL;\n"
+        "}\n"
+        "\n"
+        "/* Kerning between a glyph and the codepoint preceding it */\n"
+        "static inline float\n"
+        "texture_glyph_get_kerning( const texture_font_t *font,\n"
+        "                           const texture_glyph_t *glyph, uint32_t codepoint )\n"
+        "{\n"
+        "    const kerning_t *pairs = font->kerning + glyph->kerning_first;\n"
+        "    size_t first = 0, last = glyph->kerning_count, middle;\n"
+        "\n"
+        "    while( first < last ) {\n"
+        "        middle = first + (last - first) / 2;\n"
+        "        if( pairs[middle].codepoint < codepoint )\n"
+        "            first = middle + 1;\n"
+        "        else\n"
+        "            last = middle;\n"
+        "    }\n"
+        "    if( first < glyph->kerning_count && pairs[first].codepoint == codepoint )\n"
+        "        return pairs[first].kerning;\n"
+        "    return 0.0f;\n"
+        "}\n"
+        "\n"
+        "#ifdef __cplusplus\n"
+        "}\n"
+        "#endif\n", BLOB_VERSION );
+}
+
+// ---------------------------------------------------------- print_license ---
+void print_license( FILE * file )
+{
+    fprintf( file,
+        "/* ============================================================================\n"
+        " * Freetype GL - A C OpenGL Freetype engine\n"
+        " * Platform:    Any\n"
+        " * WWW:         https://github.com/rougier/freetype-gl\n"
+        " * ----------------------------------------------------------------------------\n"
+        " * Copyright 2011,2012 Nicolas P. Rougier. All rights reserved.\n"
+        " *\n"
+        " * Redistribution and use in source and binary forms, with or without\n"
+        " * modification, are permitted provided that the following conditions are met:\n"
+        " *\n"
+        " *  1. Redistributions of source code must retain the above copyright notice,\n"
+        " *     this list of conditions and the following disclaimer.\n"
+        " *\n"
+        " *  2. Redistributions in binary form must reproduce the above copyright\n"
+        " *     notice, this list of conditions and the following disclaimer in the\n"
+        " *     documentation and/or other materials provided with the distribution.\n"
+        " *\n"
+        " * THIS SOFTWARE IS PROVIDED BY NICOLAS P. ROUGIER ''AS IS'' AND ANY EXPRESS OR\n"
+        " * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF\n"
+        " * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO\n"
+        " * EVENT SHALL NICOLAS P. ROUGIER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,\n"
+        " * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES\n"
+        " * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;\n"
+        " * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND\n"
+        " * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT\n"
+        " * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF\n"
+        " * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.\n"
+        " *\n"
+        " * The views and conclusions contained in the software and documentation are\n"
+        " * those of the authors and should not be interpreted as representing official\n"
+        " * policies, either expressed or implied, of Nicolas P. Rougier.\n"
+        " * ============================================================================\n"
+        " */\n\n");
+}
+
+// ------------------------------------------------------- print_font_types ---
+// Types of a header font, its texture data being an array of texture_size
+// bytes, or a pointer to the data of a shared atlas if texture_size is 0
+void print_font_types( FILE * file, size_t max_kerning_count,
+                       size_t texture_size, size_t glyph_count )
+{
+    char tex_data[64];
+
+    if( texture_size )
+        snprintf( tex_data, sizeof(tex_data),
+                  "unsigned char tex_data[%" PRIzu "]", texture_size );
+    else
+        snprintf( tex_data, sizeof(tex_data), "const unsigned char *tex_data" );
+
+    fprintf( file,
+        "typedef struct\n"
+        "{\n"
+        "    uint32_t codepoint;\n"
+        "    int width, height;\n"
+        "    int offset_x, offset_y;\n"
+        "    float advance_x, advance_y;\n"
+        "    float s0, t0, s1, t1;\n"
+        "    size_t kerning_count;\n"
+        "    float kerning[%" PRIzu "][0x100];\n"
+        "} texture_glyph_t;\n\n", max_kerning_count );
+
+    fprintf( file,
+        "typedef struct\n"
+        "{\n"
+        "    size_t tex_width;\n"
+        "    size_t tex_height;\n"
+        "    size_t tex_depth;\n"
+        "    %s;\n"
+        "    float size;\n"
+        "    float height;\n"
+        "    float linegap;\n"
+        "    float ascender;\n"
+        "    float descender;\n"
+        "    size_t glyphs_count;\n"
+        "    texture_glyph_t *glyphs[%" PRIzu "][0x100];\n"
+        "} texture_font_t;\n\n", tex_data, glyph_count );
+}
+
+// ----------------------------------------------------- print_texture_data ---
+// Initializer of the texture data of an atlas
+void print_texture_data( FILE * file, texture_atlas_t * atlas )
+{
+    size_t texture_size = atlas->width * atlas->height * atlas->depth;
+    size_t i, j;
+
+    fprintf( file, " {" );
+    for( i=0; i < texture_size; i+= 32 )
+    {
+        for( j=0; j < 32 && (j+i) < texture_size ; ++ j)
+        {
+            if( (j+i) < (texture_size-1) )
+            {
+                fprintf( file, "%d,", atlas->data[i+j] );
+            }
+            else
+            {
+                fprintf( file, "%d", atlas->data[i+j] );
+            }
+        }
+        if( (j+i) < texture_size )
+        {
+            fprintf( file, "\n" );
+        }
+    }
+    fprintf( file, "}" );
+}
+
+// --------------------------------------------------------- atlas_filename ---
+// Name of the file of a shared atlas, next to the file of a job
+char * atlas_filename( const char * filename, const char * atlas_name,
+                       const char * extension )
+{
+    const char * base = strrchr( filename, '/' );
+    size_t length = base ? (size_t)(base + 1 - filename) : 0;
+    char * name = malloc( length + strlen( atlas_name ) +
+                          strlen( extension ) + 1 );
+
+    if( !name )
+        return NULL;
+    memcpy( name, filename, length );
+    strcpy( name + length, atlas_name );
+    strcat( name, extension );
+    return name;
+}
+
+// ----------------------------------------------------- write_atlas_header ---
+// Write the header of an atlas shared by several fonts, with the types of
+// these fonts, large enough for each of them
+int write_atlas_header( const char * filename, const char * atlas_name,
+                        texture_atlas_t * atlas, size_t glyph_count,
+                        size_t max_kerning_count )
+{
+    FILE * file = fopen( filename, "w" );
+    size_t i;
+
+    if( !file )
+    {
+        fprintf( stderr, "Cannot write header file \"%s\".\n", filename );
+        return 0;
+    }
+    print_license( file );
+
+    fprintf( file, "#ifndef " );
+    for( i = 0; atlas_name[i]; ++i )
+        fputc( toupper( (unsigned char) atlas_name[i] ), file );
+    fprintf( file, "_H\n#define " );
+    for( i = 0; atlas_name[i]; ++i )
+        fputc( toupper( (unsigned char) atlas_name[i] ), file );
+    fprintf( file, "_H\n\n" );
+    fprintf( file,
+	     "#include <stddef.h>\n"
+	     "#include <stdint.h>\n"
+	     "#ifdef __cplusplus\n"
+	     "extern \"C\" {\n"
+	     "#endif\n"
+	     "\n" );
+    print_font_types( file, max_kerning_count, 0, glyph_count );
+
+    fprintf( file,
+        "typedef struct\n"
+        "{\n"
+        "    size_t tex_width;\n"
+        "    size_t tex_height;\n"
+        "    size_t tex_depth;\n"
+        "    unsigned char tex_data[%" PRIzu "];\n"
+        "} texture_atlas_t;\n\n",
+        atlas->width * atlas->height * atlas->depth );
+
+    fprintf( file, "texture_atlas_t %s = {\n", atlas_name );
+    fprintf( file, " %" PRIzu ", %" PRIzu ", %" PRIzu ",\n", atlas->width, atlas->height, atlas->depth );
+    print_texture_data( file, atlas );
+    fprintf( file, "\n};\n" );
+    fprintf( file,
+        "#ifdef __cplusplus\n"
+        "}\n"
+        "#endif\n"
+        "\n"
+        "#endif\n" );
+
+    return !fclose( file );
+}
+
+// ------------------------------------------------------- write_atlas_blob ---
+// Write the texture of an atlas shared by fonts written to blobs
+int write_atlas_blob( const char * filename, texture_atlas_t * atlas )
+{
+    size_t texture_size = atlas->width * atlas->height * atlas->depth;
+    FILE * file = fopen( filename, "wb" );
+    int success;
+
+    if( !file )
+    {
+        fprintf( stderr, "Cannot write blob file \"%s\".\n", filename );
+        return 0;
+    }
+    success = fwrite( atlas->data, 1, texture_size, file ) == texture_size;
+    return !fclose( file ) && success;
+}
+
+// ------------------------------------------------------------- write_font ---
+// Write the header of a job, and its blob if any
+int write_font( const job_t * job, texture_font_t * font )
+{
+    texture_atlas_t * atlas = font->atlas;
+    const char * variable_name = job->variable_name;
+    size_t i, j;
+
+    size_t texture_size = atlas->width * atlas->height * atlas->depth;
+    size_t glyph_count = 0;
+    size_t max_kerning_count = 1;
+    texture_glyph_t * glyph;
+
+    // The embedded font indexes its glyphs in a two-stage table of 256
+    // glyphs each, large enough for every indexed codepoint
+    measure_font( font, &glyph_count, &max_kerning_count );
+
+
+    FILE *file = fopen( job->header_filename, "w" );
+    if ( !file )
+    {
+        fprintf( stderr, "Cannot write header file \"%s\".\n", job->header_filename );
+        return 0;
+    }
+
 
-    char * font_cache =
-        " !\"#$%&'()*+,-./0123456789:;<=>?"
-        "@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_"
-        "`abcdefghijklmnopqrstuvwxyz{|}~";
+    // -------------
+    // Header
+    // -------------
+    print_license( file );
+
+    fprintf( file, 
+        "/* ============================================================================\n"
+        " * Parameters\n"
+        " * ----------------------------------------------------------------------------\n"
+        " * Font size: %f\n"
+        " * Texture width: %zu\n"
+        " * Texture height: %zu\n"
+        " * Texture depth: %zu\n"
+        " * ===============================================================================\n"
+        " */\n\n", 
+        job->font_size, atlas->width, atlas->height, atlas->depth);
+
+
+    // ----------------------
+    // Blob and its loader
+    // ----------------------
+    if ( job->blob_filename )
+    {
+        print_blob_loader( file, variable_name );
+        fclose( file );
+        if ( !write_blob( job->blob_filename, font, glyph_count,
+                          job->atlas_name != NULL ) )
+        {
+            fprintf( stderr, "Cannot write blob file \"%s\".\n", job->blob_filename );
+            return 0;
+        }
+        return 1;
+    }
+
+    // ----------------------
+    // Structure declarations
+    // ----------------------
+    // Fonts sharing an atlas take their types from its header
+    if( job->atlas_name )
+    {
+        fprintf( file, "#include \"%s.h\"\n", job->atlas_name );
+    }
+    fprintf( file,
+	     "#include <stddef.h>\n"
+	     "#include <stdint.h>\n"
+	     "#ifdef __cplusplus\n"
+	     "extern \"C\" {\n"
+	     "#endif\n"
+	     "\n" );
+
+    if( !job->atlas_name )
+    {
+        print_font_types( file, max_kerning_count, texture_size, glyph_count );
+    }
+
+    GLYPHS_ITERATOR(i, glyph, font->glyphs) {
+	fprintf( file, "texture_glyph_t %s_glyph_%08x = ", variable_name, glyph->codepoint );
+ /*
+        // Debugging information
+        printf( "glyph : '%lc'\n",
+                 glyph->codepoint );
+        printf( "  size       : %dx%d\n",
+                 glyph->width, glyph->height );
+        printf( "  offset     : %+d%+d\n",
+                 glyph->offset_x, glyph->offset_y );
+        printf( "  advance    : %ff, %ff\n",
+                 glyph->advance_x, glyph->advance_y );
+        printf( "  tex coords.: %ff, %ff, %ff, %ff\n",
+                 glyph->u0, glyph->v0, glyph->u1, glyph->v1 );
+
+        printf( "  kerning    : " );
+        if( glyph->kerning_count )
+        {
+            for( j=0; j < glyph->kerning_count; ++j )
+            {
+                printf( "('%lc', %ff)",
+                         glyph->kerning[j].codepoint, glyph->kerning[j].kerning );
+                if( j < (glyph->kerning_count-1) )
+                {
+                    printf( ", " );
+                }
+            }
+        }
+        else
+        {
+            printf( "None" );
+        }
+        printf( "\n\n" );
+*/
+	print_glyph(file, glyph);
+    }
+    GLYPHS_ITERATOR_END
+
+    fprintf( file, "texture_font_t %s = {\n", variable_name );
+
+
+    // ------------
+    // Texture data
+    // ------------
+    fprintf( file, " %" PRIzu ", %" PRIzu ", %" PRIzu ",\n", atlas->width, atlas->height, atlas->depth );
+    if( !job->atlas_name )
+    {
+        print_texture_data( file, atlas );
+        fprintf( file, ", \n" );
+    }
+    else
+    {
+        fprintf( file, " %s.tex_data,\n", job->atlas_name );
+    }
+
+
+    // -------------------
+    // Texture information
+    // -------------------
+    fprintf( file, " %ff, %ff, %ff, %ff, %ff, %" PRIzu ", \n",
+             font->size, font->height,
+             font->linegap,font->ascender, font->descender,
+             glyph_count );
+
+    // --------------
+    // Texture glyphs
+    // --------------
+    fprintf( file, " {\n" );
+    for( i=0; i < glyph_count; ++i )
+    {
+	fprintf( file, " {\n" );
+	for( j=0; j < 0x100; ++j )
+	{
+	    if(( glyph = texture_font_find_glyph_gi( font, (i << 8) | j ) ))
+		fprintf( file, "  &%s_glyph_%08x,\n", variable_name, glyph->codepoint );
+	    else
+		fprintf( file, "  NULL,\n" );
+	}
+	fprintf( file, " },\n" );
+    }
+    fprintf( file, " }\n};\n" );
+    fprintf( file,
+        "#ifdef __cplusplus\n"
+        "}\n"
+        "#endif\n" );
+
+    fclose( file );
+
+    return 1;
+}
+
+// -------------------------------------------------------------- wall_time ---
+double wall_time( void )
+{
+#ifdef FREETYPE_GL_USE_PTHREADS
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec + now.tv_nsec * 1e-9;
+#else
+    return (double)clock( ) / CLOCKS_PER_SEC;
+#endif
+}
+
+// ---------------------------------------------------------------- run_job ---
+// Load the glyphs of a job in an atlas, return the font or NULL
+texture_font_t * run_job( job_t * job, texture_atlas_t * atlas )
+{
+    texture_font_t * font;
+    double start = wall_time( );
+
+    font = texture_font_new_from_file( atlas, job->font_size, job->font_filename );
+    if( !font )
+    {
+        fprintf( stderr, "Cannot load font \"%s\".\n", job->font_filename );
+        return NULL;
+    }
+    font->rendermode = job->rendermode;
+    font->threads = job->threads;
+    job->missed = texture_font_load_glyphs( font, job->charset );
+    job->time = wall_time( ) - start;
+    return font;
+}
+
+// ----------------------------------------------------- write_shared_atlas ---
+// Write the atlas of a group once for the headers of its jobs, and once for
+// their blobs, next to the first header or blob
+int write_shared_atlas( const job_t * jobs, size_t count, size_t group,
+                        texture_font_t ** fonts )
+{
+    const job_t * header_job = NULL, * blob_job = NULL;
+    texture_atlas_t * atlas = NULL;
+    size_t glyph_count = 0, max_kerning_count = 1, i;
+    char * filename;
+    int success = 1;
+
+    for( i = group; i < count; ++i )
+    {
+        if( jobs[i].group != group || !fonts[i] )
+            continue;
+        atlas = fonts[i]->atlas;
+        measure_font( fonts[i], &glyph_count, &max_kerning_count );
+        if( jobs[i].blob_filename && !blob_job )
+            blob_job = &jobs[i];
+        else if( !jobs[i].blob_filename && !header_job )
+            header_job = &jobs[i];
+    }
+    if( header_job )
+    {
+        filename = atlas_filename( header_job->header_filename,
+                                   header_job->atlas_name, ".h" );
+        success = filename &&
+            write_atlas_header( filename, header_job->atlas_name, atlas,
+                                glyph_count, max_kerning_count );
+        free( filename );
+    }
+    if( success && blob_job )
+    {
+        filename = atlas_filename( blob_job->blob_filename,
+                                   blob_job->atlas_name, ".bin" );
+        success = filename && write_atlas_blob( filename, atlas );
+        free( filename );
+    }
+    return success;
+}
+
+// -------------------------------------------------------------- run_group ---
+// Run the jobs sharing the atlas of a job, then write them once the atlas is
+// complete
+void run_group( job_t * jobs, size_t count, size_t group )
+{
+    size_t width = jobs[group].texture_width, i;
+    int success;
+    texture_atlas_t * atlas = texture_atlas_new( width, width, 1 );
+    texture_font_t ** fonts = calloc( count, sizeof(*fonts) );
+
+    if( !atlas || !fonts )
+    {
+        fprintf( stderr, "Out of memory.\n" );
+        if( atlas )
+            texture_atlas_delete( atlas );
+        free( fonts );
+        return;
+    }
+    for( i = group; i < count; ++i )
+    {
+        if( jobs[i].group == group )
+            fonts[i] = run_job( &jobs[i], atlas );
+    }
+    success = !jobs[group].atlas_name || write_shared_atlas( jobs, count, group, fonts );
+    for( i = group; i < count; ++i )
+    {
+        if( jobs[i].group != group )
+            continue;
+        jobs[i].occupancy = 100.0 * atlas->used / (float)(atlas->width * atlas->height);
+        jobs[i].success = success && fonts[i] && write_font( &jobs[i], fonts[i] );
+        if( fonts[i] )
+            texture_font_delete( fonts[i] );
+    }
+    texture_atlas_delete( atlas );
+    free( fonts );
+}
+
+// ------------------------------------------------------------- run_groups ---
+// Run the groups of a batch not taken by another thread yet
+void * run_groups( void * arg )
+{
+    batch_t * batch = (batch_t *) arg;
+    size_t group;
+
+    for( ;; )
+    {
+#ifdef FREETYPE_GL_USE_PTHREADS
+        pthread_mutex_lock( &batch->lock );
+#endif
+        group = batch->next;
+        while( group < batch->count && batch->jobs[group].group != group )
+            ++group;
+        batch->next = group + 1;
+#ifdef FREETYPE_GL_USE_PTHREADS
+        pthread_mutex_unlock( &batch->lock );
+#endif
+        if( group >= batch->count )
+            return NULL;
+        run_group( batch->jobs, batch->count, group );
+    }
+}
+
+// ---------------------------------------------------------- read_manifest ---
+// Read the jobs of a manifest, return their number or 0 on error
+size_t read_manifest( const char * filename, job_t ** jobs )
+{
+    FILE * file = fopen( filename, "r" );
+    char line[4096], * key, * value;
+    size_t count = 0, capacity = 16, number = 0, i;
+    job_t * job;
+
+    if( !file )
+    {
+        fprintf( stderr, "Manifest file \"%s\" does not exist.\n", filename );
+        return 0;
+    }
+    if( !(*jobs = malloc( capacity * sizeof(job_t) )) )
+        goto out_of_memory;
+    while( fgets( line, sizeof(line), file ) )
+    {
+        ++number;
+        key = strtok( line, " \t\r\n" );
+        if( !key || key[0] == '#' )
+            continue;
+        if( count == capacity )
+        {
+            job = realloc( *jobs, 2 * capacity * sizeof(job_t) );
+            if( !job )
+                goto out_of_memory;
+            *jobs = job;
+            capacity *= 2;
+        }
+        job = *jobs + count++;
+        memset( job, 0, sizeof(*job) );
+        job->variable_name = "font";
+        job->charset = default_charset;
+        job->texture_width = 128;
+        job->rendermode = RENDER_NORMAL;
+        job->group = count - 1;
+
+        for( ; key; key = strtok( NULL, " \t\r\n" ) )
+        {
+            if( !(value = strchr( key, '=' )) )
+                goto error;
+            *value++ = '\0';
+            if( 0 == strcmp( "font", key ) )
+                job->font_filename = strdup( value );
+            else if( 0 == strcmp( "header", key ) )
+                job->header_filename = strdup( value );
+            else if( 0 == strcmp( "blob", key ) )
+                job->blob_filename = strdup( value );
+            else if( 0 == strcmp( "variable", key ) )
+                job->variable_name = strdup( value );
+            else if( 0 == strcmp( "atlas", key ) )
+            {
+                // Also the variable and file name of the atlas
+                if( !value[0] || isdigit( (unsigned char) value[0] ) ||
+                    strspn( value, "abcdefghijklmnopqrstuvwxyz"
+                                   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                   "0123456789_" ) != strlen( value ) )
+                    goto error;
+                job->atlas_name = strdup( value );
+            }
+            else if( 0 == strcmp( "size", key ) )
+                job->font_size = atof( value );
+            else if( 0 == strcmp( "texture", key ) )
+                job->texture_width = atoi( value );
+            else if( 0 == strcmp( "rendermode", key ) )
+            {
+                if( !parse_rendermode( value, &job->rendermode ) )
+                    goto error;
+            }
+            else if( 0 == strcmp( "charset", key ) )
+            {
+                if( !(job->charset = read_charset( value )) )
+                {
+                    fprintf( stderr, "Charset file \"%s\" does not exist.\n", value );
+                    goto error;
+                }
+            }
+            else
+                goto error;
+        }
+        if( !job->font_filename || !job->header_filename ||
+            4.0 > job->font_size || 0 == job->texture_width )
+            goto error;
+
+        // Jobs sharing an atlas are run in order by the same thread
+        for( i = 0; job->atlas_name && i < count - 1; ++i )
+        {
+            if( (*jobs)[i].atlas_name &&
+                0 == strcmp( (*jobs)[i].atlas_name, job->atlas_name ) )
+            {
+                job->group = (*jobs)[i].group;
+                if( (*jobs)[i].texture_width != job->texture_width )
+                    goto error;
+                break;
+            }
+        }
+    }
+    fclose( file );
+    return count;
+
+error:
+    fprintf( stderr, "%s:%" PRIzu ": invalid or incomplete job.\n", filename, number );
+    free( *jobs );
+    fclose( file );
+    return 0;
+
+out_of_memory:
+    fprintf( stderr, "Out of memory.\n" );
+    free( *jobs );
+    fclose( file );
+    return 0;
+}
+
+// -------------------------------------------------------------- run_batch ---
+// Run the jobs of a manifest on several threads and report how it went
+int run_batch( const char * filename, size_t thread_count )
+{
+    batch_t batch;
+    job_t * job;
+    size_t i, failed = 0, groups = 0;
+    double start = wall_time( );
+
+    if( !(batch.count = read_manifest( filename, &batch.jobs )) )
+        return 0;
+    batch.next = 0;
+
+    // Each group runs on a single thread, threads left over rasterize glyphs
+    for( i = 0; i < batch.count; ++i )
+        groups += batch.jobs[i].group == i;
+    for( i = 0; i < batch.count; ++i )
+        batch.jobs[i].threads = thread_count > groups ? thread_count / groups : 1;
+    if( thread_count > groups )
+        thread_count = groups;
+
+#ifdef FREETYPE_GL_USE_PTHREADS
+    {
+        pthread_t * threads = calloc( thread_count, sizeof(pthread_t) );
+
+        // Without room for the threads, run every group on this one
+        if( !threads )
+            thread_count = 1;
+        pthread_mutex_init( &batch.lock, NULL );
+        for( i = 1; i < thread_count; ++i )
+        {
+            if( pthread_create( &threads[i], NULL, run_groups, &batch ) )
+                break;
+        }
+        thread_count = i;
+        run_groups( &batch );
+        for( i = 1; i < thread_count; ++i )
+            pthread_join( threads[i], NULL );
+        pthread_mutex_destroy( &batch.lock );
+        free( threads );
+    }
+#else
+    thread_count = 1;
+    run_groups( &batch );
+#endif
+
+    for( i = 0; i < batch.count; ++i )
+    {
+        job = batch.jobs + i;
+        failed += !job->success;
+        if( !job->success )
+        {
+            printf( "%-32s %5.1f %-22s FAILED\n",
+                    job->header_filename, job->font_size,
+                    rendermode_names[job->rendermode] );
+            continue;
+        }
+        printf( "%-32s %5.1f %-22s %4" PRIzu " glyphs %4" PRIzu " missed "
+                "%7.3f s %6.2f%%\n",
+                job->header_filename, job->font_size,
+                rendermode_names[job->rendermode], utf8_strlen( job->charset ),
+                job->missed, job->time, job->occupancy );
+    }
+    printf( "%" PRIzu " fonts, %" PRIzu " failed, %.3f s on %" PRIzu " threads\n",
+            batch.count, failed, wall_time( ) - start, thread_count );
+    free( batch.jobs );
+    return failed == 0;
+}
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv )
+{
+    FILE* test;
+    int arg;
+
+    const char * font_cache = default_charset;
+
+    float  font_size   = 0.0;
+    const char * font_filename   = NULL;
+    const char * header_filename = NULL;
+    const char * blob_filename   = NULL;
+    const char * charset_filename  = NULL;
+    const char * manifest_filename = NULL;
+    const char * variable_name   = "font";
+    int show_help = 0;
+    size_t texture_width = 0;
+    size_t thread_count = 0;
+    rendermode_t rendermode = RENDER_NORMAL;
+
+    for ( arg = 1; arg < argc; ++arg )
+    {
+        if ( 0 == strcmp( "--font", argv[arg] ) || 0 == strcmp( "-f", argv[arg] ) )
+        {
+            ++arg;
+
+            if ( font_filename )
+            {
+                fprintf( stderr, "Multiple --font parameters.\n" );
+                print_help();
+                exit( 1 );
+            }
+
+            if ( arg >= argc )
+            {
+                fprintf( stderr, "No font file given.\n" );
+                print_help();
+                exit( 1 );
+            }
+
+            font_filename = argv[arg];
+            continue;
+        }
+
+        if ( 0 == strcmp( "--header", argv[arg] ) || 0 == strcmp( "-o", argv[arg] )  )
+        {
+            ++arg;
+
+            if ( header_filename )
+            {
+                fprintf( stderr, "Multiple --header parameters.\n" );
+                print_help();
+                exit( 1 );
+            }
+
+            if ( arg >= argc )
+            {
+                fprintf( stderr, "No header file given.\n" );
+                print_help();
+                exit( 1 );
+            }
+
+            header_filename = argv[arg];
+            continue;
+        }
+
+        if ( 0 == strcmp( "--blob", argv[arg] ) || 0 == strcmp( "-b", argv[arg] )  )
+        {
+            ++arg;
+
+            if ( blob_filename )
+            {
+                fprintf( stderr, "Multiple --blob parameters.\n" );
+                print_help();
+                exit( 1 );
+            }
+
+            if ( arg >= argc )
+            {
+                fprintf( stderr, "No blob file given.\n" );
+                print_help();
+                exit( 1 );
+            }
 
-    float  font_size   = 0.0;
-    const char * font_filename   = NULL;
-    const char * header_filename = NULL;
-    const char * variable_name   = "font";
-    int show_help = 0;
-    size_t texture_width = 0;
-    rendermode_t rendermode = RENDER_NORMAL;
-    const char *rendermodes[5];
-    rendermodes[RENDER_NORMAL] = "normal";
-    rendermodes[RENDER_OUTLINE_EDGE] = "outline edge";
-    rendermodes[RENDER_OUTLINE_POSITIVE] = "outline added";
-    rendermodes[RENDER_OUTLINE_NEGATIVE] = "outline removed";
-    rendermodes[RENDER_SIGNED_DISTANCE_FIELD] = "signed distance field";
+            blob_filename = argv[arg];
+            continue;
+        }
 
-    for ( arg = 1; arg < argc; ++arg )
-    {
-        if ( 0 == strcmp( "--font", argv[arg] ) || 0 == strcmp( "-f", argv[arg] ) )
+        if ( 0 == strcmp( "--charset", argv[arg] ) || 0 == strcmp( "-c", argv[arg] )  )
         {
             ++arg;
 
-            if ( font_filename )
+            if ( charset_filename )
             {
-                fprintf( stderr, "Multiple --font parameters.\n" );
+                fprintf( stderr, "Multiple --charset parameters.\n" );
                 print_help();
                 exit( 1 );
             }
 
             if ( arg >= argc )
             {
-                fprintf( stderr, "No font file given.\n" );
+                fprintf( stderr, "No charset file given.\n" );
                 print_help();
                 exit( 1 );
             }
 
-            font_filename = argv[arg];
+            charset_filename = argv[arg];
             continue;
         }
 
-        if ( 0 == strcmp( "--header", argv[arg] ) || 0 == strcmp( "-o", argv[arg] )  )
+        if ( 0 == strcmp( "--manifest", argv[arg] ) || 0 == strcmp( "-m", argv[arg] )  )
         {
             ++arg;
 
-            if ( header_filename )
+            if ( manifest_filename )
             {
-                fprintf( stderr, "Multiple --header parameters.\n" );
+                fprintf( stderr, "Multiple --manifest parameters.\n" );
                 print_help();
                 exit( 1 );
             }
 
             if ( arg >= argc )
             {
-                fprintf( stderr, "No header file given.\n" );
+                fprintf( stderr, "No manifest file given.\n" );
                 print_help();
                 exit( 1 );
             }
 
-            header_filename = argv[arg];
+            manifest_filename = argv[arg];
+            continue;
+        }
+
+        if ( 0 == strcmp( "--jobs", argv[arg] ) || 0 == strcmp( "-j", argv[arg] ) )
+        {
+            ++arg;
+
+            if ( 0 != thread_count )
+            {
+                fprintf( stderr, "Multiple --jobs parameters.\n" );
+                print_help();
+                exit( 1 );
+            }
+
+            if ( arg >= argc || 1 > atoi( argv[arg] ) )
+            {
+                fprintf( stderr, "No valid thread count given.\n" );
+                print_help();
+                exit( 1 );
+            }
+
+            thread_count = atoi( argv[arg] );
+
             continue;
         }
 
@@ -233,29 +1497,7 @@ int main( int argc, char **argv )
                 exit( 1 );
             }
 
-            errno = 0;
-
-            if( 0 == strcmp( "normal", argv[arg] ) )
-            {
-                rendermode = RENDER_NORMAL;
-            }
-            else if( 0 == strcmp( "outline_edge", argv[arg] ) )
-            {
-                rendermode = RENDER_OUTLINE_EDGE;
-            }
-            else if( 0 == strcmp( "outline_positive", argv[arg] ) )
-            {
-                rendermode = RENDER_OUTLINE_POSITIVE;
-            }
-            else if( 0 == strcmp( "outline_negative", argv[arg] ) )
-            {
-                rendermode = RENDER_OUTLINE_NEGATIVE;
-            }
-            else if( 0 == strcmp( "sdf", argv[arg] ) )
-            {
-                rendermode = RENDER_SIGNED_DISTANCE_FIELD;
-            }
-            else
+            if ( !parse_rendermode( argv[arg], &rendermode ) )
             {
                 fprintf( stderr, "No valid render mode given.\n" );
                 print_help();
@@ -276,6 +1518,21 @@ int main( int argc, char **argv )
         exit( 1 );
     }
 
+    if ( 0 == thread_count )
+    {
+#if defined(FREETYPE_GL_USE_PTHREADS) && defined(_SC_NPROCESSORS_ONLN)
+        long online = sysconf( _SC_NPROCESSORS_ONLN );
+        thread_count = online > 0 ? online : 0;
+#endif
+        if ( 0 == thread_count )
+            thread_count = 1;
+    }
+
+    if ( manifest_filename )
+    {
+        return run_batch( manifest_filename, thread_count ) ? 0 : 1;
+    }
+
     if ( !font_filename )
     {
         fprintf( stderr, "No font file given.\n" );
@@ -309,11 +1566,30 @@ int main( int argc, char **argv )
         texture_width = 128;
     }
 
-    texture_atlas_t * atlas = texture_atlas_new( texture_width, texture_width, 1 );
-    texture_font_t  * font  = texture_font_new_from_file( atlas, font_size, font_filename );
-    font->rendermode = rendermode;
+    if ( charset_filename && !( font_cache = read_charset( charset_filename ) ) )
+    {
+        fprintf( stderr, "Charset file \"%s\" does not exist.\n", charset_filename );
+        exit( 1 );
+    }
 
-    size_t missed = texture_font_load_glyphs( font, font_cache );
+    job_t job;
+    memset( &job, 0, sizeof(job) );
+    job.font_filename = font_filename;
+    job.header_filename = header_filename;
+    job.blob_filename = blob_filename;
+    job.variable_name = variable_name;
+    job.charset = font_cache;
+    job.font_size = font_size;
+    job.texture_width = texture_width;
+    job.rendermode = rendermode;
+    job.threads = thread_count;
+
+    texture_atlas_t * atlas = texture_atlas_new( texture_width, texture_width, 1 );
+    texture_font_t  * font  = run_job( &job, atlas );
+    if ( !font )
+    {
+        exit( 1 );
+    }
 
     printf( "Font filename           : %s\n"
             "Font size               : %.1f\n"
@@ -327,222 +1603,18 @@ int main( int argc, char **argv )
             "Render mode             : %s\n",
             font_filename,
             font_size,
-            strlen(font_cache),
-            missed,
+            utf8_strlen(font_cache),
+            job.missed,
             atlas->width, atlas->height, atlas->depth,
             100.0 * atlas->used / (float)(atlas->width * atlas->height),
             header_filename,
             variable_name,
-            rendermodes[rendermode] );
-
-    size_t texture_size = atlas->width * atlas->height * atlas->depth;
-    size_t glyph_count = font->glyphs->size;
-    size_t max_kerning_count = 1;
-    for( i=0; i < glyph_count; ++i )
-    {
-        texture_glyph_t **glyph_0x100 = *(texture_glyph_t ***) vector_get( font->glyphs, i );
-	if(glyph_0x100) {
-	    for( j=0; j < 0x100; ++j ) {
-		texture_glyph_t *glyph;
-		if(( glyph = glyph_0x100[j] )) {
-		    size_t new_max = vector_size(glyph->kerning);
-		    if( new_max > max_kerning_count )
-			max_kerning_count = new_max;
-		}
-	    }
-	}
-    }
-
-
-    FILE *file = fopen( header_filename, "w" );
-
-
-    // -------------
-    // Header
-    // -------------
-    fprintf( file,
-        "/* ============================================================================\n"
-        " * Freetype GL - A C OpenGL Freetype engine\n"
-        " * Platform:    Any\n"
-        " * WWW:         https://github.com/rougier/freetype-gl\n"
-        " * ----------------------------------------------------------------------------\n"
-        " * Copyright 2011,2012 Nicolas P. Rougier. All rights reserved.\n"
-        " *\n"
-        " * Redistribution and use in source and binary forms, with or without\n"
-        " * modification, are permitted provided that the following conditions are met:\n"
-        " *\n"
-        " *  1. Redistributions of source code must retain the above copyright notice,\n"
-        " *     this list of conditions and the following disclaimer.\n"
-        " *\n"
-        " *  2. Redistributions in binary form must reproduce the above copyright\n"
-        " *     notice, this list of conditions and the following disclaimer in the\n"
-        " *     documentation and/or other materials provided with the distribution.\n"
-        " *\n"
-        " * THIS SOFTWARE IS PROVIDED BY NICOLAS P. ROUGIER ''AS IS'' AND ANY EXPRESS OR\n"
-        " * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF\n"
-        " * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO\n"
-        " * EVENT SHALL NICOLAS P. ROUGIER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,\n"
-        " * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES\n"
-        " * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;\n"
-        " * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND\n"
-        " * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT\n"
-        " * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF\n"
-        " * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.\n"
-        " *\n"
-        " * The views and conclusions contained in the software and documentation are\n"
-        " * those of the authors and should not be interpreted as representing official\n"
-        " * policies, either expressed or implied, of Nicolas P. Rougier.\n"
-        " * ============================================================================\n"
-        " */\n\n");
-
-    fprintf( file, 
-        "/* ============================================================================\n"
-        " * Parameters\n"
-        " * ----------------------------------------------------------------------------\n"
-        " * Font size: %f\n"
-        " * Texture width: %zu\n"
-        " * Texture height: %zu\n"
-        " * Texture depth: %zu\n"
-        " * ===============================================================================\n"
-        " */\n\n", 
-        font_size, atlas->width, atlas->height, atlas->depth);
-
-
-    // ----------------------
-    // Structure declarations
-    // ----------------------
-    fprintf( file,
-	     "#include <stddef.h>\n"
-	     "#include <stdint.h>\n"
-	     "#ifdef __cplusplus\n"
-	     "extern \"C\" {\n"
-	     "#endif\n"
-	     "\n" );
-
-    fprintf( file,
-        "typedef struct\n"
-        "{\n"
-        "    uint32_t codepoint;\n"
-        "    int width, height;\n"
-        "    int offset_x, offset_y;\n"
-        "    float advance_x, advance_y;\n"
-        "    float s0, t0, s1, t1;\n"
-        "    size_t kerning_count;\n"
-        "    float kerning[%" PRIzu "][0x100];\n"
-        "} texture_glyph_t;\n\n", max_kerning_count );
-
-    fprintf( file,
-        "typedef struct\n"
-        "{\n"
-        "    size_t tex_width;\n"
-        "    size_t tex_height;\n"
-        "    size_t tex_depth;\n"
-        "    unsigned char tex_data[%" PRIzu "];\n"
-        "    float size;\n"
-        "    float height;\n"
-        "    float linegap;\n"
-        "    float ascender;\n"
-        "    float descender;\n"
-        "    size_t glyphs_count;\n"
-        "    texture_glyph_t *glyphs[%" PRIzu "][0x100];\n"
-        "} texture_font_t;\n\n", texture_size, glyph_count );
-
-    texture_glyph_t * glyph;
-
-    GLYPHS_ITERATOR(i, glyph, font->glyphs) {
-	fprintf( file, "texture_glyph_t %s_glyph_%08x = ", variable_name, glyph->codepoint );
- /*
-        // Debugging information
-        printf( "glyph : '%lc'\n",
-                 glyph->codepoint );
-        printf( "  size       : %dx%d\n",
-                 glyph->width, glyph->height );
-        printf( "  offset     : %+d%+d\n",
-                 glyph->offset_x, glyph->offset_y );
-        printf( "  advance    : %ff, %ff\n",
-                 glyph->advance_x, glyph->advance_y );
-        printf( "  tex coords.: %ff, %ff, %ff, %ff\n",
-                 glyph->u0, glyph->v0, glyph->u1, glyph->v1 );
-
-        printf( "  kerning    : " );
-        if( glyph->kerning_count )
-        {
-            for( j=0; j < glyph->kerning_count; ++j )
-            {
-                printf( "('%lc', %ff)",
-                         glyph->kerning[j].codepoint, glyph->kerning[j].kerning );
-                if( j < (glyph->kerning_count-1) )
-                {
-                    printf( ", " );
-                }
-            }
-        }
-        else
-        {
-            printf( "None" );
-        }
-        printf( "\n\n" );
-*/
-	print_glyph(file, glyph);
-    }
-    GLYPHS_ITERATOR_END
-
-    fprintf( file, "texture_font_t %s = {\n", variable_name );
-
-
-    // ------------
-    // Texture data
-    // ------------
-    fprintf( file, " %" PRIzu ", %" PRIzu ", %" PRIzu ",\n", atlas->width, atlas->height, atlas->depth );
-    fprintf( file, " {" );
-    for( i=0; i < texture_size; i+= 32 )
+            rendermode_names[rendermode] );
+    if ( blob_filename )
     {
-        for( j=0; j < 32 && (j+i) < texture_size ; ++ j)
-        {
-            if( (j+i) < (texture_size-1) )
-            {
-                fprintf( file, "%d,", atlas->data[i+j] );
-            }
-            else
-            {
-                fprintf( file, "%d", atlas->data[i+j] );
-            }
-        }
-        if( (j+i) < texture_size )
-        {
-            fprintf( file, "\n" );
-        }
+        printf( "Blob filename           : %s\n", blob_filename );
     }
-    fprintf( file, "}, \n" );
-
-
-    // -------------------
-    // Texture information
-    // -------------------
-    fprintf( file, " %ff, %ff, %ff, %ff, %ff, %" PRIzu ", \n",
-             font->size, font->height,
-             font->linegap,font->ascender, font->descender,
-             glyph_count );
 
-    // --------------
-    // Texture glyphs
-    // --------------
-    fprintf( file, " {\n" );
-    GLYPHS_ITERATOR1(i, glyph, font->glyphs) {
-	fprintf( file, " {\n" );
-	GLYPHS_ITERATOR2(i, glyph, font->glyphs) {
-	    fprintf( file, "  &%s_glyph_%08x,\n", variable_name, glyph->codepoint );
-	} else {
-	    fprintf( file, "  NULL,\n" );
-	}
-	GLYPHS_ITERATOR_END1;
-	fprintf( file, " },\n" );
-    } GLYPHS_ITERATOR_END2;
-    fprintf( file, " }\n};\n" );
-    fprintf( file,
-        "#ifdef __cplusplus\n"
-        "}\n"
-        "#endif\n" );
 
-    return 0;
+    return write_font( &job, font ) ? 0 : 1;
 }
@@ -0,0 +1,359 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pixel-convert.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define PIXEL_CONVERT_SSE2
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  define PIXEL_CONVERT_NEON
+#  include <arm_neon.h>
+#endif
+
+
+// -------------------------------------------- convert_bgra_to_rgba_scalar ---
+void
+convert_bgra_to_rgba_scalar( unsigned char *dst, const unsigned char *src,
+                             size_t count )
+{
+    size_t i;
+
+    for( i = 0; i < count; ++i, dst += 4, src += 4 )
+    {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        dst[3] = src[3];
+    }
+}
+
+// -------------------------------------------- convert_bgra_to_grey_scalar ---
+void
+convert_bgra_to_grey_scalar( unsigned char *dst, const unsigned char *src,
+                             size_t count )
+{
+    size_t i;
+
+    for( i = 0; i < count; ++i, src += 4 )
+    {
+        dst[i] = (0.3*src[2] + 0.59*src[1] + 0.11*src[0]) * (src[3]/255.0);
+    }
+}
+
+// -------------------------------------------- convert_grey_to_rgba_scalar ---
+void
+convert_grey_to_rgba_scalar( unsigned char *dst, const unsigned char *src,
+                             size_t count )
+{
+    size_t i;
+
+    for( i = 0; i < count; ++i, dst += 4 )
+    {
+        dst[0] = 255;
+        dst[1] = 255;
+        dst[2] = 255;
+        dst[3] = src[i];
+    }
+}
+
+#if defined(PIXEL_CONVERT_SSE2)
+
+// --------------------------------------------------- convert_bgra_to_rgba ---
+void
+convert_bgra_to_rgba( unsigned char *dst, const unsigned char *src,
+                      size_t count )
+{
+    // Compilers vectorize the scalar version as well as masks and shifts
+    // do, with SSE2 or better if enabled
+    convert_bgra_to_rgba_scalar( dst, src, count );
+}
+
+// --------------------------------------------------- convert_bgra_to_grey ---
+void
+convert_bgra_to_grey( unsigned char *dst, const unsigned char *src,
+                      size_t count )
+{
+    const __m128i byte = _mm_set1_epi32( 0xFF );
+    const __m128d kr = _mm_set1_pd( 0.3 );
+    const __m128d kg = _mm_set1_pd( 0.59 );
+    const __m128d kb = _mm_set1_pd( 0.11 );
+    const __m128d k255 = _mm_set1_pd( 255.0 );
+    size_t i;
+    int j;
+
+    // Same double precision operations, in the same order, as the scalar
+    // version, 2 pixels per vector
+    for( i = 0; i + 4 <= count; i += 4 )
+    {
+        __m128i p = _mm_loadu_si128( (const __m128i *)(src + 4*i) );
+        __m128i channel[4], grey[2];
+
+        channel[0] = _mm_and_si128( p, byte );
+        channel[1] = _mm_and_si128( _mm_srli_epi32( p, 8 ), byte );
+        channel[2] = _mm_and_si128( _mm_srli_epi32( p, 16 ), byte );
+        channel[3] = _mm_srli_epi32( p, 24 );
+        for( j = 0; j < 2; ++j )
+        {
+            __m128d b = _mm_cvtepi32_pd( channel[0] );
+            __m128d g = _mm_cvtepi32_pd( channel[1] );
+            __m128d r = _mm_cvtepi32_pd( channel[2] );
+            __m128d a = _mm_cvtepi32_pd( channel[3] );
+            __m128d v = _mm_add_pd( _mm_add_pd( _mm_mul_pd( kr, r ),
+                                                _mm_mul_pd( kg, g ) ),
+                                    _mm_mul_pd( kb, b ) );
+            v = _mm_mul_pd( v, _mm_div_pd( a, k255 ) );
+            grey[j] = _mm_cvttpd_epi32( v );
+
+            channel[0] = _mm_srli_si128( channel[0], 8 );
+            channel[1] = _mm_srli_si128( channel[1], 8 );
+            channel[2] = _mm_srli_si128( channel[2], 8 );
+            channel[3] = _mm_srli_si128( channel[3], 8 );
+        }
+        p = _mm_unpacklo_epi64( grey[0], grey[1] );
+        p = _mm_packs_epi32( p, p );
+        p = _mm_packus_epi16( p, p );
+        j = _mm_cvtsi128_si32( p );
+        dst[i+0] = (unsigned char)(j);
+        dst[i+1] = (unsigned char)(j >> 8);
+        dst[i+2] = (unsigned char)(j >> 16);
+        dst[i+3] = (unsigned char)(j >> 24);
+    }
+    convert_bgra_to_grey_scalar( dst + i, src + 4*i, count - i );
+}
+
+// --------------------------------------------------- convert_grey_to_rgba ---
+void
+convert_grey_to_rgba( unsigned char *dst, const unsigned char *src,
+                      size_t count )
+{
+    const __m128i white = _mm_set1_epi8( (char)0xFF );
+    size_t i;
+
+    // Interleave 16 grey levels with white, twice
+    for( i = 0; i + 16 <= count; i += 16 )
+    {
+        __m128i p = _mm_loadu_si128( (const __m128i *)(src + i) );
+        __m128i lo = _mm_unpacklo_epi8( white, p );
+        __m128i hi = _mm_unpackhi_epi8( white, p );
+        _mm_storeu_si128( (__m128i *)(dst + 4*i),
+                          _mm_unpacklo_epi16( white, lo ) );
+        _mm_storeu_si128( (__m128i *)(dst + 4*i + 16),
+                          _mm_unpackhi_epi16( white, lo ) );
+        _mm_storeu_si128( (__m128i *)(dst + 4*i + 32),
+                          _mm_unpacklo_epi16( white, hi ) );
+        _mm_storeu_si128( (__m128i *)(dst + 4*i + 48),
+                          _mm_unpackhi_epi16( white, hi ) );
+    }
+    convert_grey_to_rgba_scalar( dst + 4*i, src + i, count - i );
+}
+
+#elif defined(PIXEL_CONVERT_NEON)
+
+// --------------------------------------------------- convert_bgra_to_rgba ---
+void
+convert_bgra_to_rgba( unsigned char *dst, const unsigned char *src,
+                      size_t count )
+{
+    size_t i;
+
+    for( i = 0; i + 16 <= count; i += 16 )
+    {
+        uint8x16x4_t p = vld4q_u8( src + 4*i );
+        uint8x16_t blue = p.val[0];
+        p.val[0] = p.val[2];
+        p.val[2] = blue;
+        vst4q_u8( dst + 4*i, p );
+    }
+    convert_bgra_to_rgba_scalar( dst + 4*i, src + 4*i, count - i );
+}
+
+// --------------------------------------------------- convert_bgra_to_grey ---
+void
+convert_bgra_to_grey( unsigned char *dst, const unsigned char *src,
+                      size_t count )
+{
+    // The conversion is done in double precision, that NEON lacks on 32 bit
+    // ARM and that compilers may fuse differently on 64 bit ARM.
+    convert_bgra_to_grey_scalar( dst, src, count );
+}
+
+// --------------------------------------------------- convert_grey_to_rgba ---
+void
+convert_grey_to_rgba( unsigned char *dst, const unsigned char *src,
+                      size_t count )
+{
+    uint8x16x4_t p;
+    size_t i;
+
+    p.val[0] = p.val[1] = p.val[2] = vdupq_n_u8( 255 );
+    for( i = 0; i + 16 <= count; i += 16 )
+    {
+        p.val[3] = vld1q_u8( src + i );
+        vst4q_u8( dst + 4*i, p );
+    }
+    convert_grey_to_rgba_scalar( dst + 4*i, src + i, count - i );
+}
+
+#else
+
+// --------------------------------------------------- convert_bgra_to_rgba ---
+void
+convert_bgra_to_rgba( unsigned char *dst, const unsigned char *src,
+                      size_t count )
+{
+    convert_bgra_to_rgba_scalar( dst, src, count );
+}
+
+// --------------------------------------------------- convert_bgra_to_grey ---
+void
+convert_bgra_to_grey( unsigned char *dst, const unsigned char *src,
+                      size_t count )
+{
+    convert_bgra_to_grey_scalar( dst, src, count );
+}
+
+// --------------------------------------------------- convert_grey_to_rgba ---
+void
+convert_grey_to_rgba( unsigned char *dst, const unsigned char *src,
+                      size_t count )
+{
+    convert_grey_to_rgba_scalar( dst, src, count );
+}
+
+#endif
+
+// ----------------------------------------------------------- area_weights ---
+// Source pixels covered by each destination pixel, from first[i] on, and
+// the fraction of the destination pixel they cover, span per pixel
+static void
+area_weights( size_t src_size, size_t dst_size, size_t span,
+              size_t *first, float *weights )
+{
+    float ratio = src_size / (float)dst_size;
+    size_t i, j;
+
+    for( i = 0; i < dst_size; ++i )
+    {
+        float start = i * ratio;
+        float end = i + 1 < dst_size ? (i + 1) * ratio : (float)src_size;
+
+        first[i] = (size_t)start;
+        for( j = 0; j < span; ++j )
+        {
+            float p = (float)(first[i] + j);
+            float w = ((p + 1 < end ? p + 1 : end) - (p > start ? p : start));
+            weights[i*span + j] = w > 0 && first[i] + j < src_size ? w / ratio : 0;
+        }
+    }
+}
+
+// --------------------------------------------------------- downscale_area ---
+void
+downscale_area( unsigned char *dst, size_t dst_width, size_t dst_height,
+                const unsigned char *src, size_t src_width, size_t src_height,
+                size_t src_pitch, size_t channels )
+{
+    size_t span_x = src_width / dst_width + 2;
+    size_t span_y = src_height / dst_height + 2;
+    size_t * first_x = (size_t *) malloc( dst_width * sizeof(size_t) );
+    size_t * first_y = (size_t *) malloc( dst_height * sizeof(size_t) );
+    float * weights_x = (float *) malloc( dst_width * span_x * sizeof(float) );
+    float * weights_y = (float *) malloc( dst_height * span_y * sizeof(float) );
+    float * row = (float *) malloc( src_width * channels * sizeof(float) );
+    size_t length = src_width * channels;
+    size_t x, y, i, k, c;
+
+    area_weights( src_width, dst_width, span_x, first_x, weights_x );
+    area_weights( src_height, dst_height, span_y, first_y, weights_y );
+
+    for( y = 0; y < dst_height; ++y )
+    {
+        // Vertical pass: blend the source rows covered, over their length
+        memset( row, 0, length * sizeof(float) );
+        for( i = 0; i < span_y; ++i )
+        {
+            const unsigned char * s;
+            float w = weights_y[y*span_y + i];
+
+            if( w == 0 )
+                continue;
+            s = src + (first_y[y] + i) * src_pitch;
+            k = 0;
+#if defined(PIXEL_CONVERT_SSE2)
+            {
+                const __m128i zero = _mm_setzero_si128( );
+                const __m128 weight = _mm_set1_ps( w );
+                for( ; k + 16 <= length; k += 16 )
+                {
+                    __m128i p = _mm_loadu_si128( (const __m128i *)(s + k) );
+                    __m128i lo = _mm_unpacklo_epi8( p, zero );
+                    __m128i hi = _mm_unpackhi_epi8( p, zero );
+                    __m128 v[4];
+                    int j;
+
+                    v[0] = _mm_cvtepi32_ps( _mm_unpacklo_epi16( lo, zero ) );
+                    v[1] = _mm_cvtepi32_ps( _mm_unpackhi_epi16( lo, zero ) );
+                    v[2] = _mm_cvtepi32_ps( _mm_unpacklo_epi16( hi, zero ) );
+                    v[3] = _mm_cvtepi32_ps( _mm_unpackhi_epi16( hi, zero ) );
+                    for( j = 0; j < 4; ++j )
+                    {
+                        __m128 r = _mm_loadu_ps( row + k + 4*j );
+                        r = _mm_add_ps( r, _mm_mul_ps( weight, v[j] ) );
+                        _mm_storeu_ps( row + k + 4*j, r );
+                    }
+                }
+            }
+#elif defined(PIXEL_CONVERT_NEON)
+            for( ; k + 16 <= length; k += 16 )
+            {
+                uint8x16_t p = vld1q_u8( s + k );
+                uint16x8_t lo = vmovl_u8( vget_low_u8( p ) );
+                uint16x8_t hi = vmovl_u8( vget_high_u8( p ) );
+                float32x4_t v[4];
+                int j;
+
+                v[0] = vcvtq_f32_u32( vmovl_u16( vget_low_u16( lo ) ) );
+                v[1] = vcvtq_f32_u32( vmovl_u16( vget_high_u16( lo ) ) );
+                v[2] = vcvtq_f32_u32( vmovl_u16( vget_low_u16( hi ) ) );
+                v[3] = vcvtq_f32_u32( vmovl_u16( vget_high_u16( hi ) ) );
+                for( j = 0; j < 4; ++j )
+                {
+                    float32x4_t r = vld1q_f32( row + k + 4*j );
+                    vst1q_f32( row + k + 4*j, vmlaq_n_f32( r, v[j], w ) );
+                }
+            }
+#endif
+            for( ; k < length; ++k )
+            {
+                row[k] += w * s[k];
+            }
+        }
+
+        // Horizontal pass: blend the pixels covered in the blended row
+        for( x = 0; x < dst_width; ++x )
+        {
+            for( c = 0; c < channels; ++c )
+            {
+                float v = 0;
+                for( i = 0; i < span_x; ++i )
+                {
+                    float w = weights_x[x*span_x + i];
+                    if( w != 0 )
+                        v += w * row[(first_x[x] + i) * channels + c];
+                }
+                *dst++ = v < 254.5f ? (unsigned char)(v + 0.5f) : 255;
+            }
+        }
+    }
+
+    free( first_x );
+    free( first_y );
+    free( weights_x );
+    free( weights_y );
+    free( row );
+}
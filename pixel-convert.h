@@ -0,0 +1,114 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#ifndef __PIXEL_CONVERT_H__
+#define __PIXEL_CONVERT_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+namespace ftgl {
+#endif
+
+/**
+ * @file   pixel-convert.h
+ *
+ * @defgroup pixel-convert Pixel conversion
+ *
+ * Functions to convert FreeType bitmaps to the atlas format.
+ *
+ * Each conversion has a SIMD version, chosen at compile time (SSE2 on x86,
+ * NEON on ARM), and a scalar version that gives the exact same result and
+ * is used when no SIMD is available. On x86, BGRA to RGBA uses the scalar
+ * version, which compilers vectorize as well.
+ *
+ * @{
+ */
+
+/**
+ * Convert BGRA pixels to RGBA pixels.
+ *
+ * @param dst    Destination, 4 * count bytes
+ * @param src    Source, 4 * count bytes
+ * @param count  Number of pixels
+ */
+void
+convert_bgra_to_rgba( unsigned char *dst, const unsigned char *src,
+                      size_t count );
+
+/**
+ * Convert BGRA pixels to grey, using a weighted sum for luminosity,
+ * multiplied by alpha.
+ *
+ * @param dst    Destination, count bytes
+ * @param src    Source, 4 * count bytes
+ * @param count  Number of pixels
+ */
+void
+convert_bgra_to_grey( unsigned char *dst, const unsigned char *src,
+                      size_t count );
+
+/**
+ * Convert grey pixels to white RGBA pixels, using grey level for alpha.
+ *
+ * @param dst    Destination, 4 * count bytes
+ * @param src    Source, count bytes
+ * @param count  Number of pixels
+ */
+void
+convert_grey_to_rgba( unsigned char *dst, const unsigned char *src,
+                      size_t count );
+
+/**
+ * Downscale an image with an area filter: each destination pixel is the
+ * average of the source pixels it covers, weighted by how much of them it
+ * covers. Channels are filtered separately, colors should be premultiplied
+ * by alpha as in FreeType color bitmaps. The vertical pass uses SIMD when
+ * available.
+ *
+ * @param dst         Destination, dst_width * dst_height * channels bytes
+ * @param dst_width   Destination width, at most src_width
+ * @param dst_height  Destination height, at most src_height
+ * @param src         Source image
+ * @param src_width   Source width
+ * @param src_height  Source height
+ * @param src_pitch   Bytes between two rows of the source
+ * @param channels    Bytes per pixel
+ */
+void
+downscale_area( unsigned char *dst, size_t dst_width, size_t dst_height,
+                const unsigned char *src, size_t src_width, size_t src_height,
+                size_t src_pitch, size_t channels );
+
+/**
+ * Scalar version of convert_bgra_to_rgba.
+ */
+void
+convert_bgra_to_rgba_scalar( unsigned char *dst, const unsigned char *src,
+                             size_t count );
+
+/**
+ * Scalar version of convert_bgra_to_grey.
+ */
+void
+convert_bgra_to_grey_scalar( unsigned char *dst, const unsigned char *src,
+                             size_t count );
+
+/**
+ * Scalar version of convert_grey_to_rgba.
+ */
+void
+convert_grey_to_rgba_scalar( unsigned char *dst, const unsigned char *src,
+                             size_t count );
+
+/** @} */
+
+#ifdef __cplusplus
+}
+}
+#endif
+
+#endif /* __PIXEL_CONVERT_H__ */
@@ -0,0 +1,36 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+uniform sampler2D tex;
+uniform vec3 pixel;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// Unit quad corner, per vertex
+attribute vec2 corner;
+
+// Glyph instance (GLYPH_VERTEX_INSTANCED), per instance, to be used with
+// text.frag: params are the shifts of the left and right edges, gamma and
+// atlas page
+attribute vec4 rect;
+attribute vec4 tex_rect;
+attribute vec4 color;
+attribute vec4 params;
+
+varying vec4 vcolor;
+varying vec2 vtex_coord;
+varying float vshift;
+varying float vgamma;
+
+void main()
+{
+    vshift = mix(params.x, params.y, corner.x);
+    vgamma = params.z;
+    vcolor = color;
+    vtex_coord = mix(tex_rect.xy, tex_rect.zw, corner);
+    gl_Position = projection*(view*(model*vec4(rect.xy + corner*rect.zw,
+                                               0.0, 1.0)));
+}
@@ -0,0 +1,32 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+uniform sampler2D tex;
+uniform vec3 pixel;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// Packed text buffer vertices (GLYPH_VERTEX_PACKED), to be used with
+// text.frag: vertex in pixels, tex_coord and color normalized, params are
+// shift (127 being 1), gamma (32 being 1) and atlas page
+attribute vec2 vertex;
+attribute vec4 color;
+attribute vec2 tex_coord;
+attribute vec4 params;
+
+varying vec4 vcolor;
+varying vec2 vtex_coord;
+varying float vshift;
+varying float vgamma;
+
+void main()
+{
+    vshift = params.x / 127.0;
+    vgamma = params.y / 32.0;
+    vcolor = color;
+    vtex_coord = tex_coord;
+    gl_Position = projection*(view*(model*vec4(vertex,0.0,1.0)));
+}
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 #include <stdbool.h>
 #include <assert.h>
 #include <math.h>
@@ -14,10 +15,10 @@
 #include "utf8-utils.h"
 #include "ftgl-utils.h"
 
-#define SET_GLYPH_VERTEX(value,x0,y0,z0,s0,t0,r,g,b,a,sh,gm) { \
-    glyph_vertex_t *gv=&value;				       \
+#define SET_GLYPH_VERTEX(value,x0,y0,z0,s0,t0,l0,r,g,b,a,sh,gm) { \
+    glyph_vertex_layered_t *gv=&value;			       \
     gv->x=x0; gv->y=y0; gv->z=z0;			       \
-    gv->u=s0; gv->v=t0;					       \
+    gv->u=s0; gv->v=t0; gv->layer=l0;			       \
     gv->r=r; gv->g=g; gv->b=b; gv->a=a;			       \
     gv->shift=sh; gv->gamma=gm;}
 
@@ -25,10 +26,43 @@
 
 text_buffer_t *
 text_buffer_new( void )
+{
+    return text_buffer_new_with_format( GLYPH_VERTEX_FLOAT );
+}
+
+// ----------------------------------------------------------------------------
+text_buffer_t *
+text_buffer_new_with_format( enum Glyph_Vertex_Format format )
 {
     text_buffer_t *self = (text_buffer_t *) malloc (sizeof(text_buffer_t));
-    self->buffer = vertex_buffer_new(
-                                     "vertex:3f,tex_coord:2f,color:4f,ashift:1f,agamma:1f" );
+    self->quad = NULL;
+    if( format == GLYPH_VERTEX_PACKED )
+    {
+        self->buffer = vertex_buffer_new(
+                                         "vertex:2s,tex_coord:2Sn,color:4Bn,params:4b" );
+    }
+    else if( format == GLYPH_VERTEX_INSTANCED )
+    {
+        // Corners in the order of the vertices of the other formats
+        float corners[4*2] = { 0,0,  0,1,  1,1,  1,0 };
+        GLuint indices[6] = { 0,1,2, 0,2,3 };
+
+        self->buffer = vertex_buffer_new(
+                                         "rect:4f,tex_rect:4f,color:4f,params:4f" );
+        self->quad = vertex_buffer_new( "corner:2f" );
+        vertex_buffer_push_back( self->quad, corners, 4, indices, 6 );
+    }
+    else if( format == GLYPH_VERTEX_LAYERED )
+    {
+        self->buffer = vertex_buffer_new(
+                                         "vertex:3f,tex_coord:3f,color:4f,ashift:1f,agamma:1f" );
+    }
+    else
+    {
+        self->buffer = vertex_buffer_new(
+                                         "vertex:3f,tex_coord:2f,color:4f,ashift:1f,agamma:1f" );
+    }
+    self->vertex_format = format;
     self->line_start = 0;
     self->line_ascender = 0;
     self->base_color.r = 0.0;
@@ -50,6 +84,10 @@ text_buffer_delete( text_buffer_t * self )
 {
     vector_delete( self->lines );
     vertex_buffer_delete( self->buffer );
+    if( self->quad )
+    {
+        vertex_buffer_delete( self->quad );
+    }
     free( self );
 }
 
@@ -97,23 +135,82 @@ text_buffer_printf( text_buffer_t * self, vec2 *pen, ... )
 }
 
 // ----------------------------------------------------------------------------
-void
-text_buffer_move_last_line( text_buffer_t * self, float dy )
+// text_buffer_pack_position (internal use only)
+//
+// Converts a coordinate to the packed format, saturated to its range
+//
+static GLshort
+text_buffer_pack_position( float value )
 {
-    size_t i;
+    return (GLshort) ( value < -32767 ? -32767 :
+                       value >  32767 ?  32767 : value );
+}
+
+// ----------------------------------------------------------------------------
+// text_buffer_move_items (internal use only)
+//
+// Moves the vertices of items first to last (excluded) by dx, dy whole
+// pixels, and marks them as modified
+//
+static void
+text_buffer_move_items( text_buffer_t * self, size_t first, size_t last,
+                        float dx, float dy )
+{
+    size_t i, vfirst = 0, vlast = 0;
     int j;
-    for( i=self->line_start; i < vector_size( self->buffer->items ); ++i )
+    for( i=first; i < last; ++i )
     {
         ivec4 *item = (ivec4 *) vector_get( self->buffer->items, i);
+        if( (size_t) item->vstart != vlast )
+        {
+            vertex_buffer_invalidate_vertices( self->buffer, vfirst, vlast );
+            vfirst = item->vstart;
+        }
+        vlast = item->vstart + item->vcount;
         for( j=item->vstart; j<item->vstart+item->vcount; ++j)
         {
-            glyph_vertex_t * vertex =
-                (glyph_vertex_t *)  vector_get( self->buffer->vertices, j );
-            vertex->y -= dy;
+            if( self->vertex_format == GLYPH_VERTEX_INSTANCED )
+            {
+                glyph_instance_t * instance = (glyph_instance_t *)
+                    vector_get( self->buffer->vertices, j );
+                instance->x += dx;
+                instance->y += dy;
+            }
+            else if( self->vertex_format == GLYPH_VERTEX_PACKED )
+            {
+                glyph_vertex_packed_t * vertex = (glyph_vertex_packed_t *)
+                    vector_get( self->buffer->vertices, j );
+                vertex->x = text_buffer_pack_position( vertex->x +
+                                                       roundf( dx ) );
+                vertex->y = text_buffer_pack_position( vertex->y +
+                                                       roundf( dy ) );
+            }
+            else if( self->vertex_format == GLYPH_VERTEX_LAYERED )
+            {
+                glyph_vertex_layered_t * vertex = (glyph_vertex_layered_t *)
+                    vector_get( self->buffer->vertices, j );
+                vertex->x += dx;
+                vertex->y += dy;
+            }
+            else
+            {
+                glyph_vertex_t * vertex =
+                    (glyph_vertex_t *)  vector_get( self->buffer->vertices, j );
+                vertex->x += dx;
+                vertex->y += dy;
+            }
         }
     }
+    vertex_buffer_invalidate_vertices( self->buffer, vfirst, vlast );
 }
 
+// ----------------------------------------------------------------------------
+void
+text_buffer_move_last_line( text_buffer_t * self, float dy )
+{
+    text_buffer_move_items( self, self->line_start,
+                            vector_size( self->buffer->items ), 0, -dy );
+}
 
 // ----------------------------------------------------------------------------
 // text_buffer_finish_line (internal use only)
@@ -176,14 +273,342 @@ text_buffer_finish_line( text_buffer_t * self, vec2 * pen, bool advancePen )
     self->line_left = pen->x;
 }
 
+// ----------------------------------------------------------------------------
+// text_buffer_grow (internal use only)
+//
+// Makes room for count more items in a vector, doubling its capacity when
+// it is exceeded so that adding glyphs one by one does not reallocate the
+// whole vector each time
+//
+static void
+text_buffer_grow( vector_t * vector, size_t count )
+{
+    size_t size = vector->size + count;
+
+    if( size > vector->capacity )
+    {
+        vector_reserve( vector, size > 2 * vector->capacity ?
+                                size : 2 * vector->capacity );
+    }
+}
+
+// ----------------------------------------------------------------------------
+// text_buffer_reserve (internal use only)
+//
+// Makes room for count more glyphs drawn with markup: one quad for the
+// glyph and one for each decoration, one item per glyph
+//
+static void
+text_buffer_reserve( text_buffer_t * self, const markup_t * markup,
+                     size_t count )
+{
+    size_t quads = 1 + ( markup->background_color.alpha > 0 ) +
+        ( markup->underline != 0 ) + ( markup->overline != 0 ) +
+        ( markup->strikethrough != 0 );
+
+    if( self->vertex_format == GLYPH_VERTEX_INSTANCED )
+    {
+        text_buffer_grow( self->buffer->vertices, quads * count );
+    }
+    else
+    {
+        text_buffer_grow( self->buffer->vertices, 4 * quads * count );
+        text_buffer_grow( self->buffer->indices, 6 * quads * count );
+    }
+    text_buffer_grow( self->buffer->items, count );
+}
+
+// ----------------------------------------------------------------------------
+// text_buffer_pack (internal use only)
+//
+// Quantizes value, expected within 0..1, to 0..max
+//
+static int
+text_buffer_pack( float value, int max )
+{
+    if( value <= 0 )
+    {
+        return 0;
+    }
+    if( value >= 1 )
+    {
+        return max;
+    }
+    return (int)( value * max + .5f );
+}
+
+// ----------------------------------------------------------------------------
+// text_buffer_pack_vertex (internal use only)
+//
+// Converts a vertex to the packed format
+//
+static void
+text_buffer_pack_vertex( glyph_vertex_packed_t * packed,
+                         const glyph_vertex_layered_t * vertex )
+{
+    packed->x = text_buffer_pack_position( vertex->x );
+    packed->y = text_buffer_pack_position( vertex->y );
+    packed->u = (GLushort) text_buffer_pack( vertex->u, 65535 );
+    packed->v = (GLushort) text_buffer_pack( vertex->v, 65535 );
+    packed->r = (GLubyte) text_buffer_pack( vertex->r, 255 );
+    packed->g = (GLubyte) text_buffer_pack( vertex->g, 255 );
+    packed->b = (GLubyte) text_buffer_pack( vertex->b, 255 );
+    packed->a = (GLubyte) text_buffer_pack( vertex->a, 255 );
+    packed->shift = (GLbyte) ( vertex->shift < 0 ?
+                               -text_buffer_pack( -vertex->shift, 127 ) :
+                               text_buffer_pack( vertex->shift, 127 ) );
+    packed->gamma = (GLbyte) text_buffer_pack( vertex->gamma * 32 / 127, 127 );
+    packed->layer = (GLbyte) vertex->layer;
+    packed->padding = 0;
+}
+
+// ----------------------------------------------------------------------------
+// text_buffer_add_quad (internal use only)
+//
+// Writes the 4 vertices, from index vstart, and 6 indices of a quad
+// textured with glyph, or its instance at index vstart. x coordinates are
+// snapped to pixels and their fractional part given as the shift
+//
+static void
+text_buffer_add_quad( text_buffer_t * self, size_t vstart, GLuint * indices,
+                      float x0, float y0, float x1, float y1,
+                      const texture_glyph_t * glyph, const vec4 * color,
+                      float gamma )
+{
+    vector_t * vertices = self->buffer->vertices;
+    glyph_vertex_layered_t quad[4];
+    float s0 = glyph->s0;
+    float t0 = glyph->t0;
+    float s1 = glyph->s1;
+    float t1 = glyph->t1;
+    float l = (float)glyph->page;
+    float r = color->r;
+    float g = color->g;
+    float b = color->b;
+    float a = color->a;
+    size_t i;
+
+    if( self->vertex_format == GLYPH_VERTEX_INSTANCED )
+    {
+        glyph_instance_t * instance =
+            (glyph_instance_t *) vertices->items + vstart;
+        instance->x = (float)(int)x0;
+        instance->y = y0;
+        instance->width = (float)(int)x1 - (float)(int)x0;
+        instance->height = y1 - y0;
+        instance->s0 = s0;
+        instance->t0 = t0;
+        instance->s1 = s1;
+        instance->t1 = t1;
+        instance->r = r;
+        instance->g = g;
+        instance->b = b;
+        instance->a = a;
+        instance->shift0 = x0-((int)x0);
+        instance->shift1 = x1-((int)x1);
+        instance->gamma = gamma;
+        instance->layer = l;
+        return;
+    }
+
+    SET_GLYPH_VERTEX(quad[0],
+                     (float)(int)x0,y0,0,  s0,t0,l,  r,g,b,a,  x0-((int)x0), gamma );
+    SET_GLYPH_VERTEX(quad[1],
+                     (float)(int)x0,y1,0,  s0,t1,l,  r,g,b,a,  x0-((int)x0), gamma );
+    SET_GLYPH_VERTEX(quad[2],
+                     (float)(int)x1,y1,0,  s1,t1,l,  r,g,b,a,  x1-((int)x1), gamma );
+    SET_GLYPH_VERTEX(quad[3],
+                     (float)(int)x1,y0,0,  s1,t0,l,  r,g,b,a,  x1-((int)x1), gamma );
+
+    if( self->vertex_format == GLYPH_VERTEX_PACKED )
+    {
+        glyph_vertex_packed_t * packed =
+            (glyph_vertex_packed_t *) vertices->items + vstart;
+        for( i = 0; i < 4; ++i )
+        {
+            text_buffer_pack_vertex( &packed[i], &quad[i] );
+        }
+    }
+    else if( self->vertex_format == GLYPH_VERTEX_LAYERED )
+    {
+        memcpy( (glyph_vertex_layered_t *) vertices->items + vstart, quad,
+                sizeof(quad) );
+    }
+    else
+    {
+        // Same layout without the page, which has to be the first one
+        glyph_vertex_t * vertex = (glyph_vertex_t *) vertices->items + vstart;
+        assert( glyph->page == 0 );
+        for( i = 0; i < 4; ++i )
+        {
+            memcpy( &vertex[i].x, &quad[i].x, 5 * sizeof(float) );
+            memcpy( &vertex[i].r, &quad[i].r, 6 * sizeof(float) );
+        }
+    }
+    indices[0] = vstart+0;
+    indices[1] = vstart+1;
+    indices[2] = vstart+2;
+    indices[3] = vstart+0;
+    indices[4] = vstart+2;
+    indices[5] = vstart+3;
+}
+
+// ----------------------------------------------------------------------------
+// text_buffer_add_glyph (internal use only)
+//
+// Adds a glyph with its decorations as a new item of the vertex buffer,
+// writing straight into the vectors storage, and advances the pen. Room
+// must have been made with text_buffer_reserve.
+//
+// black: the special glyph of the font, used for decorations
+// kerning: kerning with the previous glyph
+//
+static void
+text_buffer_add_glyph( text_buffer_t * self, vec2 * pen,
+                       const markup_t * markup,
+                       const texture_glyph_t * glyph,
+                       const texture_glyph_t * black, float kerning )
+{
+    vertex_buffer_t * buffer = self->buffer;
+    texture_font_t * font = markup->font;
+    float gamma = markup->gamma;
+    size_t vstart = buffer->vertices->size;
+    size_t istart = buffer->indices->size;
+    GLuint * indices = (GLuint *) buffer->indices->items + istart;
+    size_t vcount = 0;
+    size_t icount = 0;
+    size_t vstep = 4;
+    size_t istep = 6;
+    float x0, y0, x1, y1;
+
+    if( self->vertex_format == GLYPH_VERTEX_INSTANCED )
+    {
+        assert( buffer->vertices->item_size == sizeof(glyph_instance_t) );
+        vstep = 1;
+        istep = 0;
+    }
+    else if( self->vertex_format == GLYPH_VERTEX_PACKED )
+    {
+        assert( buffer->vertices->item_size ==
+                sizeof(glyph_vertex_packed_t) );
+    }
+    else if( self->vertex_format == GLYPH_VERTEX_LAYERED )
+    {
+        assert( buffer->vertices->item_size ==
+                sizeof(glyph_vertex_layered_t) );
+    }
+    else
+    {
+        assert( buffer->vertices->item_size == sizeof(glyph_vertex_t) );
+    }
+
+    pen->x += kerning;
+    x0 = ( pen->x - kerning );
+    x1 = ( x0 + glyph->advance_x );
+
+    // Background
+    if( markup->background_color.alpha > 0 )
+    {
+        y0 = (float)(int)( pen->y + font->descender );
+        y1 = (float)(int)( y0 + font->height + font->linegap );
+        text_buffer_add_quad( self, vstart + vcount, indices + icount,
+                              x0, y0, x1, y1,
+                              black, &markup->background_color, gamma );
+        vcount += vstep;
+        icount += istep;
+    }
+
+    // Underline
+    if( markup->underline )
+    {
+        y0 = (float)(int)( pen->y + font->underline_position );
+        y1 = (float)(int)( y0 + font->underline_thickness );
+        text_buffer_add_quad( self, vstart + vcount, indices + icount,
+                              x0, y0, x1, y1,
+                              black, &markup->underline_color, gamma );
+        vcount += vstep;
+        icount += istep;
+    }
+
+    // Overline
+    if( markup->overline )
+    {
+        y0 = (float)(int)( pen->y + (int)font->ascender );
+        y1 = (float)(int)( y0 + (int)font->underline_thickness );
+        text_buffer_add_quad( self, vstart + vcount, indices + icount,
+                              x0, y0, x1, y1,
+                              black, &markup->overline_color, gamma );
+        vcount += vstep;
+        icount += istep;
+    }
+
+    /* Strikethrough */
+    if( markup->strikethrough )
+    {
+        y0 = (float)(int)( pen->y + (int)font->ascender*.33f);
+        y1 = (float)(int)( y0 + (int)font->underline_thickness );
+        text_buffer_add_quad( self, vstart + vcount, indices + icount,
+                              x0, y0, x1, y1,
+                              black, &markup->strikethrough_color, gamma );
+        vcount += vstep;
+        icount += istep;
+    }
+
+    // Actual glyph
+    x0 = ( pen->x + glyph->offset_x );
+    y0 = (float)(int)( pen->y + glyph->offset_y );
+    x1 = ( x0 + glyph->width );
+    y1 = (float)(int)( y0 - glyph->height );
+    text_buffer_add_quad( self, vstart + vcount, indices + icount,
+                          x0, y0, x1, y1,
+                          glyph, &markup->foreground_color, gamma );
+    vcount += vstep;
+    icount += istep;
+
+    buffer->vertices->size += vcount;
+    buffer->indices->size += icount;
+    vertex_buffer_push_back_item( buffer, vstart, vcount, istart, icount );
+
+    pen->x += glyph->advance_x * (1.0f + markup->spacing);
+}
+
+// ----------------------------------------------------------------------------
+// text_buffer_line_metrics (internal use only)
+//
+// Grows the ascender and descender of the current line to those of font,
+// moving the line down if needed
+//
+static void
+text_buffer_line_metrics( text_buffer_t * self, vec2 * pen,
+                          const texture_font_t * font )
+{
+    if( font->ascender > self->line_ascender )
+    {
+        float y = pen->y;
+        pen->y -= (font->ascender - self->line_ascender);
+        text_buffer_move_last_line( self, (float)(int)(y-pen->y) );
+        self->line_ascender = font->ascender;
+    }
+    if( font->descender < self->line_descender )
+    {
+        self->line_descender = font->descender;
+    }
+}
+
 // ----------------------------------------------------------------------------
 void
 text_buffer_add_text( text_buffer_t * self,
                       vec2 * pen, markup_t * markup,
                       const char * text, size_t length )
 {
+    texture_font_t * font;
+    texture_glyph_t * glyph;
+    texture_glyph_t * black;
+    uint32_t codepoint;
+    uint32_t previous = 0;
+    int has_previous = 0;
+    float kerning;
     size_t i;
-    const char * prev_character = NULL;
 
     if( markup == NULL )
     {
@@ -195,6 +620,7 @@ text_buffer_add_text( text_buffer_t * self,
         freetype_gl_error( No_Font_In_Markup );
         return;
     }
+    font = markup->font;
 
     if( length == 0 )
     {
@@ -219,11 +645,43 @@ text_buffer_add_text( text_buffer_t * self,
         }
     }
 
-    for( i = 0; length; i += utf8_surrogate_len( text + i ) )
+    // The whole run is laid out with a single font: room for every glyph
+    // is made once and the special glyph is got once
+    text_buffer_reserve( self, markup, length );
+    black = texture_font_get_glyph( font, NULL );
+
+    for( i = 0; length; i += utf8_surrogate_len( text + i ), length-- )
     {
-        text_buffer_add_char( self, pen, markup, text + i, prev_character );
-        prev_character = text + i;
-        length--;
+        codepoint = utf8_to_utf32( text + i );
+        text_buffer_line_metrics( self, pen, font );
+
+        if( codepoint == '\n' )
+        {
+            text_buffer_finish_line( self, pen, true );
+        }
+        else
+        {
+            // Loaded glyphs are found from the decoded codepoint, others
+            // are loaded as text_buffer_add_char does
+            if( !(glyph = texture_font_get_loaded_glyph_gi( font,
+                                                            codepoint )) )
+            {
+                glyph = texture_font_get_glyph( font, text + i );
+            }
+
+            if( glyph )
+            {
+                kerning = 0.0f;
+                if( has_previous && font->kerning )
+                {
+                    kerning = texture_glyph_get_kerning_gi( glyph, previous );
+                }
+                text_buffer_add_glyph( self, pen, markup, glyph, black,
+                                       kerning );
+            }
+        }
+        previous = codepoint;
+        has_previous = 1;
     }
 
     self->last_pen_y = pen->y;
@@ -235,35 +693,12 @@ text_buffer_add_char( text_buffer_t * self,
                       vec2 * pen, markup_t * markup,
                       const char * current, const char * previous )
 {
-    size_t vcount = 0;
-    size_t icount = 0;
-    vertex_buffer_t * buffer = self->buffer;
     texture_font_t * font = markup->font;
-    float gamma = markup->gamma;
-
-    // Maximum number of vertices is 20 (= 5x2 triangles) per glyph:
-    //  - 2 triangles for background
-    //  - 2 triangles for overline
-    //  - 2 triangles for underline
-    //  - 2 triangles for strikethrough
-    //  - 2 triangles for glyph
-    glyph_vertex_t vertices[4*5];
-    GLuint indices[6*5];
     texture_glyph_t *glyph;
     texture_glyph_t *black;
     float kerning = 0.0f;
 
-    if( markup->font->ascender > self->line_ascender )
-    {
-        float y = pen->y;
-        pen->y -= (markup->font->ascender - self->line_ascender);
-        text_buffer_move_last_line( self, (float)(int)(y-pen->y) );
-        self->line_ascender = markup->font->ascender;
-    }
-    if( markup->font->descender < self->line_descender )
-    {
-        self->line_descender = markup->font->descender;
-    }
+    text_buffer_line_metrics( self, pen, font );
 
     if( *current == '\n' )
     {
@@ -283,176 +718,232 @@ text_buffer_add_char( text_buffer_t * self,
     {
         kerning = texture_glyph_get_kerning( glyph, previous );
     }
-    pen->x += kerning;
 
-    // Background
-    if( markup->background_color.alpha > 0 )
+    text_buffer_reserve( self, markup, 1 );
+    text_buffer_add_glyph( self, pen, markup, glyph, black, kerning );
+}
+
+// ----------------------------------------------------------------------------
+// text_buffer_update_bounds (internal use only)
+//
+// Computes the bounds from those of the lines
+//
+static void
+text_buffer_update_bounds( text_buffer_t * self )
+{
+    size_t i, count = vector_size( self->lines );
+    float left, top, right, bottom;
+
+    if( count == 0 )
     {
-        float r = markup->background_color.r;
-        float g = markup->background_color.g;
-        float b = markup->background_color.b;
-        float a = markup->background_color.a;
-        float x0 = ( pen->x -kerning );
-        float y0 = (float)(int)( pen->y + font->descender );
-        float x1 = ( x0 + glyph->advance_x );
-        float y1 = (float)(int)( y0 + font->height + font->linegap );
-        float s0 = black->s0;
-        float t0 = black->t0;
-        float s1 = black->s1;
-        float t1 = black->t1;
-
-        SET_GLYPH_VERTEX(vertices[vcount+0],
-                         (float)(int)x0,y0,0,  s0,t0,  r,g,b,a,  x0-((int)x0), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+1],
-                         (float)(int)x0,y1,0,  s0,t1,  r,g,b,a,  x0-((int)x0), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+2],
-                         (float)(int)x1,y1,0,  s1,t1,  r,g,b,a,  x1-((int)x1), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+3],
-                         (float)(int)x1,y0,0,  s1,t0,  r,g,b,a,  x1-((int)x1), gamma );
-        indices[icount + 0] = vcount+0;
-        indices[icount + 1] = vcount+1;
-        indices[icount + 2] = vcount+2;
-        indices[icount + 3] = vcount+0;
-        indices[icount + 4] = vcount+2;
-        indices[icount + 5] = vcount+3;
-        vcount += 4;
-        icount += 6;
+        self->bounds.width = 0;
+        self->bounds.height = 0;
+        return;
     }
+    for( i = 0; i < count; ++i )
+    {
+        const line_info_t * line =
+            (const line_info_t *) vector_get( self->lines, i );
+        float line_right = line->bounds.left + line->bounds.width;
+        float line_bottom = line->bounds.top - line->bounds.height;
 
-    // Underline
-    if( markup->underline )
+        if( i == 0 || line->bounds.left < left )
+        {
+            left = line->bounds.left;
+        }
+        if( i == 0 || line->bounds.top > top )
+        {
+            top = line->bounds.top;
+        }
+        if( i == 0 || line_right > right )
+        {
+            right = line_right;
+        }
+        if( i == 0 || line_bottom < bottom )
+        {
+            bottom = line_bottom;
+        }
+    }
+    self->bounds.left = left;
+    self->bounds.top = top;
+    self->bounds.width = right - left;
+    self->bounds.height = top - bottom;
+}
+
+// ----------------------------------------------------------------------------
+// text_buffer_splice_lines (internal use only)
+//
+// Replaces lines first to last (excluded) with the lines of scratch, if
+// any, and moves what follows so that the next line starts at next_top
+//
+static void
+text_buffer_splice_lines( text_buffer_t * self, vec2 * pen,
+                          size_t first, size_t last,
+                          text_buffer_t * scratch, float next_top )
+{
+    vertex_buffer_t * buffer = self->buffer;
+    size_t lines_count = vector_size( self->lines );
+    size_t item_first, item_last, i;
+    size_t added_items = 0, added_lines = 0;
+    float dy;
+
+    if( first < lines_count )
+    {
+        line_info_t * line = (line_info_t *) vector_get( self->lines, first );
+        item_first = line->line_start;
+    }
+    else
+    {
+        item_first = self->line_start;
+    }
+    if( last < lines_count )
+    {
+        line_info_t * next = (line_info_t *) vector_get( self->lines, last );
+        item_last = next->line_start;
+        dy = next_top - next->bounds.top;
+    }
+    else
     {
-        float r = markup->underline_color.r;
-        float g = markup->underline_color.g;
-        float b = markup->underline_color.b;
-        float a = markup->underline_color.a;
-        float x0 = ( pen->x - kerning );
-        float y0 = (float)(int)( pen->y + font->underline_position );
-        float x1 = ( x0 + glyph->advance_x );
-        float y1 = (float)(int)( y0 + font->underline_thickness );
-        float s0 = black->s0;
-        float t0 = black->t0;
-        float s1 = black->s1;
-        float t1 = black->t1;
-
-        SET_GLYPH_VERTEX(vertices[vcount+0],
-                         (float)(int)x0,y0,0,  s0,t0,  r,g,b,a,  x0-((int)x0), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+1],
-                         (float)(int)x0,y1,0,  s0,t1,  r,g,b,a,  x0-((int)x0), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+2],
-                         (float)(int)x1,y1,0,  s1,t1,  r,g,b,a,  x1-((int)x1), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+3],
-                         (float)(int)x1,y0,0,  s1,t0,  r,g,b,a,  x1-((int)x1), gamma );
-        indices[icount + 0] = vcount+0;
-        indices[icount + 1] = vcount+1;
-        indices[icount + 2] = vcount+2;
-        indices[icount + 3] = vcount+0;
-        indices[icount + 4] = vcount+2;
-        indices[icount + 5] = vcount+3;
-        vcount += 4;
-        icount += 6;
+        item_last = self->line_start;
+        dy = next_top - ( pen->y + self->line_ascender );
     }
 
-    // Overline
-    if( markup->overline )
+    vertex_buffer_erase_range( buffer, item_first, item_last );
+    if( first < last )
     {
-        float r = markup->overline_color.r;
-        float g = markup->overline_color.g;
-        float b = markup->overline_color.b;
-        float a = markup->overline_color.a;
-        float x0 = ( pen->x -kerning );
-        float y0 = (float)(int)( pen->y + (int)font->ascender );
-        float x1 = ( x0 + glyph->advance_x );
-        float y1 = (float)(int)( y0 + (int)font->underline_thickness );
-        float s0 = black->s0;
-        float t0 = black->t0;
-        float s1 = black->s1;
-        float t1 = black->t1;
-        SET_GLYPH_VERTEX(vertices[vcount+0],
-                         (float)(int)x0,y0,0,  s0,t0,  r,g,b,a,  x0-((int)x0), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+1],
-                         (float)(int)x0,y1,0,  s0,t1,  r,g,b,a,  x0-((int)x0), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+2],
-                         (float)(int)x1,y1,0,  s1,t1,  r,g,b,a,  x1-((int)x1), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+3],
-                         (float)(int)x1,y0,0,  s1,t0,  r,g,b,a,  x1-((int)x1), gamma );
-        indices[icount + 0] = vcount+0;
-        indices[icount + 1] = vcount+1;
-        indices[icount + 2] = vcount+2;
-        indices[icount + 3] = vcount+0;
-        indices[icount + 4] = vcount+2;
-        indices[icount + 5] = vcount+3;
-        vcount += 4;
-        icount += 6;
+        vector_erase_range( self->lines, first, last );
     }
 
-    /* Strikethrough */
-    if( markup->strikethrough )
+    // Append the data of scratch and insert its items and lines in place
+    if( scratch )
+    {
+        vertex_buffer_t * from = scratch->buffer;
+        size_t vbase = vector_size( buffer->vertices );
+        size_t ibase = vector_size( buffer->indices );
+
+        if( from->vertices->size )
+        {
+            vector_push_back_data( buffer->vertices, from->vertices->items,
+                                   from->vertices->size );
+        }
+        if( from->indices->size )
+        {
+            vector_push_back_data( buffer->indices, from->indices->items,
+                                   from->indices->size );
+            for( i = ibase; i < buffer->indices->size; ++i )
+            {
+                ((GLuint *) buffer->indices->items)[i] += vbase;
+            }
+        }
+        added_items = vector_size( from->items );
+        for( i = 0; i < added_items; ++i )
+        {
+            ivec4 * item = (ivec4 *) vector_get( from->items, i );
+            item->vstart += vbase;
+            item->istart += ibase;
+        }
+        vertex_buffer_insert_items( buffer, item_first,
+                                    (const ivec4 *) from->items->items,
+                                    added_items );
+        added_lines = vector_size( scratch->lines );
+        for( i = 0; i < added_lines; ++i )
+        {
+            line_info_t line =
+                *(const line_info_t *) vector_get( scratch->lines, i );
+            line.line_start += item_first;
+            vector_insert( self->lines, first + i, &line );
+        }
+    }
+
+    // Following lines, the one being added and the pen
+    for( i = first + added_lines; i < vector_size( self->lines ); ++i )
     {
-        float r = markup->strikethrough_color.r;
-        float g = markup->strikethrough_color.g;
-        float b = markup->strikethrough_color.b;
-        float a = markup->strikethrough_color.a;
-        float x0  = ( pen->x -kerning );
-        float y0  = (float)(int)( pen->y + (int)font->ascender*.33f);
-        float x1  = ( x0 + glyph->advance_x );
-        float y1  = (float)(int)( y0 + (int)font->underline_thickness );
-        float s0 = black->s0;
-        float t0 = black->t0;
-        float s1 = black->s1;
-        float t1 = black->t1;
-        SET_GLYPH_VERTEX(vertices[vcount+0],
-                         (float)(int)x0,y0,0,  s0,t0,  r,g,b,a,  x0-((int)x0), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+1],
-                         (float)(int)x0,y1,0,  s0,t1,  r,g,b,a,  x0-((int)x0), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+2],
-                         (float)(int)x1,y1,0,  s1,t1,  r,g,b,a,  x1-((int)x1), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+3],
-                         (float)(int)x1,y0,0,  s1,t0,  r,g,b,a,  x1-((int)x1), gamma );
-        indices[icount + 0] = vcount+0;
-        indices[icount + 1] = vcount+1;
-        indices[icount + 2] = vcount+2;
-        indices[icount + 3] = vcount+0;
-        indices[icount + 4] = vcount+2;
-        indices[icount + 5] = vcount+3;
-        vcount += 4;
-        icount += 6;
-    }
-    {
-        // Actual glyph
-        float r = markup->foreground_color.red;
-        float g = markup->foreground_color.green;
-        float b = markup->foreground_color.blue;
-        float a = markup->foreground_color.alpha;
-        float x0 = ( pen->x + glyph->offset_x );
-        float y0 = (float)(int)( pen->y + glyph->offset_y );
-        float x1 = ( x0 + glyph->width );
-        float y1 = (float)(int)( y0 - glyph->height );
-        float s0 = glyph->s0;
-        float t0 = glyph->t0;
-        float s1 = glyph->s1;
-        float t1 = glyph->t1;
-
-        SET_GLYPH_VERTEX(vertices[vcount+0],
-                         (float)(int)x0,y0,0,  s0,t0,  r,g,b,a,  x0-((int)x0), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+1],
-                         (float)(int)x0,y1,0,  s0,t1,  r,g,b,a,  x0-((int)x0), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+2],
-                         (float)(int)x1,y1,0,  s1,t1,  r,g,b,a,  x1-((int)x1), gamma );
-        SET_GLYPH_VERTEX(vertices[vcount+3],
-                         (float)(int)x1,y0,0,  s1,t0,  r,g,b,a,  x1-((int)x1), gamma );
-        indices[icount + 0] = vcount+0;
-        indices[icount + 1] = vcount+1;
-        indices[icount + 2] = vcount+2;
-        indices[icount + 3] = vcount+0;
-        indices[icount + 4] = vcount+2;
-        indices[icount + 5] = vcount+3;
-        vcount += 4;
-        icount += 6;
-
-        vertex_buffer_push_back( buffer, vertices, vcount, indices, icount );
-        pen->x += glyph->advance_x * (1.0f + markup->spacing);
+        line_info_t * line = (line_info_t *) vector_get( self->lines, i );
+        line->line_start = line->line_start - (item_last - item_first)
+                           + added_items;
+        line->bounds.top += dy;
     }
+    self->line_start = self->line_start - (item_last - item_first)
+                       + added_items;
+    // Vertices stay on whole pixels, the pen follows exactly
+    if( roundf( dy ) != 0 )
+    {
+        text_buffer_move_items( self, item_first + added_items,
+                                vector_size( buffer->items ), 0,
+                                roundf( dy ) );
+    }
+    pen->y += dy;
+    self->last_pen_y += dy;
+
+    text_buffer_update_bounds( self );
+}
+
+// ----------------------------------------------------------------------------
+void
+text_buffer_replace_lines( text_buffer_t * self, vec2 * pen,
+                           size_t first, size_t last,
+                           markup_t * markup,
+                           const char * text, size_t length )
+{
+    size_t lines_count = vector_size( self->lines );
+    text_buffer_t * scratch;
+    vec2 start;
+
+    assert( self );
+    assert( first <= last );
+    assert( last <= lines_count );
+
+    if( markup == NULL )
+    {
+        return;
+    }
+    if( !markup->font )
+    {
+        freetype_gl_error( No_Font_In_Markup );
+        return;
+    }
+
+    // The new lines are laid out apart, from where line first starts
+    if( first < lines_count )
+    {
+        line_info_t * line = (line_info_t *) vector_get( self->lines, first );
+        start.x = line->bounds.left;
+        start.y = line->bounds.top;
+    }
+    else
+    {
+        start.x = self->line_left;
+        start.y = pen->y + self->line_ascender;
+    }
+    scratch = text_buffer_new_with_format( self->vertex_format );
+    text_buffer_add_text( scratch, &start, markup, text, length );
+    if( scratch->line_start != vector_size( scratch->buffer->items ) )
+    {
+        text_buffer_finish_line( scratch, &start, true );
+    }
+
+    text_buffer_splice_lines( self, pen, first, last, scratch, start.y );
+    text_buffer_delete( scratch );
+}
+
+// ----------------------------------------------------------------------------
+void
+text_buffer_erase_lines( text_buffer_t * self, vec2 * pen,
+                         size_t first, size_t last )
+{
+    line_info_t * line;
+
+    assert( self );
+    assert( first <= last );
+    assert( last <= vector_size( self->lines ) );
+
+    if( first == last )
+    {
+        return;
+    }
+    line = (line_info_t *) vector_get( self->lines, first );
+    text_buffer_splice_lines( self, pen, first, last, NULL,
+                              line->bounds.top );
 }
 
 // ----------------------------------------------------------------------------
@@ -472,8 +963,7 @@ text_buffer_align( text_buffer_t * self, vec2 * pen,
     }
 
 
-    size_t i, j;
-    int k;
+    size_t i;
     float self_left, self_right, self_center;
     float line_left, line_right, line_center;
     float dx;
@@ -514,16 +1004,7 @@ text_buffer_align( text_buffer_t * self, vec2 * pen,
 
         dx = roundf( dx );
 
-        for( j=line_info->line_start; j < line_end; ++j )
-        {
-            ivec4 *item = (ivec4 *) vector_get( self->buffer->items, j);
-            for( k=item->vstart; k<item->vstart+item->vcount; ++k)
-            {
-                glyph_vertex_t * vertex =
-                                   (glyph_vertex_t *)vector_get( self->buffer->vertices, k );
-                vertex->x += dx;
-            }
-        }
+        text_buffer_move_items( self, line_info->line_start, line_end, dx, 0 );
     }
 }
 
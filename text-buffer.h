@@ -47,6 +47,38 @@ namespace ftgl {
  * @{
  */
 
+/**
+ * Vertex format enumeration
+ */
+typedef enum Glyph_Vertex_Format
+{
+    /**
+     * glyph_vertex_t vertices, 44 bytes, to be drawn with shaders/text.vert
+     * and shaders/text.frag. Only for atlases of a single page.
+     */
+    GLYPH_VERTEX_FLOAT,
+
+    /**
+     * glyph_vertex_packed_t vertices, 16 bytes, to be drawn with
+     * shaders/text-packed.vert and shaders/text.frag
+     */
+    GLYPH_VERTEX_PACKED,
+
+    /**
+     * One glyph_instance_t per quad and no indices, to be drawn with
+     * vertex_buffer_render_instanced( quad, buffer, GL_TRIANGLES ),
+     * shaders/text-instanced.vert and shaders/text.frag
+     */
+    GLYPH_VERTEX_INSTANCED,
+
+    /**
+     * glyph_vertex_layered_t vertices, 48 bytes, for atlases of several
+     * pages uploaded as a texture array, to be drawn with
+     * shaders/text-array.vert and shaders/text-array.frag
+     */
+    GLYPH_VERTEX_LAYERED
+} Glyph_Vertex_Format;
+
 /**
  * Text buffer structure
  */
@@ -56,6 +88,16 @@ typedef struct  text_buffer_t {
      */
     vertex_buffer_t *buffer;
 
+    /**
+     * Format of the vertices
+     */
+    enum Glyph_Vertex_Format vertex_format;
+
+    /**
+     * Unit quad the instances are drawn with (GLYPH_VERTEX_INSTANCED only)
+     */
+    vertex_buffer_t *quad;
+
     /**
      * Base color for text
      */
@@ -167,6 +209,235 @@ typedef struct glyph_vertex_t {
 } glyph_vertex_t;
 
 
+/**
+ * Glyph vertex structure of the layered format, "vertex:3f,tex_coord:3f,
+ * color:4f,ashift:1f,agamma:1f": glyph_vertex_t with the atlas page as a
+ * third texture coordinate.
+ */
+typedef struct glyph_vertex_layered_t {
+    /**
+     * Vertex x coordinates
+     */
+    float x;
+
+    /**
+     * Vertex y coordinates
+     */
+    float y;
+
+    /**
+     * Vertex z coordinates
+     */
+    float z;
+
+    /**
+     * Texture first coordinate
+     */
+    float u;
+
+    /**
+     * Texture second coordinate
+     */
+    float v;
+
+    /**
+     * Texture atlas page (texture array layer)
+     */
+    float layer;
+
+    /**
+     * Color red component
+     */
+    float r;
+
+    /**
+     * Color green component
+     */
+    float g;
+
+    /**
+     * Color blue component
+     */
+    float b;
+
+    /**
+     * Color alpha component
+     */
+    float a;
+
+    /**
+     * Shift along x
+     */
+    float shift;
+
+    /**
+     * Color gamma correction
+     */
+    float gamma;
+
+} glyph_vertex_layered_t;
+
+
+/**
+ * Glyph vertex structure of the packed format, "vertex:2s,tex_coord:2Sn,
+ * color:4Bn,params:4b". Positions are whole pixels and must lie within
+ * -32767..32767, texture coordinates are 16-bit fractions of the atlas size
+ * and colors 8-bit. Shift and gamma, which only need a few bits, share the
+ * params attribute with the atlas page.
+ */
+typedef struct glyph_vertex_packed_t {
+    /**
+     * Vertex x coordinates
+     */
+    GLshort x;
+
+    /**
+     * Vertex y coordinates
+     */
+    GLshort y;
+
+    /**
+     * Texture first coordinate, 65535 being 1
+     */
+    GLushort u;
+
+    /**
+     * Texture second coordinate, 65535 being 1
+     */
+    GLushort v;
+
+    /**
+     * Color red component, 255 being 1
+     */
+    GLubyte r;
+
+    /**
+     * Color green component, 255 being 1
+     */
+    GLubyte g;
+
+    /**
+     * Color blue component, 255 being 1
+     */
+    GLubyte b;
+
+    /**
+     * Color alpha component, 255 being 1
+     */
+    GLubyte a;
+
+    /**
+     * Shift along x, 127 being 1
+     */
+    GLbyte shift;
+
+    /**
+     * Color gamma correction, 32 being 1
+     */
+    GLbyte gamma;
+
+    /**
+     * Texture atlas page (texture array layer)
+     */
+    GLbyte layer;
+
+    /**
+     * Unused, keeps vertices 4-byte aligned
+     */
+    GLbyte padding;
+
+} glyph_vertex_packed_t;
+
+
+/**
+ * Glyph instance structure of the instanced format, "rect:4f,tex_rect:4f,
+ * color:4f,params:4f". Each instance is a quad, drawn from a unit quad whose
+ * corners are mapped to the rectangle and the texture rectangle.
+ */
+typedef struct glyph_instance_t {
+    /**
+     * Left coordinate, in whole pixels
+     */
+    float x;
+
+    /**
+     * Coordinate of the first edge along y (top of glyphs)
+     */
+    float y;
+
+    /**
+     * Width, in whole pixels
+     */
+    float width;
+
+    /**
+     * Signed height from the first edge to the second one
+     */
+    float height;
+
+    /**
+     * Texture first coordinate of the left edge
+     */
+    float s0;
+
+    /**
+     * Texture second coordinate of the first edge
+     */
+    float t0;
+
+    /**
+     * Texture first coordinate of the right edge
+     */
+    float s1;
+
+    /**
+     * Texture second coordinate of the second edge
+     */
+    float t1;
+
+    /**
+     * Color red component
+     */
+    float r;
+
+    /**
+     * Color green component
+     */
+    float g;
+
+    /**
+     * Color blue component
+     */
+    float b;
+
+    /**
+     * Color alpha component
+     */
+    float a;
+
+    /**
+     * Shift along x of the left edge
+     */
+    float shift0;
+
+    /**
+     * Shift along x of the right edge
+     */
+    float shift1;
+
+    /**
+     * Color gamma correction
+     */
+    float gamma;
+
+    /**
+     * Texture atlas page (texture array layer)
+     */
+    float layer;
+
+} glyph_instance_t;
+
+
 /**
  * Line structure
  */
@@ -214,6 +485,18 @@ typedef enum Align
   text_buffer_t *
   text_buffer_new( void );
 
+/**
+ * Creates a new empty text buffer using the given vertex format.
+ *
+ * @param  format  GLYPH_VERTEX_FLOAT, GLYPH_VERTEX_PACKED or
+ *                 GLYPH_VERTEX_INSTANCED
+ *
+ * @return  a new empty text buffer.
+ *
+ */
+  text_buffer_t *
+  text_buffer_new_with_format( enum Glyph_Vertex_Format format );
+
 /**
  * Deletes texture buffer and its associated vertex buffer.
  *
@@ -264,6 +547,42 @@ typedef enum Align
                         vec2 * pen, markup_t * markup,
                         const char * current, const char * previous );
 
+ /**
+  * Replace some lines of text with other text, in place. The new text is
+  * laid out where the first replaced line starts and may span any number
+  * of lines, a last line without newline is finished. Following lines,
+  * including the line being added if any, are moved up or down by the
+  * height difference and the bounds are updated, without rebuilding the
+  * rest of the buffer.
+  *
+  * @param self   a text buffer
+  * @param pen    pen used in last call, moved with the following lines
+  * @param first  index (in lines) of the first line to be replaced
+  * @param last   index (in lines) after the last line to be replaced,
+  *               first for a pure insertion before line first
+  * @param markup markup to be used to add text
+  * @param text   text to be added
+  * @param length length of text to be added, 0 for the whole string
+  */
+  void
+  text_buffer_replace_lines( text_buffer_t * self, vec2 * pen,
+                             size_t first, size_t last,
+                             markup_t * markup,
+                             const char * text, size_t length );
+
+ /**
+  * Erase some lines of text in place, following lines being moved up. See
+  * text_buffer_replace_lines.
+  *
+  * @param self   a text buffer
+  * @param pen    pen used in last call, moved with the following lines
+  * @param first  index (in lines) of the first line to be erased
+  * @param last   index (in lines) after the last line to be erased
+  */
+  void
+  text_buffer_erase_lines( text_buffer_t * self, vec2 * pen,
+                           size_t first, size_t last );
+
  /**
   * Align all the lines of text already added to the buffer
   * This alignment will be relative to the overall bounds of the
@@ -8,10 +8,262 @@
 #include <string.h>
 #include <assert.h>
 #include <limits.h>
+#include <stdint.h>
 #include "texture-atlas.h"
 #include "texture-font.h"
 #include "ftgl-utils.h"
 
+// Height of the columns where nothing can be allocated: the one pixel border
+// and the columns past the width of the atlas, up to the skyline size
+#define SKYLINE_FULL INT_MAX
+
+// Past this number of dirty regions, they are all merged into one
+#define DIRTY_MAX 64
+
+
+// ------------------------------------------- texture_atlas_skyline_update ---
+/* Update the nodes above columns [first,last) of a page after their height
+ * changed */
+static void
+texture_atlas_skyline_update( texture_atlas_t * self,
+                              const size_t page,
+                              const size_t first,
+                              const size_t last )
+{
+    skyline_node_t *tree = self->skyline + 2 * self->skyline_size * page;
+    size_t lo = (self->skyline_size + first) >> 1;
+    size_t hi = (self->skyline_size + last - 1) >> 1;
+    size_t i;
+
+    if( first >= last )
+    {
+        return;
+    }
+    for( ; lo > 0; lo >>= 1, hi >>= 1 )
+    {
+        for( i = lo; i <= hi; ++i )
+        {
+            tree[i].min = tree[2*i].min < tree[2*i+1].min ? tree[2*i].min : tree[2*i+1].min;
+            tree[i].max = tree[2*i].max > tree[2*i+1].max ? tree[2*i].max : tree[2*i+1].max;
+        }
+    }
+}
+
+
+// ---------------------------------------------- texture_atlas_skyline_set ---
+/* Set the height of columns [first,last) of a page */
+static void
+texture_atlas_skyline_set( texture_atlas_t * self,
+                           const size_t page,
+                           const size_t first,
+                           const size_t last,
+                           const int height )
+{
+    skyline_node_t *column = self->skyline + 2 * self->skyline_size * page +
+        self->skyline_size;
+    size_t x;
+
+    for( x = first; x < last; ++x )
+    {
+        column[x].min = column[x].max = height;
+    }
+    texture_atlas_skyline_update( self, page, first, last );
+}
+
+
+// ---------------------------------------------- texture_atlas_skyline_max ---
+/* Height of the highest column of [first,last) of a page */
+static int
+texture_atlas_skyline_max( const texture_atlas_t * self,
+                           const size_t page,
+                           const size_t first,
+                           const size_t last )
+{
+    const skyline_node_t *tree = self->skyline + 2 * self->skyline_size * page;
+    size_t lo = self->skyline_size + first;
+    size_t hi = self->skyline_size + last;
+    int height = 0;
+
+    for( ; lo < hi; lo >>= 1, hi >>= 1 )
+    {
+        if( lo & 1 )
+        {
+            height = tree[lo].max > height ? tree[lo].max : height;
+            lo++;
+        }
+        if( hi & 1 )
+        {
+            hi--;
+            height = tree[hi].max > height ? tree[hi].max : height;
+        }
+    }
+    return height;
+}
+
+
+// --------------------------------------------- texture_atlas_skyline_find ---
+/* First column of a page from column first on whose height is not within
+ * [low,high], SIZE_MAX if none */
+static size_t
+texture_atlas_skyline_find( const texture_atlas_t * self,
+                            const size_t page,
+                            const size_t first,
+                            const int low,
+                            const int high )
+{
+    const skyline_node_t *tree = self->skyline + 2 * self->skyline_size * page;
+    size_t i = self->skyline_size + first;
+
+    if( first >= self->skyline_size )
+    {
+        return SIZE_MAX;
+    }
+    // Climb up to the first span on the right that holds such a column...
+    if( tree[i].min >= low && tree[i].max <= high )
+    {
+        do
+        {
+            while( i & 1 )
+            {
+                i >>= 1;
+            }
+            if( i == 0 )
+            {
+                return SIZE_MAX;
+            }
+            i++;
+        }
+        while( tree[i].min >= low && tree[i].max <= high );
+    }
+    // ...and down to its leftmost one
+    while( i < self->skyline_size )
+    {
+        i *= 2;
+        if( tree[i].min >= low && tree[i].max <= high )
+        {
+            i++;
+        }
+    }
+    return i - self->skyline_size;
+}
+
+
+// -------------------------------------------- texture_atlas_skyline_clear ---
+/* Make every column of a page empty */
+static void
+texture_atlas_skyline_clear( texture_atlas_t * self,
+                             const size_t page )
+{
+    // We want a one pixel border around the whole atlas to avoid any artefact when
+    // sampling texture
+    texture_atlas_skyline_set( self, page, 0, self->skyline_size, SKYLINE_FULL );
+    texture_atlas_skyline_set( self, page, 1, self->width-1, 1 );
+}
+
+
+// -------------------------------------------- texture_atlas_skyline_reset ---
+/* Make the skyline of every page cover the atlas width, with every column
+ * empty */
+static int
+texture_atlas_skyline_reset( texture_atlas_t * self )
+{
+    skyline_node_t *skyline;
+    size_t size = 1, page;
+
+    while( size < self->width )
+    {
+        size *= 2;
+    }
+    skyline = (skyline_node_t *)
+        realloc( self->skyline, self->pages * 2 * size * sizeof(skyline_node_t) );
+    if( skyline == NULL )
+    {
+        freetype_gl_error( Out_Of_Memory );
+        return 0;
+    }
+    self->skyline = skyline;
+    self->skyline_size = size;
+
+    for( page = 0; page < self->pages; ++page )
+    {
+        texture_atlas_skyline_clear( self, page );
+    }
+    return 1;
+}
+
+
+// ------------------------------------------------ texture_atlas_dirty_all ---
+/* Record that the whole atlas has to be uploaded again */
+static void
+texture_atlas_dirty_all( texture_atlas_t * self )
+{
+    ivec4 region = {{0, 0, self->width, self->height * self->pages}};
+
+    vector_clear( self->dirty );
+    vector_push_back( self->dirty, &region );
+}
+
+// ------------------------------------------------ texture_atlas_add_dirty ---
+/* Record that a region of a page of the atlas data has been modified */
+static void
+texture_atlas_add_dirty( texture_atlas_t * self,
+                         const size_t page,
+                         const size_t x,
+                         const size_t y,
+                         const size_t width,
+                         const size_t height )
+{
+    ivec4 region = {{x, page * self->height + y, width, height}};
+    const ivec4 *dirty;
+    int x0, y0, x1, y1;
+    size_t i;
+
+    if( width == 0 || height == 0 )
+    {
+        return;
+    }
+    if( self->dirty->size )
+    {
+        dirty = (const ivec4 *) vector_get( self->dirty, 0 );
+        if( (size_t)dirty->height == self->height * self->pages )
+        {
+            return;
+        }
+    }
+
+    // Merging may make the region overlap ones already looked at, so start
+    // over after each merge. Regions of different pages are never merged.
+    i = 0;
+    while( i < self->dirty->size )
+    {
+        dirty = (const ivec4 *) vector_get( self->dirty, i );
+        x0 = dirty->x < region.x ? dirty->x : region.x;
+        y0 = dirty->y < region.y ? dirty->y : region.y;
+        x1 = dirty->x + dirty->width > region.x + region.width ?
+            dirty->x + dirty->width : region.x + region.width;
+        y1 = dirty->y + dirty->height > region.y + region.height ?
+            dirty->y + dirty->height : region.y + region.height;
+        if( dirty->y / self->height == page &&
+            ( self->dirty->size >= DIRTY_MAX ||
+              (size_t)(x1 - x0) * (y1 - y0) <=
+              (size_t)dirty->width * dirty->height +
+              (size_t)region.width * region.height ) )
+        {
+            region.x = x0;
+            region.y = y0;
+            region.width = x1 - x0;
+            region.height = y1 - y0;
+            vector_erase( self->dirty, i );
+            i = 0;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    vector_push_back( self->dirty, &region );
+}
+
 // -------------------------------------------------- texture_atlas_special ---
 
 void texture_atlas_special ( texture_atlas_t * self )
@@ -44,10 +296,6 @@ texture_atlas_new( const size_t width,
 {
     texture_atlas_t *self = (texture_atlas_t *) malloc( sizeof(texture_atlas_t) );
 
-    // We want a one pixel border around the whole atlas to avoid any artefact when
-    // sampling texture
-    ivec3 node = {{1,1,width-2}};
-
     assert( (depth == 1) || (depth == 3) || (depth == 4) );
     if( self == NULL)
     {
@@ -55,23 +303,29 @@ texture_atlas_new( const size_t width,
         return NULL;
         /* exit( EXIT_FAILURE ); */ /* Never exit from a library */
     }
-    self->nodes = vector_new( sizeof(ivec3) );
+    self->skyline = NULL;
+    self->skyline_size = 0;
+    self->pages = 1;
+    self->max_pages = 1;
+    self->freeable = 0;
     self->used = 0;
     self->width = width;
     self->height = height;
     self->depth = depth;
     self->id = 0;
     self->modified = 1;
+    self->dirty = vector_new( sizeof(ivec4) );
+    self->freed = vector_new( sizeof(ivec4) );
 
-    vector_push_back( self->nodes, &node );
     self->data = (unsigned char *)
         calloc( width*height*depth, sizeof(unsigned char) );
 
-    if( self->data == NULL)
+    if( self->data == NULL || !texture_atlas_skyline_reset( self ) )
     {
         freetype_gl_error( Out_Of_Memory );
         return NULL;
     }
+    texture_atlas_dirty_all( self );
 
     texture_atlas_special( self );
     
@@ -84,7 +338,9 @@ void
 texture_atlas_delete( texture_atlas_t *self )
 {
     assert( self );
-    vector_delete( self->nodes );
+    free( self->skyline );
+    vector_delete( self->dirty );
+    vector_delete( self->freed );
     texture_glyph_delete( self->special );
     if( self->data )
     {
@@ -103,12 +359,29 @@ texture_atlas_set_region( texture_atlas_t * self,
                           const size_t height,
                           const unsigned char * data,
                           const size_t stride )
+{
+    texture_atlas_set_page_region( self, 0, x, y, width, height, data, stride );
+}
+
+
+// ------------------------------------------ texture_atlas_set_page_region ---
+void
+texture_atlas_set_page_region( texture_atlas_t * self,
+                               const size_t page,
+                               const size_t x,
+                               const size_t y,
+                               const size_t width,
+                               const size_t height,
+                               const unsigned char * data,
+                               const size_t stride )
 {
     size_t i;
     size_t depth;
     size_t charsize;
+    unsigned char * page_data;
 
     assert( self );
+    assert( page < self->pages );
     assert( x > 0);
     assert( y > 0);
     assert( x < (self->width-1));
@@ -122,115 +395,315 @@ texture_atlas_set_region( texture_atlas_t * self,
 
     depth = self->depth;
     charsize = sizeof(char);
+    page_data = self->data + page * self->width * self->height * charsize * depth;
     for( i=0; i<height; ++i )
     {
-        memcpy( self->data+((y+i)*self->width + x ) * charsize * depth,
+        memcpy( page_data+((y+i)*self->width + x ) * charsize * depth,
                 data + (i*stride) * charsize, width * charsize * depth  );
     }
+    texture_atlas_add_dirty( self, page, x, y, width, height );
     self->modified = 1;
 }
 
 
+// ------------------------------------------------ texture_atlas_get_dirty ---
+const ivec4 *
+texture_atlas_get_dirty( const texture_atlas_t * self,
+                         size_t * count )
+{
+    assert( self );
+    assert( count );
+
+    *count = self->dirty->size;
+    return (const ivec4 *) self->dirty->items;
+}
+
+
+// ---------------------------------------------- texture_atlas_clear_dirty ---
+void
+texture_atlas_clear_dirty( texture_atlas_t * self )
+{
+    assert( self );
+
+    vector_clear( self->dirty );
+}
+
+
 // ------------------------------------------------------ texture_atlas_fit ---
-int
+/* Lowest height at which a region can be placed from column x of a page, -1
+ * if it does not fit */
+static int
 texture_atlas_fit( texture_atlas_t * self,
-                   const size_t index,
+                   const size_t page,
+                   const size_t x,
                    const size_t width,
                    const size_t height )
 {
-    ivec3 *node;
-    int x, y, width_left;
-    size_t i;
+    int y;
 
     assert( self );
 
-    node = (ivec3 *) (vector_get( self->nodes, index ));
-    x = node->x;
-    y = node->y;
-    width_left = width;
-    i = index;
-
     if ( (x + width) > (self->width-1) )
     {
 	return -1;
     }
-    y = node->y;
-    while( width_left > 0 )
-    {
-	node = (ivec3 *) (vector_get( self->nodes, i ));
-	if( node->y > y )
-	{
-	    y = node->y;
-	}
-	if( (y + height) > (self->height-1) )
-	{
-	    return -1;
-	}
-	width_left -= node->z;
-	++i;
+    y = texture_atlas_skyline_max( self, page, x, x + (width ? width : 1) );
+    if( ((size_t)y + height) > (self->height-1) )
+    {
+        return -1;
     }
     return y;
 }
 
 
-// ---------------------------------------------------- texture_atlas_merge ---
-void
-texture_atlas_merge( texture_atlas_t * self )
+// ------------------------------------------------- texture_atlas_try_node ---
+/* Fit a region on the skyline node of a page that starts at column x, and
+ * keep it in best if it is lower than the best fit so far, or as low but on a
+ * narrower node (best_width is the width of the node of the best fit). Ties go
+ * to the leftmost node. Return the column where the next node starts. */
+static size_t
+texture_atlas_try_node( texture_atlas_t * self,
+                        const size_t page,
+                        const size_t x,
+                        const size_t width,
+                        const size_t height,
+                        ivec4 * best,
+                        size_t * best_width )
 {
-    ivec3 *node, *next;
-    size_t i;
+    int y, node_height;
+    size_t next;
 
-    assert( self );
+    node_height = self->skyline[2 * self->skyline_size * page +
+                                self->skyline_size + x].max;
+    next = texture_atlas_skyline_find( self, page, x, node_height, node_height );
+    y = texture_atlas_fit( self, page, x, width, height );
+    if( y >= 0 &&
+        ( *best_width == SIZE_MAX || y < best->y ||
+          (y == best->y && (next - x < *best_width ||
+                            (next - x == *best_width && (int)x < best->x))) ) )
+    {
+        best->x = x;
+        best->y = y;
+        *best_width = next - x;
+    }
+    return next;
+}
 
-    for( i=0; i< self->nodes->size-1; ++i )
+
+// ----------------------------------------------- texture_atlas_clip_freed ---
+/* Remove a newly allocated region of a page from the freed regions it
+ * overlaps. Their parts on its sides are kept, as well as their parts below
+ * it over the columns whose height has not been lowered down to them yet;
+ * elsewhere the space left below it is recorded by texture_atlas_add_wasted,
+ * if at all. */
+static void
+texture_atlas_clip_freed( texture_atlas_t * self,
+                          const size_t page,
+                          const ivec4 region )
+{
+    const skyline_node_t *column = self->skyline +
+        2 * self->skyline_size * page + self->skyline_size;
+    const ivec4 *freed;
+    ivec4 hole, piece;
+    int y = page * self->height + region.y;
+    size_t i, x, last;
+
+    for( i = self->freed->size; i-- > 0; )
     {
-        node = (ivec3 *) (vector_get( self->nodes, i ));
-        next = (ivec3 *) (vector_get( self->nodes, i+1 ));
-        if( node->y == next->y )
-	{
-            node->z += next->z;
-            vector_erase( self->nodes, i+1 );
-            --i;
+        freed = (const ivec4 *) vector_get( self->freed, i );
+        if( freed->x >= region.x + region.width ||
+            region.x >= freed->x + freed->width ||
+            freed->y >= y + region.height ||
+            y >= freed->y + freed->height )
+        {
+            continue;
+        }
+        hole = *freed;
+        vector_erase( self->freed, i );
+        if( hole.x < region.x )
+        {
+            piece = hole;
+            piece.width = region.x - hole.x;
+            vector_push_back( self->freed, &piece );
+        }
+        if( region.x + region.width < hole.x + hole.width )
+        {
+            piece = hole;
+            piece.x = region.x + region.width;
+            piece.width = hole.x + hole.width - piece.x;
+            vector_push_back( self->freed, &piece );
+        }
+        x = hole.x > region.x ? hole.x : region.x;
+        last = hole.x + hole.width < region.x + region.width ?
+            hole.x + hole.width : region.x + region.width;
+        while( x < last )
+        {
+            if( column[x].max <= hole.y % (int)self->height )
+            {
+                ++x;
+                continue;
+            }
+            piece = hole;
+            piece.x = x;
+            while( x < last && column[x].max > hole.y % (int)self->height )
+            {
+                ++x;
+            }
+            piece.width = x - piece.x;
+            if( y < hole.y + hole.height )
+            {
+                piece.height = y - hole.y;
+            }
+            vector_push_back( self->freed, &piece );
         }
     }
 }
 
 
-// ----------------------------------------------- texture_atlas_get_region ---
-ivec4
-texture_atlas_get_region( texture_atlas_t * self,
-                          const size_t width,
-                          const size_t height )
+// ----------------------------------------------- texture_atlas_add_wasted ---
+/* Record the space a newly allocated region of a page leaves above the
+ * columns lower than its bottom as freed, so that it is given back to the
+ * skyline along with the region */
+static void
+texture_atlas_add_wasted( texture_atlas_t * self,
+                          const size_t page,
+                          const ivec4 region )
 {
-    int y, best_index;
-    size_t best_height, best_width;
-    ivec3 *node, *prev;
-    ivec4 region = {{0,0,width,height}};
-    size_t i;
+    const skyline_node_t *column = self->skyline +
+        2 * self->skyline_size * page + self->skyline_size;
+    size_t x = region.x, last = region.x + region.width, first;
+    ivec4 wasted;
+    int height;
+
+    while( x < last )
+    {
+        height = column[x].max;
+        if( height >= region.y )
+        {
+            ++x;
+            continue;
+        }
+        first = x;
+        while( x < last && column[x].max == height )
+        {
+            ++x;
+        }
+        wasted.x = first;
+        wasted.y = page * self->height + height;
+        wasted.width = x - first;
+        wasted.height = region.y - height;
+        vector_push_back( self->freed, &wasted );
+    }
+}
+
+
+// ---------------------------------------------- texture_atlas_lower_freed ---
+/* Give the space of the freed regions of a page back to the skyline, for the
+ * columns where nothing lies above them (freed regions may overlap, so a
+ * column may already have been lowered within one). Lowering a column may
+ * uncover another freed region right below, so go on until nothing changes. */
+static void
+texture_atlas_lower_freed( texture_atlas_t * self,
+                           const size_t page )
+{
+    const skyline_node_t *column;
+    const ivec4 *freed;
+    size_t i, x, first, last;
+    int y, top, lowered;
+
+    do
+    {
+        lowered = 0;
+        for( i = self->freed->size; i-- > 0; )
+        {
+            freed = (const ivec4 *) vector_get( self->freed, i );
+            if( freed->y / self->height != page )
+            {
+                continue;
+            }
+            y = freed->y % self->height;
+            top = y + freed->height;
+            last = freed->x + freed->width;
+            column = self->skyline + 2 * self->skyline_size * page +
+                self->skyline_size;
+            for( x = freed->x; x < last; )
+            {
+                if( column[x].max <= y || column[x].max > top )
+                {
+                    ++x;
+                    continue;
+                }
+                first = x;
+                while( x < last && column[x].max > y && column[x].max <= top )
+                {
+                    ++x;
+                }
+                texture_atlas_skyline_set( self, page, first, x, y );
+                lowered = 1;
+            }
+            if( texture_atlas_skyline_max( self, page, freed->x, last ) <= y )
+            {
+                vector_erase( self->freed, i );
+            }
+        }
+    } while( lowered );
+}
+
+
+// ---------------------------------------------- texture_atlas_find_region ---
+/* Allocate a region in a page */
+static ivec4
+texture_atlas_find_region( texture_atlas_t * self,
+                           const size_t page,
+                           const size_t width,
+                           const size_t height )
+{
+    int bound;
+    size_t best_width = SIZE_MAX;
+    size_t x, above;
+    ivec4 region = {{-1,-1,width,height}};
 
     assert( self );
 
-    best_height = UINT_MAX;
-    best_index  = -1;
-    best_width = UINT_MAX;
-    for( i=0; i<self->nodes->size; ++i )
-    {
-        y = texture_atlas_fit( self, i, width, height );
-        if( y >= 0 )
-	{
-            node = (ivec3 *) vector_get( self->nodes, i );
-            if( ( (y + height) < best_height ) ||
-                ( ((y + height) == best_height) && (node->z > 0 && (size_t)node->z < best_width)) ) {
-                best_height = y + height;
-                best_index = i;
-                best_width = node->z;
-                region.x = node->x;
-                region.y = y;
+    if( height <= self->height-2 )
+    {
+        /* Seed the search with the lowest node, then look at every node a
+         * region could be placed on. Nodes higher than the best fit so far
+         * cannot give a lower fit and are skipped altogether, only nodes as
+         * high as it may still win with a lower width. The same goes for
+         * nodes followed too closely by a higher column. */
+        bound = self->height-1 - height;
+        x = texture_atlas_skyline_find( self, page, 1,
+                                        self->skyline[2 * self->skyline_size * page + 1].min+1,
+                                        SKYLINE_FULL );
+        if( (x + width) <= (self->width-1) )
+        {
+            texture_atlas_try_node( self, page, x, width, height, &region, &best_width );
+            if( best_width != SIZE_MAX )
+            {
+                bound = region.y;
+            }
+        }
+
+        x = 1;
+        while( (x = texture_atlas_skyline_find( self, page, x, bound+1, SKYLINE_FULL )) != SIZE_MAX &&
+               (x + width) <= (self->width-1) )
+        {
+            above = texture_atlas_skyline_find( self, page, x, INT_MIN, bound );
+            if( above < x + width )
+            {
+                x = above;
+                continue;
+            }
+            x = texture_atlas_try_node( self, page, x, width, height, &region, &best_width );
+            if( best_width != SIZE_MAX )
+            {
+                bound = region.y;
             }
         }
     }
-    
-    if( best_index == -1 )
+
+    if( best_width == SIZE_MAX )
     {
         region.x = -1;
         region.y = -1;
@@ -239,66 +712,295 @@ texture_atlas_get_region( texture_atlas_t * self,
         return region;
     }
 
-    node = (ivec3 *) malloc( sizeof(ivec3) );
-    if( node == NULL) {
+    texture_atlas_clip_freed( self, page, region );
+    if( self->freeable )
+    {
+        texture_atlas_add_wasted( self, page, region );
+    }
+    texture_atlas_skyline_set( self, page, region.x, region.x + width, region.y + height );
+    self->used += width * height;
+    self->modified = 1;
+    return region;
+}
+
+
+// ------------------------------------------------- texture_atlas_add_page ---
+/* Add an empty page at the end of the atlas */
+static int
+texture_atlas_add_page( texture_atlas_t * self )
+{
+    size_t page_size = self->width * self->height * self->depth;
+    size_t tree_size = 2 * self->skyline_size;
+    unsigned char *data;
+    skyline_node_t *skyline;
+
+    data = (unsigned char *)
+        realloc( self->data, (self->pages + 1) * page_size );
+    if( data == NULL )
+    {
         freetype_gl_error( Out_Of_Memory );
-        return (ivec4){{-1,-1,0,0}};
-        /* exit( EXIT_FAILURE ); */ /* Never exit from a library */
+        return 0;
     }
-    node->x = region.x;
-    node->y = region.y + height;
-    node->z = width;
-    vector_insert( self->nodes, best_index, node );
-    free( node );
-
-    for( i = best_index+1; i < self->nodes->size; ++i )
-    {
-        node = (ivec3 *) vector_get( self->nodes, i );
-        prev = (ivec3 *) vector_get( self->nodes, i-1 );
-
-        if (node->x < (prev->x + prev->z) )
-	{
-            int shrink = prev->x + prev->z - node->x;
-            node->x += shrink;
-            node->z -= shrink;
-            if (node->z <= 0) {
-                vector_erase( self->nodes, i );
-                --i;
-            }
-            else
-            {
-                break;
-            }
-        }
-        else
+    self->data = data;
+    memset( self->data + self->pages * page_size, 0, page_size );
+
+    skyline = (skyline_node_t *)
+        realloc( self->skyline, (self->pages + 1) * tree_size * sizeof(skyline_node_t) );
+    if( skyline == NULL )
+    {
+        freetype_gl_error( Out_Of_Memory );
+        return 0;
+    }
+    self->skyline = skyline;
+
+    texture_atlas_skyline_clear( self, self->pages++ );
+    // The texture has one more layer, it has to be uploaded whole
+    texture_atlas_dirty_all( self );
+    self->modified = 1;
+    return 1;
+}
+
+
+// ----------------------------------------------- texture_atlas_get_region ---
+ivec4
+texture_atlas_get_region( texture_atlas_t * self,
+                          const size_t width,
+                          const size_t height )
+{
+    assert( self );
+
+    return texture_atlas_find_region( self, 0, width, height );
+}
+
+
+// ------------------------------------------ texture_atlas_get_page_region ---
+ivec4
+texture_atlas_get_page_region( texture_atlas_t * self,
+                               const size_t width,
+                               const size_t height,
+                               size_t * page )
+{
+    ivec4 region = {{-1,-1,0,0}};
+    size_t i;
+
+    assert( self );
+    assert( page );
+
+    for( i = 0; i < self->pages; ++i )
+    {
+        region = texture_atlas_find_region( self, i, width, height );
+        if( region.x >= 0 )
         {
-            break;
+            *page = i;
+            return region;
         }
     }
-    texture_atlas_merge( self );
-    self->used += width * height;
-    self->modified = 1;    
+    if( self->pages < self->max_pages && texture_atlas_add_page( self ) )
+    {
+        *page = self->pages - 1;
+        region = texture_atlas_find_region( self, *page, width, height );
+    }
     return region;
 }
 
 
+// ----------------------------------------- texture_atlas_free_page_region ---
+void
+texture_atlas_free_page_region( texture_atlas_t * self,
+                                const size_t page,
+                                const size_t x,
+                                const size_t y,
+                                const size_t width,
+                                const size_t height )
+{
+    ivec4 region = {{x, page * self->height + y, width, height}};
+
+    assert( self );
+    assert( page < self->pages );
+    assert( x > 0 );
+    assert( y > 0 );
+    assert( x < (self->width-1));
+    assert( (x + width) <= (self->width-1));
+    assert( y < (self->height-1));
+    assert( (y + height) <= (self->height-1));
+
+    if( width == 0 || height == 0 )
+    {
+        return;
+    }
+    self->used -= width * height;
+    vector_push_back( self->freed, &region );
+    texture_atlas_lower_freed( self, page );
+}
+
+
 // ---------------------------------------------------- texture_atlas_clear ---
 void
 texture_atlas_clear( texture_atlas_t * self )
 {
-    ivec3 node = {{1,1,1}};
-
     assert( self );
     assert( self->data );
 
-    vector_clear( self->nodes );
+    texture_atlas_skyline_reset( self );
     self->used = 0;
-    // We want a one pixel border around the whole atlas to avoid any artefact when
-    // sampling texture
-    node.z = self->width-2;
+    memset( self->data, 0, self->width*self->height*self->depth*self->pages );
+    vector_clear( self->freed );
+    texture_atlas_dirty_all( self );
+    self->modified = 1;
+}
+
+// ------------------------------------------------- texture_atlas_is_empty ---
+int
+texture_atlas_is_empty( const texture_atlas_t * self )
+{
+    assert( self );
+
+    // The special glyph takes a 5x5 region, see texture_atlas_special
+    return self->used <= 5 * 5;
+}
+
+// ---------------------------------------------------- texture_atlas_write ---
+int
+texture_atlas_write( const texture_atlas_t * self,
+                     FILE * file )
+{
+    uint32_t header[7];
+    uint64_t used = self->used;
+    size_t nodes = self->pages * 2 * self->skyline_size;
+    size_t bytes = self->pages * self->width * self->height * self->depth;
+
+    assert( self );
+    header[0] = self->width;
+    header[1] = self->height;
+    header[2] = self->depth;
+    header[3] = self->pages;
+    header[4] = self->skyline_size;
+    header[5] = self->freeable;
+    header[6] = self->freed->size;
 
-    vector_push_back( self->nodes, &node );
-    memset( self->data, 0, self->width*self->height*self->depth );
+    return fwrite( header, sizeof(header), 1, file ) == 1 &&
+           fwrite( &used, sizeof(used), 1, file ) == 1 &&
+           fwrite( self->skyline, sizeof(skyline_node_t), nodes, file ) == nodes &&
+           fwrite( self->freed->items, sizeof(ivec4), header[6], file ) == header[6] &&
+           fwrite( self->data, 1, bytes, file ) == bytes;
+}
+
+// ----------------------------------------------- texture_atlas_read_check ---
+/* Whether the skyline and freed regions of pages read from a file fit the
+ * atlas. The inner nodes of the skyline trees are rebuilt from the columns
+ * rather than trusted. */
+static int
+texture_atlas_read_check( const texture_atlas_t * self,
+                          const size_t pages,
+                          skyline_node_t * skyline,
+                          const vector_t * freed )
+{
+    skyline_node_t *tree, *column;
+    const ivec4 *region;
+    size_t page, i;
+
+    for( page = 0; page < pages; ++page )
+    {
+        // Columns on the border are full, the others within the page
+        tree = skyline + 2 * self->skyline_size * page;
+        column = tree + self->skyline_size;
+        for( i = 0; i < self->skyline_size; ++i )
+        {
+            if( column[i].min != column[i].max )
+                return 0;
+            if( i == 0 || i >= self->width - 1 )
+            {
+                if( column[i].max != SKYLINE_FULL )
+                    return 0;
+            }
+            else if( column[i].max < 1 ||
+                     (size_t) column[i].max > self->height - 1 )
+                return 0;
+        }
+        for( i = self->skyline_size; i-- > 1; )
+        {
+            tree[i].min = tree[2*i].min < tree[2*i+1].min ? tree[2*i].min : tree[2*i+1].min;
+            tree[i].max = tree[2*i].max > tree[2*i+1].max ? tree[2*i].max : tree[2*i+1].max;
+        }
+    }
+    for( i = 0; i < freed->size; ++i )
+    {
+        region = (const ivec4 *) vector_get( freed, i );
+        if( region->x < 1 || region->y < 0 ||
+            region->width < 0 || region->height < 0 ||
+            (size_t) region->x + region->width > self->width - 1 ||
+            (size_t) region->y / self->height >= pages ||
+            (size_t) region->y % self->height < 1 ||
+            (size_t) region->y % self->height + region->height > self->height - 1 )
+            return 0;
+    }
+    return 1;
+}
+
+// ----------------------------------------------------- texture_atlas_read ---
+int
+texture_atlas_read( texture_atlas_t * self,
+                    FILE * file )
+{
+    uint32_t header[7];
+    uint64_t used;
+    size_t nodes, bytes;
+    skyline_node_t *skyline = NULL;
+    vector_t *freed = NULL;
+    unsigned char *data = NULL;
+
+    assert( self );
+    if( !texture_atlas_is_empty( self ) )
+    {
+        freetype_gl_warning( Texture_Atlas_Not_Empty );
+        return 0;
+    }
+    if( fread( header, sizeof(header), 1, file ) != 1 ||
+        fread( &used, sizeof(used), 1, file ) != 1 ||
+        header[0] != self->width || header[1] != self->height ||
+        header[2] != self->depth || header[4] != self->skyline_size ||
+        header[3] < 1 || header[3] > self->max_pages ||
+        used > (uint64_t) header[3] * self->width * self->height ||
+        header[6] > (uint64_t) header[3] * self->width * self->height )
+        return 0;
+
+    // Read everything aside, so that the atlas stays as it is on failure
+    nodes = header[3] * 2 * self->skyline_size;
+    bytes = header[3] * self->width * self->height * self->depth;
+    skyline = (skyline_node_t *) malloc( nodes * sizeof(skyline_node_t) );
+    freed = vector_new( sizeof(ivec4) );
+    data = (unsigned char *) malloc( bytes );
+    if( !skyline || !freed || !data )
+    {
+        freetype_gl_error( Out_Of_Memory );
+        goto cleanup;
+    }
+    vector_resize( freed, header[6] );
+    if( fread( skyline, sizeof(skyline_node_t), nodes, file ) != nodes ||
+        fread( freed->items, sizeof(ivec4), header[6], file ) != header[6] ||
+        fread( data, 1, bytes, file ) != bytes ||
+        !texture_atlas_read_check( self, header[3], skyline, freed ) )
+        goto cleanup;
+
+    free( self->skyline );
+    free( self->data );
+    vector_delete( self->freed );
+    self->skyline = skyline;
+    self->data = data;
+    self->freed = freed;
+    self->pages = header[3];
+    self->freeable = header[5];
+    self->used = used;
+    texture_atlas_dirty_all( self );
+    self->modified = 1;
+    return 1;
+
+cleanup:
+    free( skyline );
+    free( data );
+    if( freed )
+        vector_delete( freed );
+    return 0;
 }
 
 // -------------------------------------------- texture_atlas_enlarge_atlas ---
@@ -313,24 +1015,47 @@ void texture_atlas_enlarge_texture ( texture_atlas_t* self, size_t width_new, si
 
     size_t width_old = self->width;
     size_t height_old = self->height;    
+    size_t page, i;
     //allocate new buffer
     unsigned char* data_old = self->data;
-    self->data = calloc(1,width_new*height_new * sizeof(char)*self->depth);    
+    self->data = calloc(1,width_new*height_new * sizeof(char)*self->depth*self->pages);
     //update atlas size
     self->width = width_new;
     self->height = height_new;
-    //add node reflecting the gained space on the right
+    //rebuild the skyline over the new width, the gained space on the right is empty
     if( width_new>width_old )
     {
-        ivec3 node;
-        node.x = width_old - 1;
-        node.y = 1;
-        node.z = width_new - width_old;
-        vector_push_back(self->nodes, &node);    
+        skyline_node_t* skyline_old = self->skyline;
+        size_t size_old = self->skyline_size;
+
+        self->skyline = NULL;
+        self->skyline_size = 0;
+        texture_atlas_skyline_reset(self);
+        for( page = 0; page < self->pages; ++page )
+        {
+            memcpy(self->skyline + 2 * self->skyline_size * page + self->skyline_size + 1,
+                   skyline_old + 2 * size_old * page + size_old + 1,
+                   (width_old - 2) * sizeof(skyline_node_t));
+            texture_atlas_skyline_update(self, page, 1, width_old - 1);
+        }
+        free(skyline_old);
     }
     //copy over data from the old buffer, skipping first row and column because of the margin
     size_t pixel_size = sizeof(char) * self->depth;
     size_t old_row_size = width_old * pixel_size;
-    texture_atlas_set_region(self, 1, 1, width_old - 2, height_old - 2, data_old + old_row_size + pixel_size, old_row_size);
-    free(data_old);    
+    for( page = 0; page < self->pages; ++page )
+    {
+        texture_atlas_set_page_region(self, page, 1, 1, width_old - 2, height_old - 2,
+                                      data_old + page * height_old * old_row_size + old_row_size + pixel_size,
+                                      old_row_size);
+    }
+    free(data_old);
+    //freed regions are stacked by page, as pages got taller they move down
+    for( i = 0; i < self->freed->size; ++i )
+    {
+        ivec4* freed = (ivec4*) vector_get(self->freed, i);
+        freed->y = freed->y / height_old * height_new + freed->y % height_old;
+    }
+    //the texture has a new size, it has to be uploaded whole
+    texture_atlas_dirty_all(self);
 }
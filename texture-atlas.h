@@ -18,6 +18,7 @@
 #ifndef __TEXTURE_ATLAS_H__
 #define __TEXTURE_ATLAS_H__
 
+#include <stdio.h>
 #include <stdlib.h>
 
 #ifdef __cplusplus
@@ -70,15 +71,41 @@ namespace ftgl {
  */
 
 
+/**
+ * A node of the skyline tree, covering a span of columns of the atlas.
+ */
+typedef struct skyline_node_t
+{
+    /**
+     * Height of the lowest column of the span
+     */
+    int min;
+
+    /**
+     * Height of the highest column of the span
+     */
+    int max;
+} skyline_node_t;
+
+
 /**
  * A texture atlas is used to pack several small regions into a single texture.
  */
 typedef struct texture_atlas_t
 {
     /**
-     * Allocated nodes
+     * Height of every column of the atlas, as a segment tree whose nodes
+     * hold the lowest and highest column of the span they cover. Node 1 is
+     * the root, the children of node i are nodes 2i and 2i+1 and column x
+     * is node skyline_size+x. There is one tree of 2*skyline_size nodes
+     * per page, one after the other.
      */
-    vector_t * nodes;
+    skyline_node_t * skyline;
+
+    /**
+     * Number of columns covered by the skyline tree (a power of two)
+     */
+    size_t skyline_size;
 
     /**
      *  Width (in pixels) of the underlying texture
@@ -95,6 +122,25 @@ typedef struct texture_atlas_t
      */
     size_t depth;
 
+    /**
+     * Number of pages in use, each one width x height x depth
+     */
+    size_t pages;
+
+    /**
+     * Number of pages the atlas may grow to (1 by default). Text drawn from
+     * several pages needs a text buffer of a format with the page, e.g.
+     * GLYPH_VERTEX_LAYERED.
+     */
+    size_t max_pages;
+
+    /**
+     * Whether allocated regions are going to be freed, in which case the
+     * space wasted under them is tracked so that it can be given back too.
+     * To be set before any region is allocated.
+     */
+    unsigned char freeable;
+
     /**
      * Allocated surface size
      */
@@ -106,7 +152,7 @@ typedef struct texture_atlas_t
     unsigned int id;
 
     /**
-     * Atlas data
+     * Atlas data, one page after the other (as the layers of a texture array)
      */
     unsigned char * data;
 
@@ -115,6 +161,21 @@ typedef struct texture_atlas_t
      */
     unsigned char modified;
 
+    /**
+     * Regions (ivec4) of the atlas data modified since the dirty regions
+     * were last cleared. Regions are merged as long as their bounding box
+     * is not larger than the two of them. Pages are stacked, the rows of
+     * page p starting at y = p * height.
+     */
+    vector_t * dirty;
+
+    /**
+     * Regions (ivec4, stacked by page as the dirty ones) that are free but
+     * whose space could not be given back to the skyline yet because of
+     * regions allocated above them.
+     */
+    vector_t * freed;
+
     /**
      * Atlas special glyph, this is a void*, and will be typecasted as necessary
      */
@@ -186,6 +247,99 @@ typedef struct texture_atlas_t
                             const unsigned char *data,
                             const size_t stride );
 
+/**
+ *  Allocate a new region in any page of the atlas. Pages are tried in order
+ *  and, if the region fits in none of them, a new page is added as long as
+ *  there are less than max_pages.
+ *
+ *  @param self   a texture atlas structure
+ *  @param width  width of the region to allocate
+ *  @param height height of the region to allocate
+ *  @param page   page of the allocated region
+ *  @return       Coordinates of the allocated region within its page
+ *
+ */
+  ivec4
+  texture_atlas_get_page_region( texture_atlas_t * self,
+                                 const size_t width,
+                                 const size_t height,
+                                 size_t * page );
+
+
+/**
+ *  Upload data to the specified region of an atlas page.
+ *
+ *  @param self   a texture atlas structure
+ *  @param page   page of the region
+ *  @param x      x coordinate the region
+ *  @param y      y coordinate the region
+ *  @param width  width of the region
+ *  @param height height of the region
+ *  @param data   data to be uploaded into the specified region
+ *  @param stride stride of the data
+ *
+ */
+  void
+  texture_atlas_set_page_region( texture_atlas_t * self,
+                                 const size_t page,
+                                 const size_t x,
+                                 const size_t y,
+                                 const size_t width,
+                                 const size_t height,
+                                 const unsigned char *data,
+                                 const size_t stride );
+
+/**
+ *  Give a region allocated with texture_atlas_get_page_region (or
+ *  texture_atlas_get_region for page 0) back to the atlas. The skyline is
+ *  lowered over the region where nothing lies above it; space under regions
+ *  still in use is given back once they are freed too. Unless the atlas is
+ *  freeable, the space wasted under regions when they were allocated is
+ *  never given back.
+ *
+ *  @param self   a texture atlas structure
+ *  @param page   page of the region
+ *  @param x      x coordinate the region
+ *  @param y      y coordinate the region
+ *  @param width  width of the region
+ *  @param height height of the region
+ *
+ */
+  void
+  texture_atlas_free_page_region( texture_atlas_t * self,
+                                  const size_t page,
+                                  const size_t x,
+                                  const size_t y,
+                                  const size_t width,
+                                  const size_t height );
+
+/**
+ *  Get the regions of the atlas data modified since the last call to
+ *  texture_atlas_clear_dirty, so that only those need to be uploaded to the
+ *  texture.
+ *
+ *  Since atlas rows are contiguous, a region can be uploaded as region.height
+ *  full rows starting at data + region.y * width * depth, which is row
+ *  region.y % height of page region.y / height. A region covering the whole
+ *  atlas (all pages) means the texture has to be (re)created, e.g. after the
+ *  atlas has been enlarged or a page has been added.
+ *
+ *  @param self   a texture atlas structure
+ *  @param count  number of modified regions
+ *  @return       modified regions
+ */
+  const ivec4 *
+  texture_atlas_get_dirty( const texture_atlas_t * self,
+                           size_t * count );
+
+/**
+ *  Forget about the modified regions, once they have been uploaded.
+ *
+ *  @param self   a texture atlas structure
+ */
+  void
+  texture_atlas_clear_dirty( texture_atlas_t * self );
+
 /**
  *  Remove all allocated regions from the atlas.
  *
@@ -194,6 +348,47 @@ typedef struct texture_atlas_t
   void
   texture_atlas_clear( texture_atlas_t * self );
 
+/**
+ *  Whether no region is allocated in the atlas but the special glyph one.
+ *
+ *  @param self   a texture atlas structure
+ *
+ *  @return       1 if the atlas is empty, 0 otherwise
+ */
+  int
+  texture_atlas_is_empty( const texture_atlas_t * self );
+
+/**
+ *  Write the pixels and the allocated space of an atlas to a file, in a
+ *  binary format only meant to be read back by texture_atlas_read on the
+ *  same platform.
+ *
+ *  @param self   a texture atlas structure
+ *  @param file   a file opened for binary writing
+ *
+ *  @return       1 on success, 0 on a write error
+ */
+  int
+  texture_atlas_write( const texture_atlas_t * self,
+                       FILE * file );
+
+/**
+ *  Replace the pixels and the allocated space of an atlas with the ones
+ *  written by texture_atlas_write. The atlas must be empty (see
+ *  texture_atlas_is_empty), since any region allocated in it would be
+ *  overwritten, and have the same width, height and depth, the pages
+ *  written not exceeding max_pages. The atlas is left unchanged when they
+ *  cannot be read, or when their skyline or freed regions do not fit it.
+ *
+ *  @param self   a texture atlas structure
+ *  @param file   a file opened for binary reading
+ *
+ *  @return       1 on success, 0 otherwise
+ */
+  int
+  texture_atlas_read( texture_atlas_t * self,
+                      FILE * file );
+
 /**
  *  Enlarge a texture atlas
  *
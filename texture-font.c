@@ -9,26 +9,20 @@
 #include FT_STROKER_H
 // #include FT_ADVANCES_H
 #include FT_LCD_FILTER_H
+#include FT_BITMAP_H
 #include FT_TRUETYPE_TABLES_H
 #include FT_MULTIPLE_MASTERS_H
 #include <stdint.h>
 #include <stdlib.h>
+#include "config.h"
 #include <stdio.h>
 #include <assert.h>
 #include <math.h>
-#ifdef __APPLE__
-# include <machine/endian.h>
-# define __BIG_ENDIAN __ORDER_BIG_ENDIAN__
-# define __LITTLE_ENDIAN __ORDER_LITTLE_ENDIAN__
-# define __BYTE_ORDER __BYTE_ORDER__
-#elif defined(_WIN32) || defined(_WIN64)
-# define __LITTLE_ENDIAN 1234
-# define __BIG_ENDIAN 4321
-# define __BYTE_ORDER __LITTLE_ENDIAN
-#else
-# include <endian.h>
+#ifdef FREETYPE_GL_USE_PTHREADS
+# include <pthread.h>
 #endif
 #include "distance-field.h"
+#include "pixel-convert.h"
 #include "texture-font.h"
 #include "platform.h"
 #include "utf8-utils.h"
@@ -52,29 +46,37 @@ static FT_F26Dot6 convert_float_to_F26Dot6(float value)
 __THREAD texture_font_library_t * freetype_gl_library = NULL;
 __THREAD font_mode_t mode_default=MODE_FREE_CLOSE;
 
-// rol8 ror8
-
-#if (defined(_WIN32) || defined(_WIN64)) && !defined(__GNUC__)
-# define inline
-static inline __builtin_bswap32(uint32_t in)
-{
-    return ((in >> 24) & 0xFF) | ((in >> 8) & 0xFF00) | ((in & 0xFF00) << 8) | ((in & 0xFF) << 24);
-}
+// glyph rendered by texture_font_load_glyphs_batch, waiting for its region
+
+typedef struct {
+    uint32_t codepoint;     // codepoint the glyph was requested for
+    uint32_t glyph_index;
+    size_t index;           // position of the codepoint in the batch
+    texture_glyph_t *glyph; // NULL if the glyph could not be rendered
+    unsigned char *buffer;  // glyph->width x glyph->height pixels
+} pending_glyph_t;
+
+#ifdef FREETYPE_GL_USE_PTHREADS
+// thread rendering every step-th pending glyph from first on, with a face
+// of its own
+
+typedef struct {
+    texture_font_t font;
+    texture_font_library_t library;
+    pending_glyph_t *pending;
+    size_t count;
+    size_t first;
+    size_t step;
+    pthread_t thread;
+    int started;
+} glyph_worker_t;
 #endif
 
-static inline uint32_t rol(uint32_t in, uint32_t x)
-{
-    return (in >> (32-x)) | (in << x);
-}
-
 // ------------------------------------------------------ texture_glyph_clone ---
 texture_glyph_t*
 texture_glyph_clone(texture_glyph_t* self)
 {
-    int i;
     texture_glyph_t* new_glyph;
-    float* source;
-    float** target;
     assert(self);
 
     new_glyph = (texture_glyph_t *) malloc( sizeof(texture_glyph_t) );
@@ -83,14 +85,10 @@ texture_glyph_clone(texture_glyph_t* self)
         return NULL;
     }
     memcpy(new_glyph, self, sizeof(texture_glyph_t));
-    new_glyph->kerning = vector_new(sizeof(float**));
-    vector_resize(new_glyph->kerning, self->kerning->size);
-    for (i = 0; i < self->kerning->size; i++) {
-        source = *(float**)vector_get(self->kerning, i);
-        target = (float**)vector_get(new_glyph->kerning, i);
-        *target = calloc(0x100, sizeof(float));
-        memcpy(*target, source, 0x100);
-    }
+    new_glyph->kerning = vector_new(sizeof(kerning_t));
+    if (self->kerning->size)
+        vector_push_back_data(new_glyph->kerning, self->kerning->items,
+                              self->kerning->size);
     return new_glyph;
 }
 
@@ -110,7 +108,6 @@ texture_glyph_new(void)
     /* Attributes that can have different images for the same codepoint */
     self->rendermode = RENDER_NORMAL;
     self->outline_thickness = 0.0;
-    self->glyphmode = GLYPH_END;
     /* End of attribute part */
     self->offset_x  = 0;
     self->offset_y  = 0;
@@ -120,10 +117,166 @@ texture_glyph_new(void)
     self->t0        = 0.0;
     self->s1        = 0.0;
     self->t1        = 0.0;
-    self->kerning   = vector_new( sizeof(float**) );
+    self->page      = 0;
+    self->last_used = 0;
+    self->kerning   = vector_new( sizeof(kerning_t) );
     return self;
 }
 
+// --------------------------------------------------- texture_glyph_map_new ---
+static texture_glyph_map_t *
+texture_glyph_map_new( void )
+{
+    texture_glyph_map_t *self = (texture_glyph_map_t *) malloc( sizeof(texture_glyph_map_t) );
+    if(self == NULL) {
+        freetype_gl_error( Out_Of_Memory );
+        return NULL;
+    }
+
+    self->capacity = 0x100;
+    self->size = 0;
+    self->slots = (texture_glyph_slot_t *) calloc( self->capacity, sizeof(texture_glyph_slot_t) );
+    if(self->slots == NULL) {
+        freetype_gl_error( Out_Of_Memory );
+        free( self );
+        return NULL;
+    }
+    return self;
+}
+
+// ------------------------------------------------ texture_glyph_map_delete ---
+static void
+texture_glyph_map_delete( texture_glyph_map_t *self )
+{
+    assert( self );
+    free( self->slots );
+    free( self );
+}
+
+// -------------------------------------------------- texture_glyph_map_hash ---
+/* Slot a key is probed from */
+static size_t
+texture_glyph_map_hash( const texture_glyph_map_t *self, uint32_t codepoint,
+                        rendermode_t rendermode, float outline_thickness )
+{
+    uint32_t h, thickness = 0;
+
+    /* 0.0 and -0.0 compare equal, so they have to hash the same */
+    if( outline_thickness != 0.0f )
+        memcpy( &thickness, &outline_thickness, sizeof(thickness) );
+
+    /* Fibonacci hashing: multiplying by 2^32 / golden ratio spreads runs of
+     * consecutive codepoints, which fonts are mostly loaded in, evenly over
+     * the slots, and the high bits of the product are scaled to the capacity
+     * rather than masked since the low bits are the poorly mixed ones */
+    h = (codepoint ^ (thickness + (uint32_t)rendermode) << 21) * 0x9E3779B1u;
+    return (size_t)(((uint64_t)h * self->capacity) >> 32);
+}
+
+// -------------------------------------------------- texture_glyph_map_find ---
+static texture_glyph_slot_t *
+texture_glyph_map_find( const texture_glyph_map_t *self,
+                        uint32_t codepoint, rendermode_t rendermode,
+                        float outline_thickness )
+{
+    size_t mask = self->capacity - 1;
+    size_t i = texture_glyph_map_hash( self, codepoint, rendermode,
+                                       outline_thickness );
+    texture_glyph_slot_t *slot;
+
+    /* The map is never full, so probing always ends on an empty slot */
+    for( slot = self->slots + i; slot->glyph; slot = self->slots + i ) {
+        if( slot->codepoint == codepoint &&
+            slot->rendermode == rendermode &&
+            slot->glyph->outline_thickness == outline_thickness )
+            return slot;
+        i = (i + 1) & mask;
+    }
+    return slot;
+}
+
+// ------------------------------------------------ texture_glyph_map_resize ---
+static int
+texture_glyph_map_resize( texture_glyph_map_t *self, size_t capacity )
+{
+    texture_glyph_slot_t *slots = self->slots;
+    texture_glyph_t *glyph;
+    size_t old_capacity = self->capacity, i;
+
+    self->slots = (texture_glyph_slot_t *) calloc( capacity, sizeof(texture_glyph_slot_t) );
+    if(self->slots == NULL) {
+        freetype_gl_error( Out_Of_Memory );
+        self->slots = slots;
+        return 0;
+    }
+    self->capacity = capacity;
+
+    for( i = 0; i < old_capacity; i++ ) {
+        glyph = slots[i].glyph;
+        if( glyph ) {
+            *texture_glyph_map_find( self, slots[i].codepoint,
+                                     slots[i].rendermode,
+                                     glyph->outline_thickness ) = slots[i];
+        }
+    }
+    free( slots );
+    return 1;
+}
+
+// ------------------------------------------------ texture_glyph_map_insert ---
+static int
+texture_glyph_map_insert( texture_glyph_map_t *self, uint32_t codepoint,
+                          texture_glyph_t *glyph )
+{
+    texture_glyph_slot_t *slot, *owner;
+
+    slot = texture_glyph_map_find( self, codepoint, glyph->rendermode,
+                                   glyph->outline_thickness );
+    if( slot->glyph )
+        return slot->glyph != glyph;
+
+    /* Keep the load factor at most 3/4 so that misses stay short */
+    if( 4 * (self->size + 1) > 3 * self->capacity ) {
+        if( !texture_glyph_map_resize( self, 2 * self->capacity ) )
+            return -1;
+        slot = texture_glyph_map_find( self, codepoint, glyph->rendermode,
+                                       glyph->outline_thickness );
+    }
+
+    owner = texture_glyph_map_find( self, glyph->codepoint, glyph->rendermode,
+                                    glyph->outline_thickness );
+    slot->codepoint = codepoint;
+    slot->rendermode = glyph->rendermode;
+    slot->alias = owner->glyph == glyph;
+    slot->glyph = glyph;
+    self->size++;
+    return 0;
+}
+
+// ----------------------------------------------- texture_glyph_map_remove ---
+/* Empty a slot, moving back the slots probed after it so that each of them
+ * stays reachable from its hash */
+static void
+texture_glyph_map_remove( texture_glyph_map_t *self, size_t i )
+{
+    size_t mask = self->capacity - 1, j, k;
+    texture_glyph_slot_t *slot = self->slots + i;
+
+    for( j = (i + 1) & mask; self->slots[j].glyph; j = (j + 1) & mask ) {
+        slot = self->slots + j;
+        k = texture_glyph_map_hash( self, slot->codepoint, slot->rendermode,
+                                    slot->glyph->outline_thickness );
+        /* The slot can fill the hole if the hole lies between its hash and
+         * itself */
+        if( ((j - k) & mask) >= ((j - i) & mask) ) {
+            self->slots[i] = *slot;
+            i = j;
+        }
+    }
+    self->slots[i].glyph = NULL;
+    self->size--;
+}
+
 // ---------------------------------------------- texture_font_default_mode ---
 void
 texture_font_default_mode(font_mode_t mode)
@@ -135,36 +288,57 @@ texture_font_default_mode(font_mode_t mode)
 void
 texture_glyph_delete( texture_glyph_t *self )
 {
-    int i;
     assert( self );
-    for(i=0; i < self->kerning->size; i++)
-        free( *(float **) vector_get( self->kerning, i ) );
     vector_delete( self->kerning );
     free( self );
 }
 
+// --------------------------------------------- texture_glyph_find_kerning ---
+/* Kerning pairs are sorted by codepoint, return the index of the first one
+ * that is not lower than codepoint */
+static size_t
+texture_glyph_find_kerning( const texture_glyph_t * self,
+                            uint32_t codepoint )
+{
+    const kerning_t *pairs = (const kerning_t *) self->kerning->items;
+    size_t first = 0, last = self->kerning->size, middle;
+
+    while( first < last ) {
+        middle = first + (last - first) / 2;
+        if( pairs[middle].codepoint < codepoint )
+            first = middle + 1;
+        else
+            last = middle;
+    }
+    return first;
+}
+
 // ---------------------------------------------- texture_glyph_get_kerning ---
 float
 texture_glyph_get_kerning( const texture_glyph_t * self,
                            const char * codepoint )
 {
-    uint32_t ucodepoint = utf8_to_utf32( codepoint );
-    uint32_t i = ucodepoint >> 8;
-    uint32_t j = ucodepoint & 0xFF;
-    float *kern_index;
+    return texture_glyph_get_kerning_gi( self, utf8_to_utf32( codepoint ) );
+}
+
+// ------------------------------------------- texture_glyph_get_kerning_gi ---
+float
+texture_glyph_get_kerning_gi( const texture_glyph_t * self,
+                              uint32_t codepoint )
+{
+    const kerning_t *pair;
+    size_t i;
 
     assert( self );
-    if(ucodepoint == -1)
+    if(codepoint == (uint32_t) -1)
         return 0;
-    if(self->kerning->size <= i)
-        return 0;
-
-    kern_index = *(float **) vector_get( self->kerning, i );
 
-    if(!kern_index)
+    i = texture_glyph_find_kerning( self, codepoint );
+    if( i == self->kerning->size )
         return 0;
-    else
-        return kern_index[j];
+
+    pair = (const kerning_t *) vector_get( self->kerning, i );
+    return pair->codepoint == codepoint ? pair->kerning : 0;
 }
 
 // ---------------------------------------------- texture_font_index_kerning ---
@@ -173,21 +347,31 @@ void texture_font_index_kerning( texture_glyph_t * self,
                                  uint32_t codepoint,
                                  float kerning)
 {
-    uint32_t i = codepoint >> 8;
-    uint32_t j = codepoint & 0xFF;
-    float ** kerning_index;
+    kerning_t pair = { codepoint, kerning };
+    size_t i = texture_glyph_find_kerning( self, codepoint );
 
-    if(self->kerning->size <= i) {
-        vector_resize( self->kerning, i+1);
-    }
+    if( i < self->kerning->size &&
+        ((kerning_t *) vector_get( self->kerning, i ))->codepoint == codepoint )
+        vector_set( self->kerning, i, &pair );
+    else
+        vector_insert( self->kerning, i, &pair );
+}
 
-    kerning_index = (float **) vector_get( self->kerning, i );
+// ---------------------------------------- texture_font_get_kerning_memory ---
+size_t
+texture_font_get_kerning_memory( const texture_font_t * self )
+{
+    size_t i, memory = 0;
+    texture_glyph_t *glyph;
 
-    if(!*kerning_index) {
-        *kerning_index = calloc( 0x100, sizeof(float) );
-    }
+    assert( self );
 
-    (*kerning_index)[j] = kerning;
+    GLYPHS_ITERATOR(i, glyph, self->glyphs ) {
+        memory += sizeof(vector_t) +
+            glyph->kerning->capacity * glyph->kerning->item_size;
+    }
+    GLYPHS_ITERATOR_END
+    return memory;
 }
 
 // ------------------------------------------ texture_font_generate_kerning ---
@@ -195,7 +379,7 @@ void
 texture_font_generate_kerning( texture_font_t *self,
                                FT_Library *library, FT_Face *face )
 {
-    size_t i, j, k;
+    size_t i, j;
     FT_UInt glyph_index, prev_index;
     texture_glyph_t *glyph, *prev_glyph;
     FT_Vector kerning;
@@ -208,8 +392,6 @@ texture_font_generate_kerning( texture_font_t *self,
         glyph_index = FT_Get_Char_Index( *face, glyph->codepoint );
 //        fprintf(stderr, "Retrieving glyph %p from index %i\n", __glyphs, __i);
 //        fprintf(stderr, "Glpyh %p: Indexing %d, kerning %p\n", glyph, glyph_index, glyph->kerning);
-        for(k=0; k < glyph->kerning->size; k++)
-            free( *(float **) vector_get( glyph->kerning, k ) );
         vector_clear( glyph->kerning );
         
         GLYPHS_ITERATOR(j, prev_glyph, self->glyphs ) {
@@ -237,6 +419,124 @@ texture_font_generate_kerning( texture_font_t *self,
     GLYPHS_ITERATOR_END
 }
 
+// ------------------------------------ texture_font_generate_glyph_kerning ---
+void
+texture_font_generate_glyph_kerning( texture_font_t *self,
+                                     texture_glyph_t *glyph )
+{
+    size_t i;
+    FT_UInt glyph_index, prev_index;
+    texture_glyph_t *prev_glyph;
+    FT_Vector kerning;
+
+    assert( self );
+    assert( glyph );
+
+    /* Nothing to do for faces without kerning information */
+    if( !FT_HAS_KERNING( self->face ) )
+        return;
+
+    /* Only the pairs involving the new glyph need to be computed, every
+     * other pair has already been indexed when its glyphs were loaded.
+     * The new glyph is already indexed, so the loop also covers the pair
+     * it forms with itself. */
+    glyph_index = FT_Get_Char_Index( self->face, glyph->codepoint );
+    GLYPHS_ITERATOR(i, prev_glyph, self->glyphs ) {
+        prev_index = FT_Get_Char_Index( self->face, prev_glyph->codepoint );
+        // FT_KERNING_UNFITTED returns FT_F26Dot6 values.
+        FT_Get_Kerning( self->face, prev_index, glyph_index, FT_KERNING_UNFITTED, &kerning );
+        if( kerning.x ) {
+            texture_font_index_kerning( glyph,
+                                        prev_glyph->codepoint,
+                                        convert_F26Dot6_to_float(kerning.x) / HRESf );
+        }
+        FT_Get_Kerning( self->face, glyph_index, prev_index, FT_KERNING_UNFITTED, &kerning );
+        if( kerning.x ) {
+            texture_font_index_kerning( prev_glyph,
+                                        glyph->codepoint,
+                                        convert_F26Dot6_to_float(kerning.x) / HRESf );
+        }
+    }
+    GLYPHS_ITERATOR_END
+}
+
+// -------------------------------------------- texture_font_compare_glyphs ---
+static int
+texture_font_compare_glyphs( const void * a, const void * b )
+{
+    const texture_glyph_t *ga = *(const texture_glyph_t * const *) a;
+    const texture_glyph_t *gb = *(const texture_glyph_t * const *) b;
+
+    return ga < gb ? -1 : ga > gb;
+}
+
+// ------------------------------------ texture_font_generate_batch_kerning ---
+/* Index the kerning pairs formed by glyphs just indexed together. Glyph
+ * indices are looked up once per glyph instead of once per pair, and every
+ * pair is computed once. */
+static void
+texture_font_generate_batch_kerning( texture_font_t *self,
+                                     texture_glyph_t **added,
+                                     size_t count )
+{
+    size_t i, j, total = 0;
+    texture_glyph_t **glyphs, *glyph;
+    FT_UInt *indices;
+    FT_Vector kerning;
+
+    assert( self );
+
+    /* Nothing to do for faces without kerning information */
+    if( !count || !FT_HAS_KERNING( self->face ) )
+        return;
+
+    glyphs = (texture_glyph_t **) malloc( self->glyphs->size * sizeof(texture_glyph_t *) );
+    indices = (FT_UInt *) malloc( self->glyphs->size * sizeof(FT_UInt) );
+    if( glyphs == NULL || indices == NULL ) {
+        freetype_gl_error( Out_Of_Memory );
+        free( glyphs );
+        free( indices );
+        return;
+    }
+
+    /* Glyphs that were there before come first, then the added ones */
+    qsort( added, count, sizeof(texture_glyph_t *), texture_font_compare_glyphs );
+    GLYPHS_ITERATOR(i, glyph, self->glyphs ) {
+        if( !bsearch( &glyph, added, count, sizeof(texture_glyph_t *),
+                      texture_font_compare_glyphs ) )
+            glyphs[total++] = glyph;
+    }
+    GLYPHS_ITERATOR_END
+    for( i = 0; i < count; i++ )
+        glyphs[total++] = added[i];
+    for( i = 0; i < total; i++ )
+        indices[i] = FT_Get_Char_Index( self->face, glyphs[i]->codepoint );
+
+    /* Pair each added glyph with the glyphs before it, and itself */
+    for( i = total - count; i < total; i++ ) {
+        for( j = 0; j <= i; j++ ) {
+            // FT_KERNING_UNFITTED returns FT_F26Dot6 values.
+            FT_Get_Kerning( self->face, indices[j], indices[i], FT_KERNING_UNFITTED, &kerning );
+            if( kerning.x ) {
+                texture_font_index_kerning( glyphs[i],
+                                            glyphs[j]->codepoint,
+                                            convert_F26Dot6_to_float(kerning.x) / HRESf );
+            }
+            if( j == i )
+                continue;
+            FT_Get_Kerning( self->face, indices[i], indices[j], FT_KERNING_UNFITTED, &kerning );
+            if( kerning.x ) {
+                texture_font_index_kerning( glyphs[j],
+                                            glyphs[i]->codepoint,
+                                            convert_F26Dot6_to_float(kerning.x) / HRESf );
+            }
+        }
+    }
+
+    free( glyphs );
+    free( indices );
+}
+
 // -------------------------------------------------- texture_is_color_font ---
 
 int
@@ -247,6 +547,21 @@ texture_is_color_font( texture_font_t *self) {
     return length != 0;
 }
 
+// ---------------------------------------------- texture_font_strike_scale ---
+/* Factor by which glyphs of a fixed size font are downscaled, from the size
+ * of the selected strike to the size of the font. 1 for scalable fonts, and
+ * for strikes smaller than the font. */
+static float
+texture_font_strike_scale( texture_font_t *self )
+{
+    float strike;
+
+    if( !FT_HAS_FIXED_SIZES( self->face ) || !self->face->size )
+        return 1.0;
+    strike = self->face->size->metrics.y_ppem;
+    return strike > self->size ? self->size / strike : 1.0;
+}
+
 // -------------------------------------------------- texture_font_set_size ---
 
 int
@@ -290,6 +605,9 @@ texture_font_set_size ( texture_font_t *self, float size )
             return 0;
         }
         self->scale = self->size / convert_F26Dot6_to_float(self->face->available_sizes[best_match].size);
+        /* Glyphs of larger strikes are downscaled to size when loaded */
+        if( self->scale < 1.0 )
+            self->scale = 1.0;
     } else {
         /* Set char size */
         error = FT_Set_Char_Size(self->face, convert_float_to_F26Dot6(size), 0, DPI * HRES, DPI);
@@ -311,6 +629,7 @@ void
 texture_font_init_size( texture_font_t * self)
 {
     FT_Size_Metrics metrics;
+    float scale;
     
     self->underline_position = self->face->underline_position / (float)(HRESf*HRESf) * self->size;
     self->underline_position = roundf( self->underline_position );
@@ -327,9 +646,10 @@ texture_font_init_size( texture_font_t * self)
     }
 
     metrics = self->face->size->metrics;
-    self->ascender  = metrics.ascender  >> 6;
-    self->descender = metrics.descender >> 6;
-    self->height    = metrics.height    >> 6;
+    scale = texture_font_strike_scale( self );
+    self->ascender  = (metrics.ascender  >> 6) * scale;
+    self->descender = (metrics.descender >> 6) * scale;
+    self->height    = (metrics.height    >> 6) * scale;
     self->linegap = self->height - self->ascender + self->descender;
 }
 
@@ -343,18 +663,25 @@ texture_font_init(texture_font_t *self)
         || (self->location == TEXTURE_FONT_MEMORY
             && self->memory.base && self->memory.size));
 
-    self->glyphs = vector_new(sizeof(texture_glyph_t *));
+    self->glyphs = texture_glyph_map_new();
     self->height = 0;
     self->ascender = 0;
     self->descender = 0;
     self->linegap = 0;
     self->rendermode = RENDER_NORMAL;
     self->outline_thickness = 0.0;
+    self->sdf_method = SDF_EDTAA3;
     self->hinting = 1;
     self->kerning = 1;
     self->filtering = 1;
     self->scaletex = 1;
     self->scale = 1.0;
+    self->threads = 1;
+    self->evict = 0;
+    self->frame = 0;
+    self->hits = 0;
+    self->misses = 0;
+    self->evictions = 0;
 
     // FT_LCD_FILTER_LIGHT   is (0x00, 0x55, 0x56, 0x55, 0x00)
     // FT_LCD_FILTER_DEFAULT is (0x10, 0x40, 0x70, 0x40, 0x10)
@@ -467,6 +794,9 @@ texture_font_clone( texture_font_t *old, float pt_size)
 
     memcpy(self, old, sizeof(*self));
     self->size  = pt_size;
+    self->hits = 0;
+    self->misses = 0;
+    self->evictions = 0;
 
     error = FT_New_Size( self->face, &self->ft_size );
     if(error) {
@@ -486,7 +816,7 @@ texture_font_clone( texture_font_t *old, float pt_size)
     texture_font_init_size( self );
     
     if(self->size / self->scale != native_size)
-        self->glyphs = vector_new(sizeof(texture_glyph_t *));
+        self->glyphs = texture_glyph_map_new();
     return self;
 }
 // ----------------------------------------------------- texture_font_close ---
@@ -705,11 +1035,9 @@ texture_font_delete( texture_font_t *self )
         
     GLYPHS_ITERATOR(i, glyph, self->glyphs) {
         texture_glyph_delete( glyph );
-    } GLYPHS_ITERATOR_END1
-        free( __glyphs );
-    GLYPHS_ITERATOR_END2;
+    } GLYPHS_ITERATOR_END
 
-    vector_delete( self->glyphs );
+    texture_glyph_map_delete( self->glyphs );
     free( self );
 }
 
@@ -729,63 +1057,67 @@ texture_glyph_t *
 texture_font_find_glyph_gi( texture_font_t * self,
                             uint32_t codepoint )
 {
-    uint32_t i = codepoint >> 8;
-    uint32_t j = codepoint & 0xFF;
-    texture_glyph_t **glyph_index1, *glyph;
-
-    if(self->glyphs->size <= i)
-        return NULL;
-
-    glyph_index1 = *(texture_glyph_t ***) vector_get( self->glyphs, i );
-
-    if(!glyph_index1)
-        return NULL;
-    else
-        glyph = glyph_index1[j];
-
-    while( glyph && // if no glyph is there, we are done here
-           (glyph->rendermode != self->rendermode ||
-            glyph->outline_thickness != self->outline_thickness) ) {
-        if( glyph->glyphmode != GLYPH_CONT)
-            return NULL;
-        glyph++;
-    }
-    return glyph;
+    return texture_glyph_map_find( self->glyphs, codepoint,
+                                   self->rendermode,
+                                   self->outline_thickness )->glyph;
 }
 
+// ----------------------------------------------- texture_font_index_glyph ---
 int
 texture_font_index_glyph( texture_font_t * self,
                           texture_glyph_t *glyph,
                           uint32_t codepoint)
 {
-    uint32_t i = codepoint >> 8;
-    uint32_t j = codepoint & 0xFF;
-    texture_glyph_t ***glyph_index1, *glyph_insert;
+    return texture_glyph_map_insert( self->glyphs, codepoint, glyph );
+}
+
+// ----------------------------------------- texture_font_free_glyph_region ---
+/* Give the atlas region of a placed glyph back to the atlas */
+static void
+texture_font_free_glyph_region( texture_font_t * self,
+                                texture_glyph_t * glyph )
+{
+    size_t x, y;
 
-    if(self->glyphs->size <= i) {
-        vector_resize( self->glyphs, i+1);
+    if( self->scaletex ) {
+        x = (size_t)(glyph->s0 * self->atlas->width + 0.5f);
+        y = (size_t)(glyph->t0 * self->atlas->height + 0.5f);
+    } else {
+        x = (size_t)(glyph->s0 + 0.5f);
+        y = (size_t)(glyph->t0 + 0.5f);
     }
+    texture_atlas_free_page_region( self->atlas, glyph->page, x, y,
+                                    glyph->width, glyph->height );
+}
 
-    glyph_index1 = (texture_glyph_t ***) vector_get( self->glyphs, i );
+// ----------------------------------------------- texture_font_evict_glyph ---
+/* Delete the least recently used glyph that was not got in the current frame
+ * and give its region back to the atlas. Return 0 if there is no such glyph. */
+static int
+texture_font_evict_glyph( texture_font_t * self )
+{
+    size_t i;
+    texture_glyph_t *glyph, *oldest = NULL;
 
-    if(!*glyph_index1) {
-        *glyph_index1 = calloc( 0x100, sizeof(texture_glyph_t*) );
+    GLYPHS_ITERATOR(i, glyph, self->glyphs ) {
+        if( glyph->last_used < self->frame &&
+            ( !oldest || glyph->last_used < oldest->last_used ) )
+            oldest = glyph;
     }
-
-    if(( glyph_insert = (*glyph_index1)[j] )) {
-        int i = 0;
-        // fprintf(stderr, "glyph already there\n");
-        while (glyph_insert[i].glyphmode != GLYPH_END)
-            i++;
-        // fprintf(stderr, "Insert a glyph after position %d\n", i);
-        glyph_insert[i].glyphmode = GLYPH_CONT;
-        (*glyph_index1)[j] = glyph_insert = realloc( glyph_insert, sizeof(texture_glyph_t)*(i+2) );
-        memcpy( glyph_insert+(i+1), glyph, sizeof(texture_glyph_t) );
-        return 1;
-    } else {
-        (*glyph_index1)[j] = glyph;
+    GLYPHS_ITERATOR_END
+    if( !oldest )
         return 0;
+
+    /* Remove the glyph along with the slots aliasing it */
+    for( i = 0; i < self->glyphs->capacity; i++ ) {
+        while( self->glyphs->slots[i].glyph == oldest )
+            texture_glyph_map_remove( self->glyphs, i );
     }
+
+    texture_font_free_glyph_region( self, oldest );
+    texture_glyph_delete( oldest );
+    self->evictions++;
+    return 1;
 }
 
 // ------------------------------------------------ texture_font_load_glyph ---
@@ -806,16 +1138,19 @@ texture_font_load_glyph( texture_font_t * self,
                                        ucodepoint);
 }
 
-// ------------------------------------------------ texture_font_load_glyph ---
-int
-texture_font_load_glyph_gi( texture_font_t * self,
-                            uint32_t glyph_index,
-                            uint32_t ucodepoint )
+// ---------------------------------------------- texture_font_render_glyph ---
+/* Rasterize a glyph into a new buffer of glyph->width x glyph->height pixels,
+ * padding included. The glyph is not placed in the atlas yet. */
+static int
+texture_font_render_glyph( texture_font_t * self,
+                           uint32_t glyph_index,
+                           uint32_t ucodepoint,
+                           texture_glyph_t ** glyph_out,
+                           unsigned char ** buffer_out )
 {
-    size_t i, x, y;
+    size_t i;
 
     FT_Error error;
-    FT_Face face;
     FT_Glyph ft_glyph = NULL;
     FT_GlyphSlot slot;
     FT_Bitmap ft_bitmap;
@@ -825,28 +1160,6 @@ texture_font_load_glyph_gi( texture_font_t * self,
     int ft_glyph_top = 0;
     int ft_glyph_left = 0;
 
-    ivec4 region;
-    size_t missed = 0;
-
-    /* Check if codepoint has been already loaded */
-    if (texture_font_find_glyph_gi(self, ucodepoint)) {
-        return 1;
-    }
-
-    if (!texture_font_load_face(self, self->size))
-        return 0;
-
-    flags = 0;
-    ft_glyph_top = 0;
-    ft_glyph_left = 0;
-    if(!glyph_index) {
-        texture_glyph_t * glyph;
-        if ((glyph = texture_font_find_glyph(self, "\0"))) {
-            texture_font_index_glyph( self, glyph, ucodepoint );
-            texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
-            return 1;
-        }
-    }
     // WARNING: We use texture-atlas depth to guess if user wants
     //          LCD subpixel rendering
 
@@ -910,7 +1223,6 @@ texture_font_load_glyph_gi( texture_font_t * self,
     if( error )
     {
         freetype_error( error );
-        texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
         return 0;
     }
 
@@ -989,11 +1301,75 @@ cleanup_stroker:
 
         if( error )
         {
-            texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+            if( ft_glyph )
+                FT_Done_Glyph( ft_glyph );
             return 0;
         }
     }
 
+    // Downscale strikes of fixed size fonts to the size of the font, rather
+    // than filling the atlas with glyphs the GPU would minify anyway. Every
+    // pixel mode is downscaled, since the font metrics are.
+    float strike_scale = texture_font_strike_scale( self );
+    unsigned char *downscaled = NULL;
+    FT_Bitmap converted;
+    FT_Bitmap_Init( &converted );
+    if( strike_scale < 1.0 && ft_bitmap.width && ft_bitmap.rows )
+    {
+        size_t channels = 1, pixels = ft_bitmap.width, width, rows;
+
+        // Less than 8 bits per pixel are expanded to grey levels first
+        if( ft_bitmap.pixel_mode == FT_PIXEL_MODE_MONO ||
+            ft_bitmap.pixel_mode == FT_PIXEL_MODE_GRAY2 ||
+            ft_bitmap.pixel_mode == FT_PIXEL_MODE_GRAY4 )
+        {
+            error = FT_Bitmap_Convert( self->library->library, &ft_bitmap, &converted, 1 );
+            if( error )
+            {
+                freetype_error( error );
+                FT_Bitmap_Done( self->library->library, &converted );
+                if( self->rendermode != RENDER_NORMAL && self->rendermode != RENDER_SIGNED_DISTANCE_FIELD )
+                    FT_Done_Glyph( ft_glyph );
+                return 0;
+            }
+            for( i = 0; i < converted.rows * (size_t)converted.pitch; i++ )
+                converted.buffer[i] = converted.buffer[i] * 255 / (converted.num_grays - 1);
+            ft_bitmap = converted;
+        }
+        if( ft_bitmap.pixel_mode == FT_PIXEL_MODE_BGRA )
+            channels = 4;
+        else if( ft_bitmap.pixel_mode == FT_PIXEL_MODE_LCD )
+        {
+            channels = 3;
+            pixels = ft_bitmap.width / 3;
+        }
+
+        width = (size_t)(pixels * strike_scale + 0.5f);
+        rows = (size_t)(ft_bitmap.rows * strike_scale + 0.5f);
+        width = width ? width : 1;
+        rows = rows ? rows : 1;
+        downscaled = ft_bitmap.pitch > 0 ? malloc( width * rows * channels ) : NULL;
+        if( ft_bitmap.pitch > 0 && !downscaled )
+        {
+            freetype_gl_error( Out_Of_Memory );
+            FT_Bitmap_Done( self->library->library, &converted );
+            if( self->rendermode != RENDER_NORMAL && self->rendermode != RENDER_SIGNED_DISTANCE_FIELD )
+                FT_Done_Glyph( ft_glyph );
+            return 0;
+        }
+        if( downscaled )
+        {
+            downscale_area( downscaled, width, rows, ft_bitmap.buffer,
+                            pixels, ft_bitmap.rows, ft_bitmap.pitch, channels );
+            ft_bitmap.buffer = downscaled;
+            ft_bitmap.width  = channels == 3 ? 3 * width : width;
+            ft_bitmap.rows   = rows;
+            ft_bitmap.pitch  = width * channels;
+            ft_glyph_left    = (int)floorf( ft_glyph_left * strike_scale + 0.5f );
+            ft_glyph_top     = (int)floorf( ft_glyph_top * strike_scale + 0.5f );
+        }
+    }
+
     struct {
         int left;
         int top;
@@ -1021,18 +1397,6 @@ cleanup_stroker:
     size_t tgt_w = src_w + padding.left + padding.right;
     size_t tgt_h = src_h + padding.top + padding.bottom;
 
-    region = texture_atlas_get_region( self->atlas, tgt_w, tgt_h );
-
-    if ( region.x < 0 )
-    {
-        freetype_gl_warning( Texture_Atlas_Full );
-        texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
-        return 0;
-    }
-
-    x = region.x;
-    y = region.y;
-
     // Copy pixel data over
     unsigned char *buffer = calloc( tgt_w * tgt_h * self->atlas->depth, sizeof(unsigned char) );
 
@@ -1042,17 +1406,7 @@ cleanup_stroker:
     {
         // BGRA in, RGBA out
         for( i = 0; i < src_h; i++ ) {
-            int j;
-            for( j = 0; j < ft_bitmap.width; j++ ) {
-                uint32_t bgra, rgba;
-                bgra = ((uint32_t*)src_ptr)[j];
-#if __BYTE_ORDER == __BIG_ENDIAN
-                rgba = rol(__builtin_bswap32(bgra), 8);
-#else
-                rgba = rol(__builtin_bswap32(bgra), 24);
-#endif
-                ((uint32_t*)dst_ptr)[j] = rgba;
-            }
+            convert_bgra_to_rgba( dst_ptr, src_ptr, src_w );
             dst_ptr += tgt_w * self->atlas->depth;
             src_ptr += ft_bitmap.pitch;
         }
@@ -1060,20 +1414,18 @@ cleanup_stroker:
     else if( ft_bitmap.pixel_mode == FT_PIXEL_MODE_BGRA && self->atlas->depth == 1 )
     {
         // BGRA in, grey out: Use weighted sum for luminosity, and multiply by alpha
-        struct src_pixel_t { uint8_t b; uint8_t g; uint8_t r; uint8_t a; } * src = (struct src_pixel_t *)ft_bitmap.buffer;
-        for( int row = 0; row < src_h; row++, dst_ptr += tgt_w * self->atlas->depth ) {
-            for( int col = 0; col < src_w; col++, src++ ) {
-                dst_ptr[col] = (0.3*src->r + 0.59*src->g + 0.11*src->b) * (src->a/255.0);
-            }
+        for( i = 0; i < src_h; i++ ) {
+            convert_bgra_to_grey( dst_ptr, src_ptr, src_w );
+            dst_ptr += tgt_w * self->atlas->depth;
+            src_ptr += ft_bitmap.pitch;
         }
     }
     else if( ft_bitmap.pixel_mode == FT_PIXEL_MODE_GRAY && self->atlas->depth == 4 ) {
         // Grey in, RGBA out: Use grey level for alpha channel, with white color
-        struct dst_pixel_t { uint8_t r; uint8_t g; uint8_t b; uint8_t a; } * dst = (struct dst_pixel_t *)dst_ptr;
-        for( int row = 0; row < src_h; row++, dst += tgt_w ) {
-            for( int col = 0; col < src_w; col++, src_ptr++ ) {
-                dst[col] = (struct dst_pixel_t){ 255, 255, 255, *src_ptr };
-            }
+        for( i = 0; i < src_h; i++ ) {
+            convert_grey_to_rgba( dst_ptr, src_ptr, src_w );
+            dst_ptr += tgt_w * self->atlas->depth;
+            src_ptr += ft_bitmap.pitch;
         }
     }
     else
@@ -1086,27 +1438,71 @@ cleanup_stroker:
             src_ptr += ft_bitmap.pitch;
         }
     }
+    free( downscaled );
+    FT_Bitmap_Done( self->library->library, &converted );
 
     if( self->rendermode == RENDER_SIGNED_DISTANCE_FIELD )
     {
-        unsigned char *sdf = make_distance_mapb( buffer, tgt_w, tgt_h );
+        unsigned char *sdf = self->sdf_method == SDF_DEAD_RECKONING
+            ? make_distance_mapb_dr( buffer, tgt_w, tgt_h )
+            : make_distance_mapb( buffer, tgt_w, tgt_h );
         free( buffer );
         buffer = sdf;
     }
 
-    texture_atlas_set_region( self->atlas, x, y, tgt_w, tgt_h, buffer, tgt_w * self->atlas->depth);
-
-    free( buffer );
-
     glyph = texture_glyph_new( );
     glyph->codepoint = glyph_index ? ucodepoint : 0;
-;
     glyph->width    = tgt_w;
     glyph->height   = tgt_h;
     glyph->rendermode = self->rendermode;
     glyph->outline_thickness = self->outline_thickness;
     glyph->offset_x = ft_glyph_left;
     glyph->offset_y = ft_glyph_top;
+    glyph->last_used = self->frame;
+    slot = self->face->glyph;
+    if( FT_HAS_FIXED_SIZES( self->face ) ) {
+        // color fonts use actual pixels, not subpixels
+        glyph->advance_x = slot->advance.x * strike_scale;
+        glyph->advance_y = slot->advance.y * strike_scale;
+    } else {
+	glyph->advance_x = convert_F26Dot6_to_float(slot->advance.x) * self->scale;
+        glyph->advance_y = convert_F26Dot6_to_float(slot->advance.y) * self->scale;
+    }
+
+    if( self->rendermode != RENDER_NORMAL && self->rendermode != RENDER_SIGNED_DISTANCE_FIELD )
+        FT_Done_Glyph( ft_glyph );
+
+    *glyph_out = glyph;
+    *buffer_out = buffer;
+    return 1;
+}
+
+// ----------------------------------------------- texture_font_place_glyph ---
+/* Allocate an atlas region for a rendered glyph and copy its buffer there */
+static int
+texture_font_place_glyph( texture_font_t * self,
+                          texture_glyph_t * glyph,
+                          const unsigned char * buffer )
+{
+    size_t x, y, page;
+    ivec4 region;
+
+    region = texture_atlas_get_page_region( self->atlas, glyph->width, glyph->height, &page );
+    while( region.x < 0 && self->evict && texture_font_evict_glyph( self ) )
+        region = texture_atlas_get_page_region( self->atlas, glyph->width, glyph->height, &page );
+
+    if ( region.x < 0 )
+    {
+        freetype_gl_warning( Texture_Atlas_Full );
+        return 0;
+    }
+
+    x = region.x;
+    y = region.y;
+
+    texture_atlas_set_page_region( self->atlas, page, x, y, glyph->width, glyph->height, buffer, glyph->width * self->atlas->depth);
+
+    glyph->page     = page;
     if(self->scaletex) {
         glyph->s0       = x/(float)self->atlas->width;
         glyph->t0       = y/(float)self->atlas->height;
@@ -1119,35 +1515,87 @@ cleanup_stroker:
         // half a pixel each to get crisp rendering
         glyph->s0       = x - 0.5;
         glyph->t0       = y - 0.5;
-        glyph->s1       = x + tgt_w - 0.5;
-        glyph->t1       = y + tgt_h - 0.5;
+        glyph->s1       = x + glyph->width - 0.5;
+        glyph->t1       = y + glyph->height - 0.5;
     }
-    slot = self->face->glyph;
-    if( FT_HAS_FIXED_SIZES( self->face ) ) {
-        // color fonts use actual pixels, not subpixels
-        glyph->advance_x = slot->advance.x;
-        glyph->advance_y = slot->advance.y;
-    } else {
-	glyph->advance_x = convert_F26Dot6_to_float(slot->advance.x) * self->scale;
-        glyph->advance_y = convert_F26Dot6_to_float(slot->advance.y) * self->scale;
+    return 1;
+}
+
+// ------------------------------------------------- texture_font_add_glyph ---
+/* Index a placed glyph, computing the kerning pairs it forms with the glyphs
+ * already there */
+static int
+texture_font_add_glyph( texture_font_t * self,
+                        texture_glyph_t * glyph,
+                        uint32_t ucodepoint )
+{
+    uint32_t codepoint = glyph->codepoint;
+
+    /* A missing glyph is owned by codepoint 0, and aliased by the
+     * codepoint it was requested for */
+    switch( texture_font_index_glyph(self, glyph, codepoint) ) {
+    case 0:
+        texture_font_generate_glyph_kerning( self, glyph );
+        break;
+    case 1:
+        texture_font_free_glyph_region( self, glyph );
+        texture_glyph_delete( glyph );
+        glyph = texture_font_find_glyph_gi( self, codepoint );
+        break;
+    default:
+        texture_font_free_glyph_region( self, glyph );
+        texture_glyph_delete( glyph );
+        return 0;
+    }
+    return texture_font_index_glyph( self, glyph, ucodepoint ) >= 0;
+}
+
+// ------------------------------------------------ texture_font_load_glyph ---
+int
+texture_font_load_glyph_gi( texture_font_t * self,
+                            uint32_t glyph_index,
+                            uint32_t ucodepoint )
+{
+    texture_glyph_t *glyph;
+    unsigned char *buffer;
+
+    /* Check if codepoint has been already loaded */
+    if (texture_font_find_glyph_gi(self, ucodepoint)) {
+        return 1;
     }
 
-    int free_glyph = texture_font_index_glyph(self, glyph, ucodepoint);
+    if (!texture_font_load_face(self, self->size))
+        return 0;
+
     if(!glyph_index) {
-        if(!free_glyph) {
-            glyph = texture_glyph_clone(glyph);
+        texture_glyph_t * glyph;
+        if ((glyph = texture_font_find_glyph(self, "\0"))) {
+            int indexed = texture_font_index_glyph( self, glyph, ucodepoint ) >= 0;
+            texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+            return indexed;
         }
-        free_glyph = texture_font_index_glyph(self, glyph, 0);
     }
-    if(free_glyph) {
-        // fprintf(stderr, "Free glyph\n");
-        free(glyph);
+
+    if( !texture_font_render_glyph( self, glyph_index, ucodepoint, &glyph, &buffer ) )
+    {
+        texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+        return 0;
+    }
+
+    if( !texture_font_place_glyph( self, glyph, buffer ) )
+    {
+        texture_glyph_delete( glyph );
+        free( buffer );
+        texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+        return 0;
     }
-    
-    if( self->rendermode != RENDER_NORMAL && self->rendermode != RENDER_SIGNED_DISTANCE_FIELD )
-        FT_Done_Glyph( ft_glyph );
+    free( buffer );
 
-    texture_font_generate_kerning( self, &self->library->library, &self->face );
+    if( !texture_font_add_glyph( self, glyph, ucodepoint ) )
+    {
+        texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+        return 0;
+    }
 
     texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
 
@@ -1159,26 +1607,260 @@ size_t
 texture_font_load_glyphs( texture_font_t * self,
                           const char * codepoints )
 {
+    size_t i, count = 0, missed;
+    uint32_t *decoded;
+
+    decoded = (uint32_t *) malloc( utf8_strlen( codepoints ) * sizeof(uint32_t) );
+    if( decoded == NULL && *codepoints ) {
+        freetype_gl_error( Out_Of_Memory );
+        return utf8_strlen( codepoints );
+    }
+
+    /* Rasterized together, on self->threads threads */
+    for( i = 0; codepoints[i]; i += utf8_surrogate_len(codepoints + i) )
+        decoded[count++] = utf8_to_utf32( codepoints + i );
+    missed = texture_font_load_glyphs_batch( self, decoded, count, NULL );
+
+    free( decoded );
+    return missed;
+}
+
+
+#ifdef FREETYPE_GL_USE_PTHREADS
+// --------------------------------------------- texture_font_render_worker ---
+static void *
+texture_font_render_worker( void * arg )
+{
+    glyph_worker_t *worker = (glyph_worker_t *) arg;
+    pending_glyph_t *p;
     size_t i;
 
-    self->mode++;
+    for( i = worker->first; i < worker->count; i += worker->step ) {
+        p = worker->pending + i;
+        if( !texture_font_render_glyph( &worker->font, p->glyph_index, p->codepoint,
+                                        &p->glyph, &p->buffer ) )
+            p->glyph = NULL;
+    }
+    return NULL;
+}
 
-    /* Load each glyph */
-    for( i = 0; i < strlen(codepoints); i += utf8_surrogate_len(codepoints + i) ) {
-        if( !texture_font_load_glyph( self, codepoints + i ) ) {
-            self->mode--;
-            texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+// ---------------------------------------------- texture_font_start_worker ---
+/* Give a worker a face of its own, set up as the one of the font, and start
+ * its thread. Return 0 if the worker could not be started. */
+static int
+texture_font_start_worker( texture_font_t * self, glyph_worker_t * worker )
+{
+    FT_MM_Var *master;
+    FT_Fixed *coords;
+
+    worker->font = *self;
+    worker->font.library = &worker->library;
+    worker->font.face = NULL;
+    worker->font.ft_size = NULL;
+    worker->font.hb_font = NULL;
+    worker->font.mode = MODE_ALWAYS_OPEN;
+    worker->library.mode = MODE_ALWAYS_OPEN;
+    worker->library.library = NULL;
+    if( !texture_font_load_face( &worker->font, worker->font.size ) )
+        return 0;
+
+    /* Same variation, for variable fonts */
+    if( FT_HAS_MULTIPLE_MASTERS( self->face ) &&
+        FT_Get_MM_Var( self->face, &master ) == 0 ) {
+        coords = (FT_Fixed *) malloc( master->num_axis * sizeof(FT_Fixed) );
+        if( coords &&
+            FT_Get_Var_Design_Coordinates( self->face, master->num_axis, coords ) == 0 )
+            FT_Set_Var_Design_Coordinates( worker->font.face, master->num_axis, coords );
+        free( coords );
+        FT_Done_MM_Var( self->library->library, master );
+    }
+
+    if( pthread_create( &worker->thread, NULL, texture_font_render_worker, worker ) ) {
+        texture_font_close( &worker->font, MODE_ALWAYS_OPEN, MODE_ALWAYS_OPEN );
+        return 0;
+    }
+    return 1;
+}
+#endif
+
+// -------------------------------------------- texture_font_render_pending ---
+/* Rasterize pending glyphs, spreading them over self->threads threads */
+static void
+texture_font_render_pending( texture_font_t * self,
+                             pending_glyph_t * pending,
+                             size_t count )
+{
+    size_t i, step = 1, first;
+    pending_glyph_t *p;
+#ifdef FREETYPE_GL_USE_PTHREADS
+    glyph_worker_t *workers = NULL;
+
+    /* This thread takes the glyphs of worker 0, and of the workers that
+     * could not be started */
+    step = self->threads < count ? self->threads : count;
+    if( step > 1 )
+        workers = (glyph_worker_t *) calloc( step, sizeof(glyph_worker_t) );
+    if( workers == NULL )
+        step = 1;
+    for( first = 1; first < step; first++ ) {
+        workers[first].pending = pending;
+        workers[first].count = count;
+        workers[first].first = first;
+        workers[first].step = step;
+        workers[first].started = texture_font_start_worker( self, workers + first );
+    }
+#endif
 
-            return utf8_strlen( codepoints + i );
+    for( first = 0; first < step; first++ ) {
+#ifdef FREETYPE_GL_USE_PTHREADS
+        if( first && workers[first].started )
+            continue;
+#endif
+        for( i = first; i < count; i += step ) {
+            p = pending + i;
+            if( !texture_font_render_glyph( self, p->glyph_index, p->codepoint,
+                                            &p->glyph, &p->buffer ) )
+                p->glyph = NULL;
         }
     }
 
-    self->mode--;
-    texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+#ifdef FREETYPE_GL_USE_PTHREADS
+    for( first = 1; first < step; first++ ) {
+        if( !workers[first].started )
+            continue;
+        pthread_join( workers[first].thread, NULL );
+        texture_font_close( &workers[first].font, MODE_ALWAYS_OPEN, MODE_ALWAYS_OPEN );
+    }
+    free( workers );
+#endif
+}
 
-    return 0;
+// -------------------------------------- texture_font_compare_glyph_height ---
+/* Order rendered glyphs from the tallest to the shortest, then from the
+ * widest to the narrowest, then as they were requested */
+static int
+texture_font_compare_glyph_height( const void * a, const void * b )
+{
+    const pending_glyph_t *pa = (const pending_glyph_t *) a;
+    const pending_glyph_t *pb = (const pending_glyph_t *) b;
+
+    if( pa->glyph->height != pb->glyph->height )
+        return pa->glyph->height < pb->glyph->height ? 1 : -1;
+    if( pa->glyph->width != pb->glyph->width )
+        return pa->glyph->width < pb->glyph->width ? 1 : -1;
+    return pa->index < pb->index ? -1 : pa->index > pb->index;
 }
 
+// ----------------------------------------- texture_font_load_glyphs_batch ---
+size_t
+texture_font_load_glyphs_batch( texture_font_t * self,
+                                const uint32_t * codepoints,
+                                size_t count,
+                                unsigned char * loaded )
+{
+    pending_glyph_t *pending, *p;
+    texture_glyph_t *glyph, **added;
+    uint32_t glyph_index;
+    size_t i, n = 0, added_count = 0, missed = 0;
+
+    assert( self );
+    assert( codepoints || !count );
+
+    if( loaded )
+        memset( loaded, 1, count );
+
+    if( !texture_font_load_face( self, self->size ) ) {
+        if( loaded )
+            memset( loaded, 0, count );
+        return count;
+    }
+
+    pending = (pending_glyph_t *) malloc( count * sizeof(pending_glyph_t) );
+    if( count && pending == NULL ) {
+        freetype_gl_error( Out_Of_Memory );
+        texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+        if( loaded )
+            memset( loaded, 0, count );
+        return count;
+    }
+
+    /* Rasterize every glyph not loaded yet, without touching the atlas */
+    for( i = 0; i < count; i++ ) {
+        if( texture_font_find_glyph_gi( self, codepoints[i] ) )
+            continue;
+        glyph_index = FT_Get_Char_Index( self->face, codepoints[i] );
+        if( !glyph_index && (glyph = texture_font_find_glyph( self, "\0" )) ) {
+            if( texture_font_index_glyph( self, glyph, codepoints[i] ) < 0 ) {
+                if( loaded )
+                    loaded[i] = 0;
+                missed++;
+            }
+            continue;
+        }
+        p = pending + n++;
+        p->codepoint = codepoints[i];
+        p->glyph_index = glyph_index;
+        p->index = i;
+    }
+    texture_font_render_pending( self, pending, n );
+    for( i = 0, count = n, n = 0; i < count; i++ ) {
+        if( pending[i].glyph ) {
+            pending[n++] = pending[i];
+        } else {
+            if( loaded )
+                loaded[pending[i].index] = 0;
+            missed++;
+        }
+    }
+
+    /* The skyline wastes less space when the tallest regions come first */
+    qsort( pending, n, sizeof(pending_glyph_t), texture_font_compare_glyph_height );
+    added = (texture_glyph_t **) malloc( n * sizeof(texture_glyph_t *) );
+
+    for( i = 0; i < n; i++ ) {
+        p = pending + i;
+        /* Duplicates, and missing codepoints but the first one, end up
+         * rendered twice: index them under the glyph placed first */
+        if( (glyph = texture_font_find_glyph_gi( self, p->glyph->codepoint )) ) {
+            texture_glyph_delete( p->glyph );
+            if( texture_font_index_glyph( self, glyph, p->codepoint ) < 0 ) {
+                if( loaded )
+                    loaded[p->index] = 0;
+                missed++;
+            }
+        } else if( !texture_font_place_glyph( self, p->glyph, p->buffer ) ) {
+            texture_glyph_delete( p->glyph );
+            if( loaded )
+                loaded[p->index] = 0;
+            missed++;
+        } else if( texture_font_index_glyph( self, p->glyph,
+                                             p->glyph->codepoint ) >= 0 ) {
+            if( texture_font_index_glyph( self, p->glyph, p->codepoint ) < 0 ) {
+                if( loaded )
+                    loaded[p->index] = 0;
+                missed++;
+            }
+            /* Kerning is computed once every glyph is there */
+            if( added )
+                added[added_count++] = p->glyph;
+            else
+                texture_font_generate_glyph_kerning( self, p->glyph );
+        } else {
+            texture_font_free_glyph_region( self, p->glyph );
+            texture_glyph_delete( p->glyph );
+            if( loaded )
+                loaded[p->index] = 0;
+            missed++;
+        }
+        free( p->buffer );
+    }
+    texture_font_generate_batch_kerning( self, added, added_count );
+
+    free( added );
+    free( pending );
+    texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+    return missed;
+}
 
 // ------------------------------------------------- texture_font_get_glyph ---
 texture_glyph_t *
@@ -1192,11 +1874,17 @@ texture_font_get_glyph( texture_font_t * self,
     assert( self->atlas );
 
     /* Check if codepoint has been already loaded */
-    if( !(glyph = texture_font_find_glyph( self, codepoint )) )
+    if( (glyph = texture_font_find_glyph( self, codepoint )) )
+        self->hits++;
     /* Glyph has not been already loaded */
+    else {
+        self->misses++;
         if( texture_font_load_glyph( self, codepoint ) )
             glyph = texture_font_find_glyph( self, codepoint );
+    }
 
+    if( glyph )
+        glyph->last_used = self->frame;
     return glyph;
 }
 
@@ -1212,14 +1900,32 @@ texture_font_get_glyph_gi( texture_font_t * self,
     assert( self->atlas );
 
     /* Check if glyph_index has been already loaded */
-    if( (glyph = texture_font_find_glyph_gi( self, glyph_index )) )
+    if( (glyph = texture_font_get_loaded_glyph_gi( self, glyph_index )) )
         return glyph;
-
     /* Glyph has not been already loaded */
+    self->misses++;
     if( texture_font_load_glyph_gi( self, glyph_index, glyph_index ) )
-        return texture_font_find_glyph_gi( self, glyph_index );
+        glyph = texture_font_find_glyph_gi( self, glyph_index );
 
-    return NULL;
+    if( glyph )
+        glyph->last_used = self->frame;
+    return glyph;
+}
+
+// --------------------------------------- texture_font_get_loaded_glyph_gi ---
+texture_glyph_t *
+texture_font_get_loaded_glyph_gi( texture_font_t * self,
+                                  uint32_t glyph_index )
+{
+    texture_glyph_t *glyph;
+
+    assert( self );
+
+    if( (glyph = texture_font_find_glyph_gi( self, glyph_index )) ) {
+        self->hits++;
+        glyph->last_used = self->frame;
+    }
+    return glyph;
 }
 
 // ------------------------------------------  texture_font_enlarge_texture ---
@@ -1268,3 +1974,333 @@ texture_font_enlarge_atlas( texture_font_t * self, size_t width_new,
         texture_font_enlarge_glyphs( self, mulw, mulh );
     }
 }
+
+// ----------------------------------------------------------- cache format ---
+/* A cache file holds the key it was written for, then the glyphs with their
+ * kerning pairs, the slots aliasing them and the atlas. Fields are written
+ * as they are in memory, so a cache is only valid on the platform that wrote
+ * it. */
+#define FONT_CACHE_MAGIC   "FTGLCACH"
+#define FONT_CACHE_VERSION 1
+
+typedef struct {
+    uint64_t font_hash;
+    uint64_t font_bytes;
+    float size;
+    float outline_thickness;
+    uint32_t rendermode;
+    uint32_t sdf_method;
+    int32_t padding;
+    uint32_t atlas_width;
+    uint32_t atlas_height;
+    uint32_t atlas_depth;
+    unsigned char hinting;
+    unsigned char kerning;
+    unsigned char filtering;
+    unsigned char scaletex;
+    unsigned char lcd_weights[8];
+} font_cache_key_t;
+
+typedef struct {
+    uint32_t codepoint;
+    uint32_t width;
+    uint32_t height;
+    int32_t offset_x;
+    int32_t offset_y;
+    float advance_x;
+    float advance_y;
+    float s0;
+    float t0;
+    float s1;
+    float t1;
+    uint32_t page;
+    uint32_t rendermode;
+    float outline_thickness;
+    uint32_t kerning_count;
+} font_cache_glyph_t;
+
+typedef struct {
+    uint32_t codepoint;
+    uint32_t owner;
+    uint32_t rendermode;
+    float outline_thickness;
+} font_cache_alias_t;
+
+// ------------------------------------------------- texture_font_cache_key ---
+/* Hash the font bytes (64 bits FNV-1a) along with the settings glyphs are
+ * rendered with. Return 0 if the font file cannot be read. */
+static int
+texture_font_cache_key( const texture_font_t * self, font_cache_key_t * key )
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    unsigned char buffer[4096];
+    const unsigned char *bytes;
+    size_t count, i;
+    FILE *file = NULL;
+
+    memset( key, 0, sizeof(*key) );
+    if( self->location == TEXTURE_FONT_FILE ) {
+        file = fopen( self->filename, "rb" );
+        if( !file )
+            return 0;
+    } else {
+        bytes = (const unsigned char *) self->memory.base;
+        count = self->memory.size;
+    }
+    do {
+        if( file ) {
+            count = fread( buffer, 1, sizeof(buffer), file );
+            bytes = buffer;
+        }
+        for( i = 0; i < count; i++ ) {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3ull;
+        }
+        key->font_bytes += count;
+    } while( file && count == sizeof(buffer) );
+    if( file ) {
+        if( ferror( file ) ) {
+            fclose( file );
+            return 0;
+        }
+        fclose( file );
+    }
+
+    key->font_hash = hash;
+    key->size = self->size;
+    key->outline_thickness = self->outline_thickness;
+    key->rendermode = self->rendermode;
+    key->sdf_method = self->sdf_method;
+    key->padding = self->padding;
+    key->atlas_width = self->atlas->width;
+    key->atlas_height = self->atlas->height;
+    key->atlas_depth = self->atlas->depth;
+    key->hinting = self->hinting;
+    key->kerning = self->kerning;
+    key->filtering = self->filtering;
+    key->scaletex = self->scaletex;
+    memcpy( key->lcd_weights, self->lcd_weights, sizeof(self->lcd_weights) );
+    return 1;
+}
+
+// ------------------------------------------------ texture_font_save_cache ---
+int
+texture_font_save_cache( texture_font_t * self, const char * filename )
+{
+    font_cache_key_t key;
+    font_cache_glyph_t record;
+    font_cache_alias_t alias;
+    texture_glyph_slot_t *slot;
+    texture_glyph_t *glyph;
+    uint32_t version = FONT_CACHE_VERSION, counts[2] = { 0, 0 };
+    size_t i;
+    int success;
+    FILE *file;
+
+    assert( self );
+    assert( filename );
+
+    if( !texture_font_cache_key( self, &key ) )
+        return 0;
+    for( i = 0; i < self->glyphs->capacity; i++ ) {
+        if( self->glyphs->slots[i].glyph )
+            counts[self->glyphs->slots[i].alias]++;
+    }
+
+    file = fopen( filename, "wb" );
+    if( !file )
+        return 0;
+    success = fwrite( FONT_CACHE_MAGIC, 8, 1, file ) == 1 &&
+              fwrite( &version, sizeof(version), 1, file ) == 1 &&
+              fwrite( &key, sizeof(key), 1, file ) == 1 &&
+              fwrite( counts, sizeof(counts), 1, file ) == 1;
+
+    GLYPHS_ITERATOR(i, glyph, self->glyphs) {
+        if( !success )
+            break;
+        record.codepoint = glyph->codepoint;
+        record.width = glyph->width;
+        record.height = glyph->height;
+        record.offset_x = glyph->offset_x;
+        record.offset_y = glyph->offset_y;
+        record.advance_x = glyph->advance_x;
+        record.advance_y = glyph->advance_y;
+        record.s0 = glyph->s0;
+        record.t0 = glyph->t0;
+        record.s1 = glyph->s1;
+        record.t1 = glyph->t1;
+        record.page = glyph->page;
+        record.rendermode = glyph->rendermode;
+        record.outline_thickness = glyph->outline_thickness;
+        record.kerning_count = glyph->kerning->size;
+        success = fwrite( &record, sizeof(record), 1, file ) == 1 &&
+                  fwrite( glyph->kerning->items, sizeof(kerning_t),
+                          record.kerning_count, file ) == record.kerning_count;
+    } GLYPHS_ITERATOR_END
+
+    for( i = 0; success && i < self->glyphs->capacity; i++ ) {
+        slot = self->glyphs->slots + i;
+        if( !slot->glyph || !slot->alias )
+            continue;
+        alias.codepoint = slot->codepoint;
+        alias.owner = slot->glyph->codepoint;
+        alias.rendermode = slot->rendermode;
+        alias.outline_thickness = slot->glyph->outline_thickness;
+        success = fwrite( &alias, sizeof(alias), 1, file ) == 1;
+    }
+
+    success = success && texture_atlas_write( self->atlas, file );
+    if( fclose( file ) )
+        success = 0;
+    if( !success )
+        remove( filename );
+    return success;
+}
+
+// ------------------------------------------------ texture_font_cache_fits ---
+/* Whether a glyph read from a cache lies on one of the pages of its atlas,
+ * within the border texture_atlas_get_page_region leaves */
+static int
+texture_font_cache_fits( const texture_font_t * self,
+                         const texture_glyph_t * glyph,
+                         size_t pages )
+{
+    double x = glyph->s0, y = glyph->t0;
+
+    if( self->scaletex ) {
+        x *= self->atlas->width;
+        y *= self->atlas->height;
+    }
+    x = floor( x + 0.5 );
+    y = floor( y + 0.5 );
+    return glyph->page < pages &&
+           x >= 1 && x + glyph->width <= self->atlas->width - 1 &&
+           y >= 1 && y + glyph->height <= self->atlas->height - 1;
+}
+
+// ------------------------------------------------ texture_font_load_cache ---
+int
+texture_font_load_cache( texture_font_t * self, const char * filename )
+{
+    font_cache_key_t key, cached_key;
+    font_cache_glyph_t record;
+    font_cache_alias_t alias;
+    texture_glyph_map_t *glyphs;
+    texture_glyph_t *glyph = NULL, *owner;
+    char magic[8];
+    uint32_t version, counts[2], atlas_header[4];
+    size_t i;
+    long size, pos;
+    FILE *file;
+
+    assert( self );
+    assert( filename );
+
+    /* The whole atlas is replaced, which would lose the glyphs of any font */
+    if( !texture_atlas_is_empty( self->atlas ) ) {
+        freetype_gl_warning( Texture_Atlas_Not_Empty );
+        return 0;
+    }
+    file = fopen( filename, "rb" );
+    if( !file )
+        return 0;
+    if( fseek( file, 0, SEEK_END ) || (size = ftell( file )) < 0 ) {
+        fclose( file );
+        return 0;
+    }
+    rewind( file );
+    if( !texture_font_cache_key( self, &key ) ||
+        fread( magic, sizeof(magic), 1, file ) != 1 ||
+        fread( &version, sizeof(version), 1, file ) != 1 ||
+        fread( &cached_key, sizeof(cached_key), 1, file ) != 1 ||
+        fread( counts, sizeof(counts), 1, file ) != 1 ||
+        memcmp( magic, FONT_CACHE_MAGIC, sizeof(magic) ) ||
+        version != FONT_CACHE_VERSION ||
+        memcmp( &key, &cached_key, sizeof(key) ) ) {
+        freetype_gl_warning( Font_Cache_Mismatch );
+        fclose( file );
+        return 0;
+    }
+
+    /* Read into a new glyph map, so that the font stays as it is on failure */
+    glyphs = texture_glyph_map_new();
+    if( !glyphs ) {
+        fclose( file );
+        return 0;
+    }
+    for( i = 0; i < counts[0]; i++ ) {
+        if( fread( &record, sizeof(record), 1, file ) != 1 ||
+            !(glyph = texture_glyph_new()) )
+            goto cleanup;
+        glyph->codepoint = record.codepoint;
+        glyph->width = record.width;
+        glyph->height = record.height;
+        glyph->offset_x = record.offset_x;
+        glyph->offset_y = record.offset_y;
+        glyph->advance_x = record.advance_x;
+        glyph->advance_y = record.advance_y;
+        glyph->s0 = record.s0;
+        glyph->t0 = record.t0;
+        glyph->s1 = record.s1;
+        glyph->t1 = record.t1;
+        glyph->page = record.page;
+        glyph->rendermode = (rendermode_t) record.rendermode;
+        glyph->outline_thickness = record.outline_thickness;
+        glyph->last_used = self->frame;
+        /* Bound the count by what is left of the file before allocating */
+        if( (pos = ftell( file )) < 0 ||
+            record.kerning_count > (size_t)(size - pos) / sizeof(kerning_t) )
+            goto cleanup;
+        vector_resize( glyph->kerning, record.kerning_count );
+        if( fread( glyph->kerning->items, sizeof(kerning_t),
+                   record.kerning_count, file ) != record.kerning_count ||
+            texture_glyph_map_insert( glyphs, glyph->codepoint, glyph ) )
+            goto cleanup;
+        glyph = NULL;
+    }
+    for( i = 0; i < counts[1]; i++ ) {
+        if( fread( &alias, sizeof(alias), 1, file ) != 1 )
+            goto cleanup;
+        owner = texture_glyph_map_find( glyphs, alias.owner,
+                                        (rendermode_t) alias.rendermode,
+                                        alias.outline_thickness )->glyph;
+        if( !owner ||
+            texture_glyph_map_insert( glyphs, alias.codepoint, owner ) )
+            goto cleanup;
+    }
+
+    /* Check every glyph against the pages of the atlas that follows, which
+     * replaces the current one only once read */
+    if( (pos = ftell( file )) < 0 ||
+        fread( atlas_header, sizeof(atlas_header), 1, file ) != 1 ||
+        fseek( file, pos, SEEK_SET ) )
+        goto cleanup;
+    GLYPHS_ITERATOR(i, glyph, glyphs) {
+        if( !texture_font_cache_fits( self, glyph, atlas_header[3] ) ) {
+            glyph = NULL;
+            goto cleanup;
+        }
+    } GLYPHS_ITERATOR_END
+    glyph = NULL;
+    if( !texture_atlas_read( self->atlas, file ) )
+        goto cleanup;
+    fclose( file );
+
+    GLYPHS_ITERATOR(i, glyph, self->glyphs) {
+        texture_glyph_delete( glyph );
+    } GLYPHS_ITERATOR_END
+    texture_glyph_map_delete( self->glyphs );
+    self->glyphs = glyphs;
+    return 1;
+
+cleanup:
+    freetype_gl_warning( Font_Cache_Mismatch );
+    fclose( file );
+    if( glyph )
+        texture_glyph_delete( glyph );
+    GLYPHS_ITERATOR(i, glyph, glyphs) {
+        texture_glyph_delete( glyph );
+    } GLYPHS_ITERATOR_END
+    texture_glyph_map_delete( glyphs );
+    return 0;
+}
@@ -65,13 +65,34 @@ typedef enum rendermode_t
 } rendermode_t;
 
 /**
- * Glyph array end mark type
+ * A list of possible ways to compute a signed distance field.
  */
-typedef enum glyphmode_t
+typedef enum sdf_method_t
 {
-    GLYPH_END=0,
-    GLYPH_CONT=1
-} glyphmode_t;
+    SDF_EDTAA3,
+    SDF_DEAD_RECKONING
+} sdf_method_t;
+
+/**
+ * A structure that hold a kerning value relatively to a Unicode
+ * codepoint.
+ *
+ * This structure cannot be used alone since the (necessary) right
+ * Unicode codepoint is implicitly held by the owner of this structure.
+ */
+typedef struct kerning_t
+{
+    /**
+     * Left Unicode codepoint in the kern pair in UTF-32 LE encoding.
+     */
+    uint32_t codepoint;
+
+    /**
+     * Kerning value (in fractional pixels).
+     */
+    float kerning;
+
+} kerning_t;
 
 /*
  * Glyph metrics:
@@ -174,7 +195,18 @@ typedef struct texture_glyph_t
     float t1;
 
     /**
-     * A vector of kerning pairs relative to this glyph.
+     * Index of the atlas page holding the glyph image
+     */
+    size_t page;
+
+    /**
+     * Frame (see texture_font_t::frame) the glyph was last got in
+     */
+    size_t last_used;
+
+    /**
+     * A vector of kerning pairs relative to this glyph, sorted by
+     * codepoint. Only non-zero kerning values are stored.
      */
     vector_t * kerning;
 
@@ -188,12 +220,57 @@ typedef struct texture_glyph_t
      */
     float outline_thickness;
 
+} texture_glyph_t;
+
+/**
+ * A slot of a glyph map.
+ */
+typedef struct texture_glyph_slot_t
+{
+    /**
+     * Codepoint the glyph is indexed under
+     */
+    uint32_t codepoint;
+
     /**
-     * Glyph scan end mark
+     * Render mode of the indexed glyph, the outline thickness is the glyph's
      */
-    glyphmode_t glyphmode;
+    unsigned short rendermode;
 
-} texture_glyph_t;
+    /**
+     * Whether the glyph is owned by another slot (e.g. the glyph used for
+     * codepoints missing from the face is indexed under each of them)
+     */
+    unsigned short alias;
+
+    /**
+     * Indexed glyph, NULL for an empty slot
+     */
+    texture_glyph_t * glyph;
+} texture_glyph_slot_t;
+
+/**
+ * Open addressing hash map of glyphs, keyed on codepoint, render mode and
+ * outline thickness. Glyphs are allocated separately, so glyph pointers stay
+ * valid when the map grows.
+ */
+typedef struct texture_glyph_map_t
+{
+    /**
+     * Slots, linearly probed
+     */
+    texture_glyph_slot_t * slots;
+
+    /**
+     * Number of slots (always a power of two)
+     */
+    size_t capacity;
+
+    /**
+     * Number of used slots
+     */
+    size_t size;
+} texture_glyph_map_t;
 
 /**
  * Enum type for texture location
@@ -261,10 +338,9 @@ typedef struct texture_font_library_t
 typedef struct texture_font_t
 {
     /**
-     * Vector of glyphs contained in this font.
-     * This is actually a two-stage table, indexing into 256 glyphs each
+     * Glyphs contained in this font.
      */
-    vector_t * glyphs;
+    texture_glyph_map_t * glyphs;
 
     /**
      * Atlas structure to store glyphs data.
@@ -391,6 +467,12 @@ typedef struct texture_font_t
     */
     int padding;
 
+    /**
+     * How signed distance fields are computed: SDF_EDTAA3 (default) or the
+     * faster, single precision SDF_DEAD_RECKONING.
+     */
+    sdf_method_t sdf_method;
+
     /**
      * Flag for mode
      */
@@ -412,9 +494,46 @@ typedef struct texture_font_t
     hb_font_t* hb_font;
 
     /**
-     * factor to scale font coordinates
+     * factor to scale font coordinates. Only differs from 1 for fixed size
+     * fonts whose strike is smaller than the font size: glyphs of larger
+     * strikes are downscaled to the font size when loaded.
      */
     float scale;
+
+    /**
+     * Number of threads texture_font_load_glyphs_batch rasterizes glyphs on,
+     * each with a face of its own (1 by default). Only used when built with
+     * thread support.
+     */
+    size_t threads;
+
+    /**
+     * Whether to evict the least recently used glyphs when the atlas is
+     * full. Evicted glyphs are deleted, so vertices and pointers referring
+     * to them must not be used anymore. The atlas should be freeable.
+     */
+    unsigned char evict;
+
+    /**
+     * Current frame, to be advanced by the application once per frame.
+     * Glyphs got in the current frame are never evicted.
+     */
+    size_t frame;
+
+    /**
+     * Number of glyphs got that were already loaded
+     */
+    size_t hits;
+
+    /**
+     * Number of glyphs got that had to be loaded
+     */
+    size_t misses;
+
+    /**
+     * Number of glyphs evicted to make room in the atlas
+     */
+    size_t evictions;
 } texture_font_t;
 
 /**
@@ -555,7 +674,8 @@ typedef struct texture_font_t
 
 /**
  * Request a new glyph from the font. If it has not been created yet, it will
- * be.
+ * be, evicting the least recently used glyphs if the atlas is full and the
+ * font evicts glyphs. The glyph is stamped with the current frame.
  *
  * @param self      A valid texture font
  * @param codepoint Character codepoint to be loaded in UTF-8 encoding.
@@ -581,13 +701,18 @@ typedef struct texture_font_t
                           const char * codepoint );
     
 /** 
- * Index a glyph in a font
- * 
+ * Index a glyph in a font. The font takes ownership of the glyph, unless
+ * the glyph is already indexed under its own codepoint, in which case it
+ * is merely aliased.
+ *
  * @param self      A valid texture font
  * @param glyph     The glyph to index in the font
  * @param codepoint The codepoint to insert into
  *
- * @return          1 if glyph was copied, 0 if it was inserted
+ * @return          1 if another glyph is already indexed under codepoint
+ *                  with the same render mode and outline thickness (the
+ *                  font is left untouched), 0 if it was inserted, -1 if
+ *                  there was not enough memory to insert it
  */
 int
 texture_font_index_glyph( texture_font_t * self,
@@ -608,7 +733,8 @@ texture_font_load_glyph( texture_font_t * self,
 
 /**
  * Request a new glyph from the font. If it has not been created yet, it will
- * be.
+ * be, evicting the least recently used glyphs if the atlas is full and the
+ * font evicts glyphs. The glyph is stamped with the current frame.
  *
  * @param self        A valid texture font
  * @param glyph_index Font's character glyph index to be obtained
@@ -633,6 +759,20 @@ texture_glyph_t *
 texture_font_find_glyph_gi( texture_font_t * self,
 			    uint32_t glyph_index );
 
+/**
+ * Request an already loaded glyph from the font, counting a hit and stamping
+ * the glyph with the current frame as texture_font_get_glyph_gi does. A glyph
+ * not loaded yet is neither loaded nor counted as a miss.
+ *
+ * @param self         A valid texture font
+ * @param glyph_index  Font's character codepoint to be found
+ *
+ * @return A pointer on the glyph or 0 if the glyph is not loaded
+ */
+texture_glyph_t *
+texture_font_get_loaded_glyph_gi( texture_font_t * self,
+				  uint32_t glyph_index );
+
 /**
  * Request the loading of a given glyph.
  *
@@ -648,7 +788,9 @@ texture_font_load_glyph_gi( texture_font_t * self,
 			    uint32_t ucodepoint);
 
 /**
- * Request the loading of several glyphs at once.
+ * Request the loading of several glyphs at once. This is
+ * texture_font_load_glyphs_batch on the decoded string: glyphs are rasterized
+ * on self->threads threads and placed tallest first.
  *
  * @param self       A valid texture font
  * @param codepoints Character codepoints to be loaded in UTF-8 encoding. May
@@ -660,6 +802,27 @@ texture_font_load_glyph_gi( texture_font_t * self,
   size_t
   texture_font_load_glyphs( texture_font_t * self,
                             const char * codepoints );
+
+/**
+ * Request the loading of several glyphs at once. Every glyph is rasterized
+ * before any of them is placed in the atlas, tallest first, which packs them
+ * tighter than loading them one by one in the requested order. Glyphs are
+ * rasterized on self->threads threads.
+ *
+ * @param self       A valid texture font
+ * @param codepoints Character codepoints to be loaded. May contain
+ *                   duplicates.
+ * @param count      Number of codepoints
+ * @param loaded     If not NULL, count flags set to whether each codepoint
+ *                   could be loaded
+ *
+ * @return Number of missed glyphs
+ */
+  size_t
+  texture_font_load_glyphs_batch( texture_font_t * self,
+                                  const uint32_t * codepoints,
+                                  size_t count,
+                                  unsigned char * loaded );
 /**
  * Increases the size of a fonts texture atlas
  * Invalidates all pointers to font->atlas->data
@@ -697,6 +860,55 @@ texture_font_load_glyph_gi( texture_font_t * self,
   void
   texture_font_enlarge_texture( texture_font_t * self, size_t width_new,
 				size_t height_new );
+
+/**
+ * Get the memory used by the kerning pairs of the glyphs in a font.
+ *
+ * @param self A valid texture font
+ *
+ * @return number of bytes allocated for kerning pairs
+ */
+  size_t
+  texture_font_get_kerning_memory( const texture_font_t * self );
+
+/**
+ * Save the glyphs of a font, with their kerning pairs, and its atlas to a
+ * cache file, to be loaded back by texture_font_load_cache instead of
+ * rendering the glyphs again.
+ *
+ * The cache is keyed by a hash of the font bytes, the font size and the
+ * settings glyphs are rendered with (render mode, outline thickness,
+ * distance field method, hinting, kerning, filtering, LCD weights, padding
+ * and atlas size). It is only meant to be read on the platform that wrote
+ * it.
+ *
+ * @param self     A valid texture font
+ * @param filename Cache file name
+ *
+ * @return 1 on success, 0 if the cache could not be written
+ */
+  int
+  texture_font_save_cache( texture_font_t * self, const char * filename );
+
+/**
+ * Replace the glyphs of a font and the content of its atlas with the ones of
+ * a cache file written by texture_font_save_cache.
+ *
+ * Since the whole atlas is replaced, the cache is only loaded in an empty
+ * atlas (see texture_atlas_is_empty), typically a new one, before this
+ * font or any other font sharing the atlas rendered a glyph into it. Other
+ * fonts sharing the atlas then render their glyphs around the cached ones.
+ *
+ * @param self     A valid texture font
+ * @param filename Cache file name
+ *
+ * @return 1 on success, 0 if there is no cache, it does not match the font
+ *         and its settings or the atlas is not empty (the font and its atlas
+ *         are then left unchanged)
+ */
+  int
+  texture_font_load_cache( texture_font_t * self, const char * filename );
+
 /**
  * Get the kerning between two horizontal glyphs.
  *
@@ -709,6 +921,19 @@ float
 texture_glyph_get_kerning( const texture_glyph_t * self,
                            const char * codepoint );
 
+/**
+ * Get the kerning between two horizontal glyphs, the preceding character
+ * being already decoded.
+ *
+ * @param self      A valid texture glyph
+ * @param codepoint Character codepoint of the preceding character
+ *
+ * @return x kerning value
+ */
+float
+texture_glyph_get_kerning_gi( const texture_glyph_t * self,
+                              uint32_t codepoint );
+
 
 /**
  * Creates a new empty glyph
@@ -736,21 +961,15 @@ texture_glyph_clone( texture_glyph_t* self );
 
 /** @} */
 
-#define GLYPHS_ITERATOR1(index, name, glyph) \
-    for( index = 0; index < vector_size ( glyph ); index++ ) { \
-	texture_glyph_t ** __glyphs;
-#define GLYPHS_ITERATOR2(index, name, glyph) \
-	if(( __glyphs = *(texture_glyph_t *** ) vector_get ( glyph, index ) )) { \
-	    int __i;							\
-	    for( __i = 0; __i < 0x100; __i++ ) {			\
-		if(( name = __glyphs[__i] ))
-#define GLYPHS_ITERATOR(index, name, glyph) \
-    GLYPHS_ITERATOR1(index, name, glyph)		\
-	GLYPHS_ITERATOR2(index, name, glyph)
-
-#define GLYPHS_ITERATOR_END1 }
-#define GLYPHS_ITERATOR_END2 } }
-#define GLYPHS_ITERATOR_END } } }
+/**
+ * Iterate over the glyphs owned by a glyph map.
+ */
+#define GLYPHS_ITERATOR(index, name, glyphs) \
+    for( index = 0; index < (glyphs)->capacity; index++ ) { \
+        if(( name = (glyphs)->slots[index].glyph ) && \
+           !(glyphs)->slots[index].alias )
+
+#define GLYPHS_ITERATOR_END }
 
 #ifdef __cplusplus
 }
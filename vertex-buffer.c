@@ -20,6 +20,94 @@
 #define FROZEN (2)
 
 
+#ifdef FREETYPE_GL_USE_MULTI_DRAW_INDIRECT
+/**
+ * Indirect draw command, as glMultiDrawElementsIndirect reads it. Draws
+ * without indices use the first four fields, with first_index as first
+ * vertex and base_vertex as base instance.
+ */
+typedef struct
+{
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint  base_vertex;
+    GLuint base_instance;
+} draw_command_t;
+#endif
+
+
+// ----------------------------------------------------------------------------
+// vertex_buffer_add_range (internal use only)
+//
+// Adds first to last (excluded) to sorted and disjoint ranges, merging the
+// ones it overlaps or touches. Past VERTEX_BUFFER_MAX_RANGES, the two
+// closest ranges are merged, at the cost of uploading the gap between them.
+//
+static void
+vertex_buffer_add_range( vertex_buffer_range_t * ranges, size_t * count,
+                         size_t first, size_t last )
+{
+    vertex_buffer_range_t merged[VERTEX_BUFFER_MAX_RANGES+1];
+    size_t i, j, k, n = 0, best;
+
+    if( first >= last )
+    {
+        return;
+    }
+
+    // Appending to the last range is the common case
+    if( *count && ranges[*count-1].first <= first &&
+        ranges[*count-1].last >= first )
+    {
+        if( last > ranges[*count-1].last )
+        {
+            ranges[*count-1].last = last;
+        }
+        return;
+    }
+
+    for( i=0; i<*count && ranges[i].last < first; ++i );
+    for( j=i; j<*count && ranges[j].first <= last; ++j )
+    {
+        if( ranges[j].first < first ) first = ranges[j].first;
+        if( ranges[j].last > last )   last  = ranges[j].last;
+    }
+    for( k=0; k<i; ++k )
+    {
+        merged[n++] = ranges[k];
+    }
+    merged[n].first = first;
+    merged[n].last = last;
+    ++n;
+    for( k=j; k<*count; ++k )
+    {
+        merged[n++] = ranges[k];
+    }
+
+    if( n > VERTEX_BUFFER_MAX_RANGES )
+    {
+        best = 0;
+        for( k=1; k+1<n; ++k )
+        {
+            if( merged[k+1].first - merged[k].last <
+                merged[best+1].first - merged[best].last )
+            {
+                best = k;
+            }
+        }
+        merged[best].last = merged[best+1].last;
+        for( k=best+1; k+1<n; ++k )
+        {
+            merged[k] = merged[k+1];
+        }
+        --n;
+    }
+    memcpy( ranges, merged, n*sizeof(vertex_buffer_range_t) );
+    *count = n;
+}
+
+
 // ----------------------------------------------------------------------------
 vertex_buffer_t *
 vertex_buffer_new( const char *format )
@@ -96,6 +184,16 @@ vertex_buffer_new( const char *format )
     self->indices = vector_new( sizeof(GLuint) );
     self->indices_id  = 0;
     self->GPU_isize = 0;
+    self->GPU_itype = GL_UNSIGNED_INT;
+    self->short_indices = 0;
+    self->narrowed_indices = NULL;
+
+    self->dirty_vertices_count = 0;
+    self->dirty_indices_count = 0;
+
+    self->max_waste = 0;
+    self->dead_vertices = 0;
+    self->dead_indices = 0;
 
     self->items = vector_new( sizeof(ivec4) );
     self->state = DIRTY;
@@ -144,6 +242,10 @@ vertex_buffer_delete( vertex_buffer_t *self )
         glDeleteBuffers( 1, &self->indices_id );
     }
     self->indices_id = 0;
+    if( self->narrowed_indices )
+    {
+        vector_delete( self->narrowed_indices );
+    }
 
     vector_delete( self->items );
 
@@ -224,12 +326,217 @@ vertex_buffer_print( vertex_buffer_t * self )
 }
 
 
+// ----------------------------------------------------------------------------
+// vertex_buffer_plan_upload (internal use only)
+//
+// Transfers of one vector: the whole vector into new storage when it does
+// not fit in the current one, its dirty ranges otherwise
+//
+static size_t
+vertex_buffer_plan_upload( GLenum target, const vector_t * vector,
+                           size_t GPU_size,
+                           const vertex_buffer_range_t * ranges,
+                           size_t count,
+                           vertex_buffer_transfer_t * transfers )
+{
+    size_t size = vector->size * vector->item_size;
+    size_t i, n = 0;
+
+    if( size > GPU_size )
+    {
+        transfers[0].target = target;
+        transfers[0].allocate = vector->capacity * vector->item_size;
+        transfers[0].offset = 0;
+        transfers[0].size = size;
+        transfers[0].data = vector->items;
+        return 1;
+    }
+    for( i=0; i<count; ++i )
+    {
+        size_t last = ranges[i].last < vector->size ? ranges[i].last
+                                                    : vector->size;
+        if( ranges[i].first >= last )
+        {
+            continue;
+        }
+        transfers[n].target = target;
+        transfers[n].allocate = 0;
+        transfers[n].offset = ranges[i].first * vector->item_size;
+        transfers[n].size = (last - ranges[i].first) * vector->item_size;
+        transfers[n].data = (const char *) vector->items +
+                            transfers[n].offset;
+        ++n;
+    }
+    return n;
+}
+
+
+// ----------------------------------------------------------------------------
+// vertex_buffer_narrow_indices (internal use only)
+//
+// Replaces transfers of GLuint indices with transfers of the same indices
+// narrowed to 16-bit
+//
+static void
+vertex_buffer_narrow_indices( vertex_buffer_t *self,
+                              vertex_buffer_transfer_t *transfers,
+                              size_t count )
+{
+    GLushort * dst;
+    size_t i, j, n = 0;
+
+    for( i=0; i<count; ++i )
+    {
+        n += transfers[i].size / sizeof(GLuint);
+    }
+    vector_resize( self->narrowed_indices, n );
+    dst = (GLushort *) self->narrowed_indices->items;
+    for( i=0; i<count; ++i )
+    {
+        const GLuint * src = (const GLuint *) transfers[i].data;
+
+        n = transfers[i].size / sizeof(GLuint);
+        for( j=0; j<n; ++j )
+        {
+            dst[j] = (GLushort) src[j];
+        }
+        transfers[i].allocate = transfers[i].allocate / 2;
+        transfers[i].offset = transfers[i].offset / 2;
+        transfers[i].size = transfers[i].size / 2;
+        transfers[i].data = dst;
+        dst += n;
+    }
+}
+
+
+// ----------------------------------------------------------------------------
+// vertex_buffer_index_size (internal use only)
+//
+// Size of an index in GPU memory
+//
+static size_t
+vertex_buffer_index_size( const vertex_buffer_t *self )
+{
+    return self->GPU_itype == GL_UNSIGNED_SHORT ? sizeof(GLushort)
+                                                : sizeof(GLuint);
+}
+
+
 // ----------------------------------------------------------------------------
 void
-vertex_buffer_upload ( vertex_buffer_t *self )
+vertex_buffer_upload_with( vertex_buffer_t *self,
+                           void (*transfer)( vertex_buffer_t *self,
+                                      const vertex_buffer_transfer_t *transfer,
+                                      void *data ),
+                           void *data )
 {
-    size_t vsize, isize;
+    vertex_buffer_transfer_t transfers[2*VERTEX_BUFFER_MAX_RANGES];
+    size_t vcount, icount, i;
+    GLenum itype = self->GPU_itype;
+
+    assert( self );
+    assert( transfer );
+
+    // 16-bit indices while they can address all vertices, going back to
+    // them from GPU storage only well below the limit so that a buffer
+    // around it is not uploaded again each time
+    if( !self->short_indices || self->vertices->size > 65536 )
+    {
+        itype = GL_UNSIGNED_INT;
+    }
+    else if( self->vertices->size <= 32768 || !self->GPU_isize )
+    {
+        itype = GL_UNSIGNED_SHORT;
+    }
+    if( itype != self->GPU_itype )
+    {
+        self->GPU_itype = itype;
+        self->GPU_isize = 0;
+    }
 
+    // A buffer set dirty by hand, without invalidating what changed, is
+    // uploaded whole
+    if( self->state & DIRTY &&
+        !self->dirty_vertices_count && !self->dirty_indices_count )
+    {
+        vertex_buffer_add_range( self->dirty_vertices,
+                                 &self->dirty_vertices_count,
+                                 0, self->vertices->size );
+        vertex_buffer_add_range( self->dirty_indices,
+                                 &self->dirty_indices_count,
+                                 0, self->indices->size );
+    }
+
+    // Always upload vertices first such that indices do not point to non
+    // existing data (if we get interrupted in between for example).
+    vcount = vertex_buffer_plan_upload( GL_ARRAY_BUFFER, self->vertices,
+                                        self->GPU_vsize,
+                                        self->dirty_vertices,
+                                        self->dirty_vertices_count,
+                                        transfers );
+    icount = vertex_buffer_plan_upload( GL_ELEMENT_ARRAY_BUFFER,
+                                        self->indices,
+                                        self->GPU_isize /
+                                        vertex_buffer_index_size( self ) *
+                                        sizeof(GLuint),
+                                        self->dirty_indices,
+                                        self->dirty_indices_count,
+                                        transfers + vcount );
+    if( itype == GL_UNSIGNED_SHORT )
+    {
+        vertex_buffer_narrow_indices( self, transfers + vcount, icount );
+    }
+    for( i=0; i<vcount+icount; ++i )
+    {
+        transfer( self, &transfers[i], data );
+        if( transfers[i].allocate &&
+            transfers[i].target == GL_ARRAY_BUFFER )
+        {
+            self->GPU_vsize = transfers[i].allocate;
+        }
+        else if( transfers[i].allocate )
+        {
+            self->GPU_isize = transfers[i].allocate;
+        }
+    }
+    self->dirty_vertices_count = 0;
+    self->dirty_indices_count = 0;
+    self->state = CLEAN;
+}
+
+
+// ----------------------------------------------------------------------------
+// vertex_buffer_transfer (internal use only)
+//
+// OpenGL backend of vertex_buffer_upload
+//
+static void
+vertex_buffer_transfer( vertex_buffer_t *self,
+                        const vertex_buffer_transfer_t *transfer,
+                        void *data )
+{
+    (void) data;
+    glBindBuffer( transfer->target,
+                  transfer->target == GL_ARRAY_BUFFER ? self->vertices_id
+                                                      : self->indices_id );
+    if( transfer->allocate )
+    {
+        glBufferData( transfer->target,
+                      transfer->allocate, NULL, GL_DYNAMIC_DRAW );
+    }
+    if( transfer->size )
+    {
+        glBufferSubData( transfer->target,
+                         transfer->offset, transfer->size, transfer->data );
+    }
+    glBindBuffer( transfer->target, 0 );
+}
+
+
+// ----------------------------------------------------------------------------
+void
+vertex_buffer_upload ( vertex_buffer_t *self )
+{
     if( self->state == FROZEN )
     {
         return;
@@ -244,42 +551,43 @@ vertex_buffer_upload ( vertex_buffer_t *self )
         glGenBuffers( 1, &self->indices_id );
     }
 
-    vsize = self->vertices->size*self->vertices->item_size;
-    isize = self->indices->size*self->indices->item_size;
+    vertex_buffer_upload_with( self, vertex_buffer_transfer, NULL );
+}
 
 
-    // Always upload vertices first such that indices do not point to non
-    // existing data (if we get interrupted in between for example).
 
-    // Upload vertices
-    glBindBuffer( GL_ARRAY_BUFFER, self->vertices_id );
-    if( vsize != self->GPU_vsize )
-    {
-        glBufferData( GL_ARRAY_BUFFER,
-                      vsize, self->vertices->items, GL_DYNAMIC_DRAW );
-        self->GPU_vsize = vsize;
-    }
-    else
-    {
-        glBufferSubData( GL_ARRAY_BUFFER,
-                         0, vsize, self->vertices->items );
-    }
-    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+// ----------------------------------------------------------------------------
+void
+vertex_buffer_invalidate_vertices( vertex_buffer_t *self,
+                                   const size_t first, const size_t last )
+{
+    assert( self );
+    assert( last <= self->vertices->size );
 
-    // Upload indices
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, self->indices_id );
-    if( isize != self->GPU_isize )
+    if( first < last )
     {
-        glBufferData( GL_ELEMENT_ARRAY_BUFFER,
-                      isize, self->indices->items, GL_DYNAMIC_DRAW );
-        self->GPU_isize = isize;
+        self->state |= DIRTY;
     }
-    else
+    vertex_buffer_add_range( self->dirty_vertices,
+                             &self->dirty_vertices_count, first, last );
+}
+
+
+
+// ----------------------------------------------------------------------------
+void
+vertex_buffer_invalidate_indices( vertex_buffer_t *self,
+                                  const size_t first, const size_t last )
+{
+    assert( self );
+    assert( last <= self->indices->size );
+
+    if( first < last )
     {
-        glBufferSubData( GL_ELEMENT_ARRAY_BUFFER,
-                         0, isize, self->indices->items );
+        self->state |= DIRTY;
     }
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+    vertex_buffer_add_range( self->dirty_indices,
+                             &self->dirty_indices_count, first, last );
 }
 
 
@@ -294,6 +602,10 @@ vertex_buffer_clear( vertex_buffer_t *self )
     vector_clear( self->indices );
     vector_clear( self->vertices );
     vector_clear( self->items );
+    self->dirty_vertices_count = 0;
+    self->dirty_indices_count = 0;
+    self->dead_vertices = 0;
+    self->dead_indices = 0;
     self->state = DIRTY;
 }
 
@@ -404,6 +716,71 @@ vertex_buffer_render_finish ( vertex_buffer_t *self )
 }
 
 
+#ifdef FREETYPE_GL_USE_INSTANCING
+// ----------------------------------------------------------------------------
+void
+vertex_buffer_render_instanced ( vertex_buffer_t *self,
+                                 vertex_buffer_t *instances,
+                                 GLenum mode )
+{
+    size_t vcount = self->vertices->size;
+    size_t icount = self->indices->size;
+    size_t count = instances->vertices->size;
+    size_t i;
+
+    assert( self );
+    assert( instances );
+
+#ifdef FREETYPE_GL_USE_VAO
+    // Do not upload into the element array binding of a bound VAO
+    glBindVertexArray( 0 );
+#endif
+    if( instances->state != CLEAN )
+    {
+        vertex_buffer_upload( instances );
+        instances->state = CLEAN;
+    }
+
+    vertex_buffer_render_setup( self, mode );
+
+    glBindBuffer( GL_ARRAY_BUFFER, instances->vertices_id );
+    for( i=0; i<MAX_VERTEX_ATTRIBUTE; ++i )
+    {
+        vertex_attribute_t *attribute = instances->attributes[i];
+        if( attribute == 0 )
+        {
+            continue;
+        }
+        vertex_attribute_enable( attribute );
+        if( attribute->index != (GLuint) -1 )
+        {
+            glVertexAttribDivisor( attribute->index, 1 );
+        }
+    }
+
+    if( icount )
+    {
+        glDrawElementsInstanced( mode, icount, self->GPU_itype, 0, count );
+    }
+    else
+    {
+        glDrawArraysInstanced( mode, 0, vcount, count );
+    }
+
+    // Leave attributes as vertex_buffer_render expects them
+    for( i=0; i<MAX_VERTEX_ATTRIBUTE; ++i )
+    {
+        vertex_attribute_t *attribute = instances->attributes[i];
+        if( attribute != 0 && attribute->index != (GLuint) -1 )
+        {
+            glVertexAttribDivisor( attribute->index, 0 );
+            glDisableVertexAttribArray( attribute->index );
+        }
+    }
+    vertex_buffer_render_finish( self );
+}
+#endif
+
 // ----------------------------------------------------------------------------
 void
 vertex_buffer_render_item ( vertex_buffer_t *self,
@@ -418,13 +795,14 @@ vertex_buffer_render_item ( vertex_buffer_t *self,
     {
         size_t start = item->istart;
         size_t count = item->icount;
-        glDrawElements( self->mode, count, GL_UNSIGNED_INT, (void *)(start*sizeof(GLuint)) );
+        glDrawElements( self->mode, count, self->GPU_itype,
+                        (void *)(start*vertex_buffer_index_size( self )) );
     }
     else if( self->vertices->size )
     {
         size_t start = item->vstart;
         size_t count = item->vcount;
-        glDrawArrays( self->mode, start*self->vertices->item_size, count);
+        glDrawArrays( self->mode, start, count );
     }
 }
 
@@ -439,7 +817,7 @@ vertex_buffer_render ( vertex_buffer_t *self, GLenum mode )
     vertex_buffer_render_setup( self, mode );
     if( icount )
     {
-        glDrawElements( mode, icount, GL_UNSIGNED_INT, 0 );
+        glDrawElements( mode, icount, self->GPU_itype, 0 );
     }
     else
     {
@@ -450,6 +828,235 @@ vertex_buffer_render ( vertex_buffer_t *self, GLenum mode )
 
 
 
+// ----------------------------------------------------------------------------
+vertex_buffer_batch_t *
+vertex_buffer_batch_new( void )
+{
+    vertex_buffer_batch_t * batch =
+        (vertex_buffer_batch_t *) malloc( sizeof(vertex_buffer_batch_t) );
+    if( !batch )
+    {
+        freetype_gl_error( Out_Of_Memory );
+        return NULL;
+    }
+    batch->items = vector_new( sizeof(ivec2) );
+    batch->counts = vector_new( sizeof(GLsizei) );
+    batch->firsts = vector_new( sizeof(GLint) );
+    batch->base_vertices = vector_new( sizeof(GLint) );
+    batch->offsets = vector_new( sizeof(GLvoid *) );
+#ifdef FREETYPE_GL_USE_MULTI_DRAW_INDIRECT
+    batch->commands = vector_new( sizeof(draw_command_t) );
+    batch->commands_id = 0;
+    batch->GPU_csize = 0;
+#endif
+    return batch;
+}
+
+
+// ----------------------------------------------------------------------------
+void
+vertex_buffer_batch_delete( vertex_buffer_batch_t * batch )
+{
+    assert( batch );
+
+    vector_delete( batch->items );
+    vector_delete( batch->counts );
+    vector_delete( batch->firsts );
+    vector_delete( batch->base_vertices );
+    vector_delete( batch->offsets );
+#ifdef FREETYPE_GL_USE_MULTI_DRAW_INDIRECT
+    vector_delete( batch->commands );
+    if( batch->commands_id )
+    {
+        glDeleteBuffers( 1, &batch->commands_id );
+    }
+#endif
+    free( batch );
+}
+
+
+// ----------------------------------------------------------------------------
+void
+vertex_buffer_batch_clear( vertex_buffer_batch_t * batch )
+{
+    assert( batch );
+
+    vector_clear( batch->items );
+}
+
+
+// ----------------------------------------------------------------------------
+void
+vertex_buffer_batch_add( vertex_buffer_batch_t * batch,
+                         const size_t index, const int base_vertex )
+{
+    ivec2 item;
+    assert( batch );
+
+    item.x = index;
+    item.y = base_vertex;
+    vector_push_back( batch->items, &item );
+}
+
+
+// ----------------------------------------------------------------------------
+size_t
+vertex_buffer_batch_build( vertex_buffer_batch_t * batch,
+                           const vertex_buffer_t * self )
+{
+    int indexed = self->indices->size != 0;
+    size_t i, n = 0;
+    GLsizei * counts;
+    GLint * firsts, * bases;
+
+    assert( batch );
+    assert( self );
+
+    vector_resize( batch->counts, vector_size( batch->items ) );
+    vector_resize( batch->firsts, vector_size( batch->items ) );
+    vector_resize( batch->base_vertices, vector_size( batch->items ) );
+    counts = (GLsizei *) batch->counts->items;
+    firsts = (GLint *) batch->firsts->items;
+    bases = (GLint *) batch->base_vertices->items;
+
+    for( i=0; i<vector_size( batch->items ); ++i )
+    {
+        const ivec2 * entry = (const ivec2 *) vector_get( batch->items, i );
+        const ivec4 * item;
+        GLint first, base = indexed ? entry->y : 0;
+        GLsizei count;
+
+        assert( (size_t) entry->x < vector_size( self->items ) );
+        item = (const ivec4 *) vector_get( self->items, entry->x );
+        first = indexed ? item->istart : item->vstart + entry->y;
+        count = indexed ? item->icount : item->vcount;
+        if( count == 0 )
+        {
+            continue;
+        }
+        if( n && bases[n-1] == base && firsts[n-1] + counts[n-1] == first )
+        {
+            counts[n-1] += count;
+            continue;
+        }
+        counts[n] = count;
+        firsts[n] = first;
+        bases[n] = base;
+        ++n;
+    }
+    batch->counts->size = n;
+    batch->firsts->size = n;
+    batch->base_vertices->size = n;
+    return n;
+}
+
+
+// ----------------------------------------------------------------------------
+void
+vertex_buffer_render_batch( vertex_buffer_t *self,
+                            vertex_buffer_batch_t *batch,
+                            GLenum mode )
+{
+    int indexed = self->indices->size != 0;
+    size_t count, i;
+    GLsizei * counts;
+    GLint * firsts, * bases;
+
+    assert( self );
+    assert( batch );
+
+    count = vertex_buffer_batch_build( batch, self );
+    if( count == 0 )
+    {
+        return;
+    }
+    counts = (GLsizei *) batch->counts->items;
+    firsts = (GLint *) batch->firsts->items;
+    bases = (GLint *) batch->base_vertices->items;
+
+    vertex_buffer_render_setup( self, mode );
+#if defined(FREETYPE_GL_USE_MULTI_DRAW_INDIRECT)
+    {
+        draw_command_t * commands;
+        size_t size = count * sizeof(draw_command_t);
+
+        vector_resize( batch->commands, count );
+        commands = (draw_command_t *) batch->commands->items;
+        for( i=0; i<count; ++i )
+        {
+            commands[i].count = counts[i];
+            commands[i].instance_count = 1;
+            commands[i].first_index = firsts[i];
+            commands[i].base_vertex = bases[i];
+            commands[i].base_instance = 0;
+        }
+        if( !batch->commands_id )
+        {
+            glGenBuffers( 1, &batch->commands_id );
+        }
+        glBindBuffer( GL_DRAW_INDIRECT_BUFFER, batch->commands_id );
+        if( size > batch->GPU_csize )
+        {
+            glBufferData( GL_DRAW_INDIRECT_BUFFER,
+                          size, commands, GL_STREAM_DRAW );
+            batch->GPU_csize = size;
+        }
+        else
+        {
+            glBufferSubData( GL_DRAW_INDIRECT_BUFFER, 0, size, commands );
+        }
+        if( indexed )
+        {
+            glMultiDrawElementsIndirect( mode, self->GPU_itype, 0, count,
+                                         sizeof(draw_command_t) );
+        }
+        else
+        {
+            glMultiDrawArraysIndirect( mode, 0, count,
+                                       sizeof(draw_command_t) );
+        }
+        glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+    }
+#elif defined(FREETYPE_GL_USE_MULTI_DRAW)
+    if( indexed )
+    {
+        const GLvoid ** offsets;
+
+        vector_resize( batch->offsets, count );
+        offsets = (const GLvoid **) batch->offsets->items;
+        for( i=0; i<count; ++i )
+        {
+            offsets[i] = (const GLvoid *)
+                         ( firsts[i] * vertex_buffer_index_size( self ) );
+        }
+        glMultiDrawElementsBaseVertex( mode, counts, self->GPU_itype,
+                                       offsets, count, bases );
+    }
+    else
+    {
+        glMultiDrawArrays( mode, firsts, counts, count );
+    }
+#else
+    for( i=0; i<count; ++i )
+    {
+        assert( bases[i] == 0 );
+        if( indexed )
+        {
+            glDrawElements( mode, counts[i], self->GPU_itype,
+                            (const GLvoid *)
+                            ( firsts[i] * vertex_buffer_index_size( self ) ) );
+        }
+        else
+        {
+            glDrawArrays( mode, firsts[i], counts[i] );
+        }
+    }
+#endif
+    vertex_buffer_render_finish( self );
+}
+
+
+
 // ----------------------------------------------------------------------------
 void
 vertex_buffer_push_back_indices ( vertex_buffer_t * self,
@@ -458,8 +1065,9 @@ vertex_buffer_push_back_indices ( vertex_buffer_t * self,
 {
     assert( self );
 
-    self->state |= DIRTY;
     vector_push_back_data( self->indices, indices, icount );
+    vertex_buffer_invalidate_indices( self, self->indices->size - icount,
+                                      self->indices->size );
 }
 
 
@@ -472,8 +1080,9 @@ vertex_buffer_push_back_vertices ( vertex_buffer_t * self,
 {
     assert( self );
 
-    self->state |= DIRTY;
     vector_push_back_data( self->vertices, vertices, vcount );
+    vertex_buffer_invalidate_vertices( self, self->vertices->size - vcount,
+                                       self->vertices->size );
 }
 
 
@@ -489,8 +1098,8 @@ vertex_buffer_insert_indices ( vertex_buffer_t *self,
     assert( self->indices );
     assert( index < self->indices->size+1 );
 
-    self->state |= DIRTY;
     vector_insert_data( self->indices, index, indices, count );
+    vertex_buffer_invalidate_indices( self, index, self->indices->size );
 }
 
 
@@ -507,17 +1116,17 @@ vertex_buffer_insert_vertices( vertex_buffer_t *self,
     assert( self->vertices );
     assert( index < self->vertices->size+1 );
 
-    self->state |= DIRTY;
-
      for( i=0; i<self->indices->size; ++i )
     {
         if( *(GLuint *)(vector_get( self->indices, i )) > index )
         {
             *(GLuint *)(vector_get( self->indices, i )) += index;
+            vertex_buffer_invalidate_indices( self, i, i+1 );
         }
     }
 
     vector_insert_data( self->vertices, index, vertices, vcount );
+    vertex_buffer_invalidate_vertices( self, index, self->vertices->size );
 }
 
 
@@ -533,8 +1142,8 @@ vertex_buffer_erase_indices( vertex_buffer_t *self,
     assert( first < self->indices->size );
     assert( (last) <= self->indices->size );
 
-    self->state |= DIRTY;
     vector_erase_range( self->indices, first, last );
+    vertex_buffer_invalidate_indices( self, first, self->indices->size );
 }
 
 
@@ -545,25 +1154,98 @@ vertex_buffer_erase_vertices( vertex_buffer_t *self,
                               const size_t first,
                               const size_t last )
 {
-    size_t i;
+    GLuint * indices;
+    size_t i, lo = (size_t)-1, hi = 0;
     assert( self );
     assert( self->vertices );
     assert( first < self->vertices->size );
     assert( last <= self->vertices->size );
     assert( last > first );
 
-    self->state |= DIRTY;
+    indices = (GLuint *) self->indices->items;
     for( i=0; i<self->indices->size; ++i )
     {
-        if( *(GLuint *)(vector_get( self->indices, i )) > first )
+        if( indices[i] > first )
         {
-            *(GLuint *)(vector_get( self->indices, i )) -= (last-first);
+            indices[i] -= (last-first);
+            if( i < lo ) lo = i;
+            hi = i+1;
         }
     }
+    vertex_buffer_invalidate_indices( self, lo, hi );
     vector_erase_range( self->vertices, first, last );
+    vertex_buffer_invalidate_vertices( self, first, self->vertices->size );
+}
+
+
+
+// ------------------------------------------- vertex_buffer_push_back_item ---
+size_t
+vertex_buffer_push_back_item( vertex_buffer_t * self,
+                              const size_t vstart, const size_t vcount,
+                              const size_t istart, const size_t icount )
+{
+    ivec4 item;
+    item.x = vstart;
+    item.y = vcount;
+    item.z = istart;
+    item.w = icount;
+    vertex_buffer_insert_items( self, vector_size( self->items ), &item, 1 );
+    return vector_size( self->items ) - 1;
 }
 
 
+// --------------------------------------------- vertex_buffer_insert_items ---
+void
+vertex_buffer_insert_items( vertex_buffer_t * self, const size_t index,
+                            const ivec4 * items, const size_t count )
+{
+    size_t vfirst, vlast, ifirst, ilast, i;
+    assert( self );
+    assert( index <= vector_size( self->items ) );
+
+    for( i=0; i<count; ++i )
+    {
+        assert( (size_t)( items[i].vstart + items[i].vcount ) <=
+                vector_size( self->vertices ) );
+        assert( (size_t)( items[i].istart + items[i].icount ) <=
+                vector_size( self->indices ) );
+    }
+    if( count == 0 )
+    {
+        return;
+    }
+    if( index == vector_size( self->items ) )
+    {
+        vector_push_back_data( self->items, items, count );
+    }
+    else
+    {
+        vector_insert_data( self->items, index, items, count );
+    }
+
+    // Data of consecutive items is usually contiguous
+    vfirst = vlast = items[0].vstart;
+    ifirst = ilast = items[0].istart;
+    for( i=0; i<count; ++i )
+    {
+        if( (size_t) items[i].vstart != vlast )
+        {
+            vertex_buffer_invalidate_vertices( self, vfirst, vlast );
+            vfirst = vlast = items[i].vstart;
+        }
+        if( (size_t) items[i].istart != ilast )
+        {
+            vertex_buffer_invalidate_indices( self, ifirst, ilast );
+            ifirst = ilast = items[i].istart;
+        }
+        vlast += items[i].vcount;
+        ilast += items[i].icount;
+    }
+    vertex_buffer_invalidate_vertices( self, vfirst, vlast );
+    vertex_buffer_invalidate_indices( self, ifirst, ilast );
+}
+
 
 // ----------------------------------------------------------------------------
 size_t
@@ -583,10 +1265,12 @@ vertex_buffer_insert( vertex_buffer_t * self, const size_t index,
 {
     size_t vstart, istart, i;
     ivec4 item;
+    char state;
     assert( self );
     assert( vertices );
     assert( indices );
 
+    state = self->state;
     self->state = FROZEN;
 
     // Push back vertices
@@ -610,10 +1294,170 @@ vertex_buffer_insert( vertex_buffer_t * self, const size_t index,
     item.w = icount;
     vector_insert( self->items, index, &item );
 
-    self->state = DIRTY;
+    self->state = state | (self->state & DIRTY);
     return index;
 }
 
+// ----------------------------------------------------------------------------
+// vertex_buffer_bury (internal use only)
+//
+// Leaves the data of an item in place with degenerate indices, or drops it
+// when it is at the end of both vectors
+//
+static void
+vertex_buffer_bury( vertex_buffer_t * self, const ivec4 * item )
+{
+    GLuint * indices = (GLuint *) self->indices->items + item->istart;
+    size_t i;
+
+    if( (size_t) (item->vstart + item->vcount) == self->vertices->size &&
+        (size_t) (item->istart + item->icount) == self->indices->size )
+    {
+        self->vertices->size = item->vstart;
+        self->indices->size = item->istart;
+        return;
+    }
+    for( i=1; i<(size_t) item->icount; ++i )
+    {
+        indices[i] = indices[0];
+    }
+    vertex_buffer_invalidate_indices( self, item->istart,
+                                      item->istart + item->icount );
+    self->dead_vertices += item->vcount;
+    self->dead_indices += item->icount;
+}
+
+
+// ----------------------------------------------------------------------------
+// vertex_buffer_check_waste (internal use only)
+//
+// Compacts the buffer when it holds too much dead data
+//
+static void
+vertex_buffer_check_waste( vertex_buffer_t * self )
+{
+    if( self->dead_vertices > self->max_waste * self->vertices->size ||
+        self->dead_indices > self->max_waste * self->indices->size )
+    {
+        vertex_buffer_compact( self );
+    }
+}
+
+
+// ----------------------------------------------------------------------------
+void
+vertex_buffer_defer_erase( vertex_buffer_t * self, float max_waste )
+{
+    assert( self );
+    assert( max_waste >= 0 && max_waste <= 1 );
+
+    self->max_waste = max_waste;
+    if( max_waste == 0 )
+    {
+        vertex_buffer_compact( self );
+    }
+}
+
+
+// ----------------------------------------------------------------------------
+void
+vertex_buffer_compact( vertex_buffer_t * self )
+{
+    size_t vsize = self->vertices->size;
+    size_t isize = self->indices->size;
+    size_t stride = self->vertices->item_size;
+    char * vertices = (char *) self->vertices->items;
+    GLuint * indices = (GLuint *) self->indices->items;
+    size_t * vmap, * imap;
+    size_t i, j, n, live;
+
+    assert( self );
+
+    if( !self->dead_vertices && !self->dead_indices )
+    {
+        return;
+    }
+    vmap = (size_t *) calloc( vsize + 1, sizeof(size_t) );
+    imap = (size_t *) calloc( isize + 1, sizeof(size_t) );
+    if( !vmap || !imap )
+    {
+        free( vmap );
+        free( imap );
+        freetype_gl_error( Out_Of_Memory );
+        return;
+    }
+
+    // Mark what items use
+    for( i=0; i<vector_size( self->items ); ++i )
+    {
+        ivec4 * item = (ivec4 *) vector_get( self->items, i );
+        for( j=item->vstart; j<(size_t) (item->vstart+item->vcount); ++j )
+        {
+            vmap[j] = 1;
+        }
+        for( j=item->istart; j<(size_t) (item->istart+item->icount); ++j )
+        {
+            imap[j] = 1;
+        }
+    }
+
+    // Move what is used down, in order, the maps becoming new positions
+    for( i=0, n=0; i<vsize; ++i )
+    {
+        live = vmap[i];
+        vmap[i] = n;
+        if( live )
+        {
+            if( n != i )
+            {
+                memcpy( vertices + n*stride, vertices + i*stride, stride );
+            }
+            ++n;
+        }
+    }
+    vmap[vsize] = n;
+    self->vertices->size = n;
+    for( i=0, n=0; i<isize; ++i )
+    {
+        live = imap[i];
+        imap[i] = n;
+        if( live )
+        {
+            indices[n++] = vmap[indices[i]];
+        }
+    }
+    imap[isize] = n;
+    self->indices->size = n;
+    for( i=0; i<vector_size( self->items ); ++i )
+    {
+        ivec4 * item = (ivec4 *) vector_get( self->items, i );
+        item->vstart = vmap[item->vstart];
+        item->istart = imap[item->istart];
+    }
+    free( vmap );
+    free( imap );
+
+    self->dead_vertices = 0;
+    self->dead_indices = 0;
+    vertex_buffer_invalidate_vertices( self, 0, self->vertices->size );
+    vertex_buffer_invalidate_indices( self, 0, self->indices->size );
+}
+
+
+// ----------------------------------------------------------------------------
+void
+vertex_buffer_short_indices( vertex_buffer_t * self, int enable )
+{
+    assert( self );
+
+    self->short_indices = enable;
+    if( enable && !self->narrowed_indices )
+    {
+        self->narrowed_indices = vector_new( sizeof(GLushort) );
+    }
+}
+
+
 // ----------------------------------------------------------------------------
 void
 vertex_buffer_erase( vertex_buffer_t * self,
@@ -622,11 +1466,19 @@ vertex_buffer_erase( vertex_buffer_t * self,
     ivec4 * item;
     int vstart;
     size_t vcount, istart, icount, i;
+    char state;
 
     assert( self );
     assert( index < vector_size( self->items ) );
 
     item = (ivec4 *) vector_get( self->items, index );
+    if( self->max_waste > 0 && ( item->icount || !item->vcount ) )
+    {
+        vertex_buffer_bury( self, item );
+        vector_erase( self->items, index );
+        vertex_buffer_check_waste( self );
+        return;
+    }
     vstart = item->vstart;
     vcount = item->vcount;
     istart = item->istart;
@@ -643,9 +1495,112 @@ vertex_buffer_erase( vertex_buffer_t * self,
         }
     }
 
+    state = self->state;
     self->state = FROZEN;
-    vertex_buffer_erase_indices( self, istart, istart+icount );
-    vertex_buffer_erase_vertices( self, vstart, vstart+vcount );
+    if( icount )
+    {
+        vertex_buffer_erase_indices( self, istart, istart+icount );
+    }
+    if( vcount )
+    {
+        vertex_buffer_erase_vertices( self, vstart, vstart+vcount );
+    }
     vector_erase( self->items, index );
-    self->state = DIRTY;
+    self->state = state | (self->state & DIRTY);
+}
+
+
+// ---------------------------------------------- vertex_buffer_erase_range ---
+void
+vertex_buffer_erase_range( vertex_buffer_t * self,
+                           const size_t first, const size_t last )
+{
+    size_t vstart = (size_t)-1, vend = 0, vcount = 0;
+    size_t istart = (size_t)-1, iend = 0, icount = 0;
+    size_t i;
+    char state;
+
+    assert( self );
+    assert( first <= last );
+    assert( last <= vector_size( self->items ) );
+
+    if( first == last )
+    {
+        return;
+    }
+    for( i=first; i<last; ++i )
+    {
+        ivec4 * item = (ivec4 *) vector_get( self->items, i );
+        size_t item_vend = item->vstart + item->vcount;
+        size_t item_iend = item->istart + item->icount;
+
+        if( (size_t) item->vstart < vstart ) vstart = item->vstart;
+        if( item_vend > vend )               vend   = item_vend;
+        if( (size_t) item->istart < istart ) istart = item->istart;
+        if( item_iend > iend )               iend   = item_iend;
+        vcount += item->vcount;
+        icount += item->icount;
+    }
+
+    // Deferred, unless some items cannot be made degenerate
+    if( self->max_waste > 0 )
+    {
+        for( i=first; i<last; ++i )
+        {
+            ivec4 * item = (ivec4 *) vector_get( self->items, i );
+            if( item->vcount && !item->icount )
+            {
+                break;
+            }
+        }
+        if( i == last )
+        {
+            for( i=last; i>first; --i )
+            {
+                vertex_buffer_bury( self,
+                                    (ivec4 *) vector_get( self->items, i-1 ) );
+            }
+            vector_erase_range( self->items, first, last );
+            vertex_buffer_check_waste( self );
+            return;
+        }
+    }
+
+    // Items whose data is interleaved with other items are erased one by one
+    if( ( vcount && vend - vstart != vcount ) ||
+        ( icount && iend - istart != icount ) )
+    {
+        for( i=last; i>first; --i )
+        {
+            vertex_buffer_erase( self, i-1 );
+        }
+        return;
+    }
+
+    // Update items
+    for( i=0; i<vector_size(self->items); ++i )
+    {
+        ivec4 * item = (ivec4 *) vector_get( self->items, i );
+        if( vcount && (size_t) item->vstart >= vend )
+        {
+            item->vstart -= vcount;
+        }
+        if( icount && (size_t) item->istart >= iend )
+        {
+            item->istart -= icount;
+        }
+    }
+
+    state = self->state;
+    self->state = FROZEN;
+    if( icount )
+    {
+        vertex_buffer_erase_indices( self, istart, iend );
+    }
+    if( vcount )
+    {
+        vertex_buffer_erase_vertices( self, vstart, vend );
+    }
+    vector_erase_range( self->items, first, last );
+    self->state = state | (self->state & DIRTY);
 }
@@ -13,6 +13,7 @@ extern "C" {
 #include "opengl.h"
 #include "vector.h"
 #include "vertex-attribute.h"
+#include "vec234.h"
 
 #ifdef __cplusplus
 namespace ftgl {
@@ -29,6 +30,82 @@ namespace ftgl {
  */
 
 
+/**
+ * Maximum number of dirty ranges kept for vertices and for indices. Past
+ * it, the two closest ranges are merged.
+ */
+#define VERTEX_BUFFER_MAX_RANGES 8
+
+
+/**
+ * A range of vertices or indices, from first to last (excluded).
+ */
+typedef struct vertex_buffer_range_t
+{
+    /** Index of the first element. */
+    size_t first;
+
+    /** Index after the last element. */
+    size_t last;
+} vertex_buffer_range_t;
+
+
+/**
+ * A transfer of data to GPU memory, as planned by vertex_buffer_upload.
+ */
+typedef struct vertex_buffer_transfer_t
+{
+    /** GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER. */
+    GLenum target;
+
+    /** If not zero, new GPU storage of that many bytes to allocate first. */
+    size_t allocate;
+
+    /** Offset of the data in the GPU buffer, in bytes. */
+    size_t offset;
+
+    /** Size of the data, in bytes. */
+    size_t size;
+
+    /** Data to copy. */
+    const void * data;
+} vertex_buffer_transfer_t;
+
+
+/**
+ * Items of a vertex buffer to be drawn together, see
+ * vertex_buffer_render_batch.
+ */
+typedef struct vertex_buffer_batch_t
+{
+    /** Items, as item index and base vertex */
+    vector_t * items;
+
+    /** Number of indices, or vertices, of each draw */
+    vector_t * counts;
+
+    /** First index, or vertex, of each draw */
+    vector_t * firsts;
+
+    /** Base vertex of each draw */
+    vector_t * base_vertices;
+
+    /** Byte offsets of the first indices, for glMultiDrawElements */
+    vector_t * offsets;
+
+#ifdef FREETYPE_GL_USE_MULTI_DRAW_INDIRECT
+    /** Indirect commands built on the CPU */
+    vector_t * commands;
+
+    /** GL identity of the indirect commands buffer */
+    GLuint commands_id;
+
+    /** Current size of the indirect commands buffer in GPU */
+    size_t GPU_csize;
+#endif
+} vertex_buffer_batch_t;
+
+
 /**
  * Generic vertex buffer.
  */
@@ -54,12 +131,46 @@ typedef struct vertex_buffer_t
     /** GL identity of the indices buffer. */
     GLuint indices_id;
 
-    /** Current size of the vertices buffer in GPU */
+    /** Current size of the vertices buffer in GPU, which may be larger
+     *  than the vertices */
     size_t GPU_vsize;
 
-    /** Current size of the indices buffer in GPU*/
+    /** Current size of the indices buffer in GPU, which may be larger than
+     *  the indices */
     size_t GPU_isize;
 
+    /** Type of the indices in GPU memory, GL_UNSIGNED_SHORT or
+     *  GL_UNSIGNED_INT */
+    GLenum GPU_itype;
+
+    /** Whether indices are uploaded as 16-bit while vertices allow it */
+    int short_indices;
+
+    /** Indices narrowed to 16-bit for upload */
+    vector_t * narrowed_indices;
+
+    /** Vertices modified since the last upload, sorted and disjoint */
+    vertex_buffer_range_t dirty_vertices[VERTEX_BUFFER_MAX_RANGES];
+
+    /** Number of dirty vertex ranges */
+    size_t dirty_vertices_count;
+
+    /** Indices modified since the last upload, sorted and disjoint */
+    vertex_buffer_range_t dirty_indices[VERTEX_BUFFER_MAX_RANGES];
+
+    /** Number of dirty index ranges */
+    size_t dirty_indices_count;
+
+    /** Fraction of dead vertices or indices past which the buffer is
+     *  compacted, 0 when erased items are removed immediately */
+    float max_waste;
+
+    /** Vertices of erased items, not yet compacted */
+    size_t dead_vertices;
+
+    /** Indices of erased items, made degenerate and not yet compacted */
+    size_t dead_indices;
+
     /** GL primitives to render. */
     GLenum mode;
 
@@ -153,6 +264,24 @@ typedef struct vertex_buffer_t
                          GLenum mode );
 
 
+#ifdef FREETYPE_GL_USE_INSTANCING
+/**
+ * Render a vertex buffer once per vertex of another one, whose attributes
+ * advance once per instance instead of once per vertex (attribute divisor
+ * of 1). Typically, self is a unit quad and instances holds one record per
+ * glyph.
+ *
+ * @param  self       a vertex buffer, the shape to be instanced
+ * @param  instances  a vertex buffer of instance records
+ * @param  mode       render mode
+ */
+  void
+  vertex_buffer_render_instanced ( vertex_buffer_t *self,
+                                   vertex_buffer_t *instances,
+                                   GLenum mode );
+#endif
+
+
 /**
  * Render a specified item from the vertex buffer.
  *
@@ -165,7 +294,83 @@ typedef struct vertex_buffer_t
 
 
 /**
- * Upload buffer to GPU memory.
+ * Creates an empty batch of items.
+ *
+ * @return  an empty batch or NULL on error.
+ */
+  vertex_buffer_batch_t *
+  vertex_buffer_batch_new( void );
+
+
+/**
+ * Deletes a batch and releases GPU memory.
+ *
+ * @param  batch  a batch
+ */
+  void
+  vertex_buffer_batch_delete( vertex_buffer_batch_t * batch );
+
+
+/**
+ * Remove all items from a batch.
+ *
+ * @param  batch  a batch
+ */
+  void
+  vertex_buffer_batch_clear( vertex_buffer_batch_t * batch );
+
+
+/**
+ * Add an item to a batch. Items are drawn in the order they are added.
+ *
+ * @param  batch        a batch
+ * @param  index        index of the item in the vertex buffer
+ * @param  base_vertex  offset added to the indices of the item, which must
+ *                      be 0 for indexed buffers unless multi draw is
+ *                      enabled (OpenGL 3.2)
+ */
+  void
+  vertex_buffer_batch_add( vertex_buffer_batch_t * batch,
+                           const size_t index, const int base_vertex );
+
+
+/**
+ * Build the draws of a batch, in counts, firsts and base_vertices.
+ * Consecutive items whose indices, or vertices when the buffer has no
+ * indices, follow each other with the same base vertex make a single draw.
+ *
+ * @param  batch  a batch
+ * @param  self   the vertex buffer the items belong to
+ * @return        the number of draws
+ */
+  size_t
+  vertex_buffer_batch_build( vertex_buffer_batch_t * batch,
+                             const vertex_buffer_t * self );
+
+
+/**
+ * Render the items of a batch with a single draw call: indirect commands
+ * when built with FREETYPE_GL_USE_MULTI_DRAW_INDIRECT (OpenGL 4.3),
+ * glMultiDrawElementsBaseVertex when built with
+ * FREETYPE_GL_USE_MULTI_DRAW (OpenGL 3.2), and one call per draw
+ * otherwise.
+ *
+ * @param  self   a vertex buffer
+ * @param  batch  items of the vertex buffer
+ * @param  mode   render mode
+ */
+  void
+  vertex_buffer_render_batch( vertex_buffer_t *self,
+                              vertex_buffer_batch_t *batch,
+                              GLenum mode );
+
+
+/**
+ * Upload buffer to GPU memory. Only the vertices and indices modified since
+ * the last upload are sent, unless GPU storage has to grow, in which case
+ * it is allocated to the capacity of the vectors and filled again. A buffer
+ * whose state is set to dirty by hand, with nothing invalidated, is sent
+ * whole.
  *
  * @param  self  a vertex buffer
  */
@@ -173,6 +378,48 @@ typedef struct vertex_buffer_t
   vertex_buffer_upload( vertex_buffer_t *self );
 
 
+/**
+ * Upload buffer through another backend than OpenGL, which receives the
+ * transfers vertex_buffer_upload would make, vertices first. GPU sizes and
+ * dirty ranges are updated as if they were made. The buffer must not be
+ * modified by the backend.
+ *
+ * @param  self      a vertex buffer
+ * @param  transfer  function called for each transfer
+ * @param  data      user data, passed to transfer
+ */
+  void
+  vertex_buffer_upload_with( vertex_buffer_t *self,
+                             void (*transfer)( vertex_buffer_t *self,
+                                      const vertex_buffer_transfer_t *transfer,
+                                      void *data ),
+                             void *data );
+
+
+/**
+ * Mark vertices as modified, for callers that write them directly.
+ *
+ * @param  self   a vertex buffer
+ * @param  first  index of the first modified vertex
+ * @param  last   index after the last modified vertex
+ */
+  void
+  vertex_buffer_invalidate_vertices( vertex_buffer_t *self,
+                                     const size_t first, const size_t last );
+
+
+/**
+ * Mark indices as modified, for callers that write them directly.
+ *
+ * @param  self   a vertex buffer
+ * @param  first  index of the first modified index
+ * @param  last   index after the last modified index
+ */
+  void
+  vertex_buffer_invalidate_indices( vertex_buffer_t *self,
+                                    const size_t first, const size_t last );
+
+
 /**
  * Clear all items.
  *
@@ -276,6 +523,42 @@ typedef struct vertex_buffer_t
                                  const size_t last );
 
 
+/**
+ * Append a new item made of vertices and indices already written at the
+ * end of the vertices and indices vectors, for callers that fill their
+ * storage directly. Indices must be relative to the whole buffer. They are
+ * marked as modified.
+ *
+ * @param  self   a vertex buffer
+ * @param  vstart index of the first vertex of the item
+ * @param  vcount number of vertices
+ * @param  istart index of the first index of the item
+ * @param  icount number of indices
+ *
+ * @return index of the new item
+ */
+  size_t
+  vertex_buffer_push_back_item( vertex_buffer_t * self,
+                                const size_t vstart, const size_t vcount,
+                                const size_t istart, const size_t icount );
+
+
+/**
+ * Insert new items made of vertices and indices already written in the
+ * vertices and indices vectors, for callers that fill their storage
+ * directly. Indices must be relative to the whole buffer. They are marked
+ * as modified.
+ *
+ * @param  self   a vertex buffer
+ * @param  index  index of the first new item
+ * @param  items  items, as vstart, vcount, istart, icount
+ * @param  count  number of items
+ */
+  void
+  vertex_buffer_insert_items( vertex_buffer_t * self, const size_t index,
+                              const ivec4 * items, const size_t count );
+
+
 /**
  * Append a new item to the collection.
  *
@@ -317,6 +600,61 @@ typedef struct vertex_buffer_t
   vertex_buffer_erase( vertex_buffer_t * self,
                        const size_t index );
 
+
+/**
+ * Defer the removal of the data of erased items. Their indices are made
+ * degenerate, so that they draw nothing, and their vertices are left in
+ * place; erasing an item no longer moves the data of the others. The
+ * buffer is compacted, keeping the order of vertices and indices, once
+ * the fraction of dead vertices or indices exceeds max_waste.
+ *
+ * Items must only use their own vertices and be drawn as triangles or
+ * lines. Items with vertices but no indices are still erased immediately.
+ *
+ * @param  self       a vertex buffer
+ * @param  max_waste  fraction of dead data allowed, between 0 and 1, or 0
+ *                    to erase items immediately
+ */
+  void
+  vertex_buffer_defer_erase( vertex_buffer_t * self, float max_waste );
+
+
+/**
+ * Remove the data of erased items now, see vertex_buffer_defer_erase.
+ *
+ * @param  self  a vertex buffer
+ */
+  void
+  vertex_buffer_compact( vertex_buffer_t * self );
+
+
+/**
+ * Upload indices as GL_UNSIGNED_SHORT, halving their GPU memory and upload
+ * bandwidth, while the buffer has at most 65536 vertices. Indices are
+ * still edited as GLuint. A buffer growing past that limit is uploaded
+ * again with GL_UNSIGNED_INT indices, and back with GL_UNSIGNED_SHORT ones
+ * once it shrinks to half of it.
+ *
+ * @param  self    a vertex buffer
+ * @param  enable  whether to use 16-bit indices
+ */
+  void
+  vertex_buffer_short_indices( vertex_buffer_t * self, int enable );
+
+
+/**
+ * Erase a range of items in a single pass when their vertices and indices
+ * are contiguous, as when they were pushed back one after the other, and
+ * item by item otherwise.
+ *
+ * @param  self   a vertex buffer
+ * @param  first  index of the first item to be erased
+ * @param  last   index after the last item to be erased
+ */
+  void
+  vertex_buffer_erase_range( vertex_buffer_t * self,
+                             const size_t first, const size_t last );
+
 /** @} */
 
 #ifdef __cplusplus
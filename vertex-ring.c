@@ -0,0 +1,586 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include "vertex-ring.h"
+#include "ftgl-utils.h"
+
+
+// ----------------------------------------------------------------------------
+// vertex_ring_span_reset (internal use only)
+//
+static void
+vertex_ring_span_reset( vertex_ring_span_t * span )
+{
+    span->head = 0;
+    span->tail = 0;
+    span->used = 0;
+    span->end = span->capacity;
+}
+
+
+// ----------------------------------------------------------------------------
+// vertex_ring_span_place (internal use only)
+//
+// Where count elements would be written, or (size_t)-1 if they do not fit
+// without expiring items
+//
+static size_t
+vertex_ring_span_place( const vertex_ring_span_t * span, size_t count )
+{
+    if( count == 0 )
+    {
+        return span->head;
+    }
+    if( span->used == 0 )
+    {
+        return 0;
+    }
+    if( span->head > span->tail )
+    {
+        if( span->head + count <= span->capacity )
+        {
+            return span->head;
+        }
+        if( count <= span->tail )
+        {
+            return 0;
+        }
+        return (size_t) -1;
+    }
+    if( span->head + count <= span->tail )
+    {
+        return span->head;
+    }
+    return (size_t) -1;
+}
+
+
+// ----------------------------------------------------------------------------
+// vertex_ring_span_advance (internal use only)
+//
+// Accounts for count elements written at start
+//
+static void
+vertex_ring_span_advance( vertex_ring_span_t * span,
+                          size_t start, size_t count )
+{
+    if( count == 0 )
+    {
+        return;
+    }
+    if( span->used == 0 )
+    {
+        span->tail = start;
+        span->used = count;
+    }
+    else if( start < span->head )
+    {
+        // What is left at the end of the ring stays unused until the tail
+        // wraps too
+        span->end = span->head;
+        span->used += span->capacity - span->head + count;
+    }
+    else
+    {
+        span->used += count;
+    }
+    span->head = start + count;
+}
+
+
+// ----------------------------------------------------------------------------
+// vertex_ring_span_release (internal use only)
+//
+// Moves the tail to next, the start of the oldest remaining data
+//
+static void
+vertex_ring_span_release( vertex_ring_span_t * span, size_t next )
+{
+    span->used -= ( next + span->capacity - span->tail ) % span->capacity;
+    if( next < span->tail )
+    {
+        span->end = span->capacity;
+    }
+    span->tail = next;
+}
+
+
+// ----------------------------------------------------------------------------
+vertex_ring_t *
+vertex_ring_new( const char *format,
+                 const size_t vcapacity, const size_t icapacity )
+{
+    vertex_ring_t *self = (vertex_ring_t *) malloc( sizeof(vertex_ring_t) );
+    if( !self )
+    {
+        freetype_gl_error( Out_Of_Memory );
+        return NULL;
+    }
+
+    self->buffer = vertex_buffer_new( format );
+    if( !self->buffer )
+    {
+        free( self );
+        return NULL;
+    }
+    vector_resize( self->buffer->vertices, vcapacity );
+    vector_resize( self->buffer->indices, icapacity );
+
+    self->vertices.capacity = vcapacity;
+    self->indices.capacity = icapacity;
+    vertex_ring_span_reset( &self->vertices );
+    vertex_ring_span_reset( &self->indices );
+
+    self->items = NULL;
+    self->items_capacity = 0;
+    self->items_first = 0;
+    self->items_count = 0;
+
+#ifdef FREETYPE_GL_USE_PERSISTENT_MAPPING
+    self->mapped_vertices = NULL;
+    self->mapped_indices = NULL;
+    self->fence_count = 0;
+    self->mapping_tried = 0;
+#endif
+    return self;
+}
+
+
+// ----------------------------------------------------------------------------
+void
+vertex_ring_delete( vertex_ring_t * self )
+{
+#ifdef FREETYPE_GL_USE_PERSISTENT_MAPPING
+    size_t i;
+#endif
+
+    assert( self );
+
+#ifdef FREETYPE_GL_USE_PERSISTENT_MAPPING
+    for( i=0; i<self->fence_count; ++i )
+    {
+        glDeleteSync( self->fences[i] );
+    }
+#endif
+    // Deleting GL buffers unmaps them
+    vertex_buffer_delete( self->buffer );
+    free( self->items );
+    free( self );
+}
+
+
+// ----------------------------------------------------------------------------
+size_t
+vertex_ring_size( const vertex_ring_t *self )
+{
+    assert( self );
+
+    return self->items_count;
+}
+
+
+// ----------------------------------------------------------------------------
+const ivec4 *
+vertex_ring_get( const vertex_ring_t *self, const size_t index )
+{
+    assert( self );
+    assert( index < self->items_count );
+
+    return &self->items[( self->items_first + index ) %
+                        self->items_capacity];
+}
+
+
+// ----------------------------------------------------------------------------
+// vertex_ring_grow_items (internal use only)
+//
+static int
+vertex_ring_grow_items( vertex_ring_t * self )
+{
+    size_t capacity = self->items_capacity ? 2 * self->items_capacity : 64;
+    ivec4 * items = (ivec4 *) malloc( capacity * sizeof(ivec4) );
+    size_t i;
+
+    if( !items )
+    {
+        freetype_gl_error( Out_Of_Memory );
+        return 0;
+    }
+    for( i=0; i<self->items_count; ++i )
+    {
+        items[i] = *vertex_ring_get( self, i );
+    }
+    free( self->items );
+    self->items = items;
+    self->items_capacity = capacity;
+    self->items_first = 0;
+    return 1;
+}
+
+
+// ----------------------------------------------------------------------------
+int
+vertex_ring_push_back( vertex_ring_t * self,
+                       const void * vertices, const size_t vcount,
+                       const GLuint * indices, const size_t icount )
+{
+    vertex_buffer_t * buffer;
+    size_t vstart, istart, i;
+    GLuint * dst;
+    ivec4 * item;
+
+    assert( self );
+    assert( vertices || !vcount );
+    assert( indices || !icount );
+
+    buffer = self->buffer;
+    if( vcount > self->vertices.capacity || icount > self->indices.capacity )
+    {
+        return 0;
+    }
+    if( self->items_count == self->items_capacity &&
+        !vertex_ring_grow_items( self ) )
+    {
+        return 0;
+    }
+
+    // An empty ring takes any item that is not larger than it
+    for( ;; )
+    {
+        vstart = vertex_ring_span_place( &self->vertices, vcount );
+        istart = vertex_ring_span_place( &self->indices, icount );
+        if( vstart != (size_t) -1 && istart != (size_t) -1 )
+        {
+            break;
+        }
+        vertex_ring_expire( self, 1 );
+    }
+
+    if( vcount )
+    {
+        memcpy( (char *) buffer->vertices->items +
+                vstart * buffer->vertices->item_size,
+                vertices, vcount * buffer->vertices->item_size );
+        vertex_buffer_invalidate_vertices( buffer, vstart, vstart + vcount );
+    }
+    dst = (GLuint *) buffer->indices->items + istart;
+    for( i=0; i<icount; ++i )
+    {
+        dst[i] = indices[i] + vstart;
+    }
+    vertex_buffer_invalidate_indices( buffer, istart, istart + icount );
+    vertex_ring_span_advance( &self->vertices, vstart, vcount );
+    vertex_ring_span_advance( &self->indices, istart, icount );
+
+    item = &self->items[( self->items_first + self->items_count ) %
+                        self->items_capacity];
+    item->vstart = vstart;
+    item->vcount = vcount;
+    item->istart = istart;
+    item->icount = icount;
+    self->items_count++;
+    return 1;
+}
+
+
+// ----------------------------------------------------------------------------
+void
+vertex_ring_expire( vertex_ring_t * self, const size_t count )
+{
+    size_t i, j;
+
+    assert( self );
+    assert( count <= self->items_count );
+
+    for( i=0; i<count; ++i )
+    {
+        ivec4 item = *vertex_ring_get( self, 0 );
+        int vdone = !item.vcount, idone = !item.icount;
+
+        self->items_first = ( self->items_first + 1 ) % self->items_capacity;
+        self->items_count--;
+
+        // Tails move to the oldest remaining data, if any
+        for( j=0; j<self->items_count && !( vdone && idone ); ++j )
+        {
+            const ivec4 * next = vertex_ring_get( self, j );
+            if( !vdone && next->vcount )
+            {
+                vertex_ring_span_release( &self->vertices, next->vstart );
+                vdone = 1;
+            }
+            if( !idone && next->icount )
+            {
+                vertex_ring_span_release( &self->indices, next->istart );
+                idone = 1;
+            }
+        }
+        if( !vdone )
+        {
+            vertex_ring_span_reset( &self->vertices );
+        }
+        if( !idone )
+        {
+            vertex_ring_span_reset( &self->indices );
+        }
+    }
+    if( self->items_count == 0 )
+    {
+        self->items_first = 0;
+    }
+}
+
+
+// ----------------------------------------------------------------------------
+void
+vertex_ring_clear( vertex_ring_t * self )
+{
+    assert( self );
+
+    self->items_first = 0;
+    self->items_count = 0;
+    vertex_ring_span_reset( &self->vertices );
+    vertex_ring_span_reset( &self->indices );
+}
+
+
+#ifdef FREETYPE_GL_USE_PERSISTENT_MAPPING
+// ----------------------------------------------------------------------------
+// vertex_ring_map (internal use only)
+//
+// Replaces GPU storage with persistently mapped storage, holding the whole
+// ring, or leaves it to vertex_buffer_upload if this is not supported
+//
+static void
+vertex_ring_map( vertex_ring_t * self )
+{
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                             GL_MAP_COHERENT_BIT;
+    vertex_buffer_t * buffer = self->buffer;
+    size_t vsize = buffer->vertices->size * buffer->vertices->item_size;
+    size_t isize = buffer->indices->size * buffer->indices->item_size;
+
+    self->mapping_tried = 1;
+    while( glGetError( ) != GL_NO_ERROR );
+
+    if( buffer->vertices_id )
+    {
+        glDeleteBuffers( 1, &buffer->vertices_id );
+    }
+    if( buffer->indices_id )
+    {
+        glDeleteBuffers( 1, &buffer->indices_id );
+    }
+    glGenBuffers( 1, &buffer->vertices_id );
+    glGenBuffers( 1, &buffer->indices_id );
+
+    glBindBuffer( GL_ARRAY_BUFFER, buffer->vertices_id );
+    glBufferStorage( GL_ARRAY_BUFFER, vsize, buffer->vertices->items, flags );
+    self->mapped_vertices = glMapBufferRange( GL_ARRAY_BUFFER, 0, vsize,
+                                              flags );
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, buffer->indices_id );
+    glBufferStorage( GL_ELEMENT_ARRAY_BUFFER, isize, buffer->indices->items,
+                     flags );
+    self->mapped_indices = glMapBufferRange( GL_ELEMENT_ARRAY_BUFFER, 0,
+                                             isize, flags );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+
+    if( glGetError( ) != GL_NO_ERROR ||
+        !self->mapped_vertices || !self->mapped_indices )
+    {
+        // Back to storage vertex_buffer_upload can reallocate
+        glDeleteBuffers( 1, &buffer->vertices_id );
+        glDeleteBuffers( 1, &buffer->indices_id );
+        buffer->vertices_id = 0;
+        buffer->indices_id = 0;
+        buffer->GPU_vsize = 0;
+        buffer->GPU_isize = 0;
+        self->mapped_vertices = NULL;
+        self->mapped_indices = NULL;
+        return;
+    }
+    buffer->GPU_vsize = vsize;
+    buffer->GPU_isize = isize;
+    buffer->dirty_vertices_count = 0;
+    buffer->dirty_indices_count = 0;
+#ifdef FREETYPE_GL_USE_VAO
+    // The VAO refers to the deleted buffers
+    if( buffer->VAO_id )
+    {
+        glDeleteVertexArrays( 1, &buffer->VAO_id );
+        buffer->VAO_id = 0;
+    }
+#endif
+}
+
+
+// ----------------------------------------------------------------------------
+// vertex_ring_release_fences (internal use only)
+//
+// Waits for the count oldest fenced draws to complete and forgets them
+//
+static void
+vertex_ring_release_fences( vertex_ring_t * self, size_t count )
+{
+    size_t i;
+
+    // Draws complete in order, waiting for the last one is enough
+    if( count )
+    {
+        while( glClientWaitSync( self->fences[count-1],
+                                 GL_SYNC_FLUSH_COMMANDS_BIT,
+                                 1000000000 ) == GL_TIMEOUT_EXPIRED );
+    }
+    for( i=0; i<count; ++i )
+    {
+        glDeleteSync( self->fences[i] );
+    }
+    self->fence_count -= count;
+    memmove( self->fences, self->fences + count,
+             self->fence_count * sizeof(GLsync) );
+    memmove( self->fence_ranges, self->fence_ranges + count,
+             self->fence_count * sizeof(ivec4) );
+}
+
+
+// ----------------------------------------------------------------------------
+// vertex_ring_overlaps (internal use only)
+//
+// Whether count elements from start, wrapping around the end of the ring,
+// overlap n elements from first
+//
+static int
+vertex_ring_overlaps( size_t start, size_t count,
+                      size_t first, size_t n, size_t capacity )
+{
+    return count && n &&
+           ( ( first + capacity - start ) % capacity < count ||
+             ( start + capacity - first ) % capacity < n );
+}
+
+
+// ----------------------------------------------------------------------------
+// vertex_ring_write_mapped (internal use only)
+//
+// Backend of vertex_buffer_upload_with writing to mapped storage, once the
+// draws reading there complete
+//
+static void
+vertex_ring_write_mapped( vertex_buffer_t * buffer,
+                          const vertex_buffer_transfer_t * transfer,
+                          void * data )
+{
+    vertex_ring_t * self = (vertex_ring_t *) data;
+    int vertices = transfer->target == GL_ARRAY_BUFFER;
+    char * mapped = (char *) ( vertices ? self->mapped_vertices
+                                        : self->mapped_indices );
+    size_t size = vertices ? buffer->vertices->item_size
+                           : buffer->indices->item_size;
+    size_t first = transfer->offset / size;
+    size_t n = ( transfer->offset + transfer->size + size - 1 ) / size - first;
+    size_t i;
+
+    for( i=self->fence_count; i>0; --i )
+    {
+        const ivec4 * range = &self->fence_ranges[i-1];
+        if( vertices ? vertex_ring_overlaps( range->vstart, range->vcount,
+                                             first, n,
+                                             self->vertices.capacity )
+                     : vertex_ring_overlaps( range->istart, range->icount,
+                                             first, n,
+                                             self->indices.capacity ) )
+        {
+            break;
+        }
+    }
+    vertex_ring_release_fences( self, i );
+    memcpy( mapped + transfer->offset, transfer->data, transfer->size );
+}
+#endif
+
+
+// ----------------------------------------------------------------------------
+void
+vertex_ring_render( vertex_ring_t * self, GLenum mode )
+{
+    const vertex_ring_span_t * span;
+#ifdef FREETYPE_GL_USE_PERSISTENT_MAPPING
+    size_t i;
+#endif
+
+    assert( self );
+
+    span = &self->indices;
+#ifdef FREETYPE_GL_USE_PERSISTENT_MAPPING
+#ifdef FREETYPE_GL_USE_VAO
+    glBindVertexArray( 0 );
+#endif
+    if( !self->mapping_tried )
+    {
+        vertex_ring_map( self );
+    }
+    if( self->mapped_vertices )
+    {
+        // Completed draws are forgotten without waiting, new data then
+        // waits for the ones still reading where it goes
+        for( i=0; i<self->fence_count; ++i )
+        {
+            if( glClientWaitSync( self->fences[i], 0, 0 ) ==
+                GL_TIMEOUT_EXPIRED )
+            {
+                break;
+            }
+        }
+        vertex_ring_release_fences( self, i );
+        vertex_buffer_upload_with( self->buffer, vertex_ring_write_mapped,
+                                   self );
+    }
+#endif
+
+    // Only what was written since the last render is uploaded
+    vertex_buffer_render_setup( self->buffer, mode );
+    if( span->used && span->head > span->tail )
+    {
+        glDrawElements( mode, span->head - span->tail, GL_UNSIGNED_INT,
+                        (const GLvoid *) ( span->tail * sizeof(GLuint) ) );
+    }
+    else if( span->used )
+    {
+        if( span->end > span->tail )
+        {
+            glDrawElements( mode, span->end - span->tail, GL_UNSIGNED_INT,
+                            (const GLvoid *) ( span->tail * sizeof(GLuint) ) );
+        }
+        if( span->head )
+        {
+            glDrawElements( mode, span->head, GL_UNSIGNED_INT, 0 );
+        }
+    }
+    vertex_buffer_render_finish( self->buffer );
+
+#ifdef FREETYPE_GL_USE_PERSISTENT_MAPPING
+    if( self->mapped_vertices && self->items_count )
+    {
+        ivec4 * range;
+
+        if( self->fence_count == VERTEX_RING_FENCES )
+        {
+            vertex_ring_release_fences( self, 1 );
+        }
+        range = &self->fence_ranges[self->fence_count];
+        range->vstart = self->vertices.tail;
+        range->vcount = self->vertices.used;
+        range->istart = self->indices.tail;
+        range->icount = self->indices.used;
+        self->fences[self->fence_count++] =
+            glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+    }
+#endif
+}
@@ -0,0 +1,237 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#ifndef __VERTEX_RING_H__
+#define __VERTEX_RING_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "opengl.h"
+#include "vertex-buffer.h"
+#include "vec234.h"
+
+#ifdef __cplusplus
+namespace ftgl {
+#endif
+
+/**
+ * @file   vertex-ring.h
+ *
+ * @defgroup vertex-ring Vertex ring
+ *
+ * A vertex buffer of fixed capacity for text that is appended and expires,
+ * as in logs, consoles or chats. Items are written at the head of the ring
+ * and expire from its tail, oldest first. Their data never moves and
+ * indices point into the ring, so neither appending nor expiring rewrites
+ * anything, and only newly written data is uploaded.
+ *
+ * An item that does not fit before the end of the ring is written at its
+ * start. Live items are drawn with at most two draw calls.
+ *
+ * Example Usage:
+ * @code
+ * #include "vertex-ring.h"
+ *
+ * int main( int arrgc, char *argv[] )
+ * {
+ *     vertex_ring_t * ring = vertex_ring_new( "vertex:3f", 4096, 6144 );
+ *
+ *     // Oldest items expire to make room for new ones
+ *     vertex_ring_push_back( ring, vertices, 4, indices, 6 );
+ *     vertex_ring_render( ring, GL_TRIANGLES );
+ *
+ *     return 0;
+ * }
+ * @endcode
+ *
+ * @{
+ */
+
+
+/**
+ * Number of draws that may be pending on the GPU with persistent mapping.
+ */
+#define VERTEX_RING_FENCES 4
+
+
+/**
+ * Occupancy of the vertices or the indices of a ring.
+ */
+typedef struct vertex_ring_span_t
+{
+    /** Number of vertices or indices the ring holds. */
+    size_t capacity;
+
+    /** Where the next item is written. */
+    size_t head;
+
+    /** Where the oldest item starts. */
+    size_t tail;
+
+    /** Used from tail to head, including what is left unused at the end
+     *  of the ring when wrapping. */
+    size_t used;
+
+    /** End of the data written before wrapping, when head is before tail. */
+    size_t end;
+} vertex_ring_span_t;
+
+
+/**
+ * Ring of vertices and indices.
+ */
+typedef struct vertex_ring_t
+{
+    /** Storage, vertices and indices vectors have the size of the ring */
+    vertex_buffer_t * buffer;
+
+    /** Occupancy of vertices */
+    vertex_ring_span_t vertices;
+
+    /** Occupancy of indices */
+    vertex_ring_span_t indices;
+
+    /** Live items, oldest first from items_first, as a circular array */
+    ivec4 * items;
+
+    /** Capacity of the items array */
+    size_t items_capacity;
+
+    /** Index of the oldest item in the items array */
+    size_t items_first;
+
+    /** Number of live items */
+    size_t items_count;
+
+#ifdef FREETYPE_GL_USE_PERSISTENT_MAPPING
+    /** Persistently mapped GPU vertices, if mapping is available */
+    void * mapped_vertices;
+
+    /** Persistently mapped GPU indices, if mapping is available */
+    void * mapped_indices;
+
+    /** Fences of the draws that may still be reading the ring, oldest
+     *  first. New data is only written once the draws reading where it
+     *  goes complete. */
+    GLsync fences[VERTEX_RING_FENCES];
+
+    /** Live vertices and indices each fenced draw reads, as vstart,
+     *  vcount, istart, icount in the ring (wrapping around its end) */
+    ivec4 fence_ranges[VERTEX_RING_FENCES];
+
+    /** Number of fences */
+    size_t fence_count;
+
+    /** Whether mapping was tried */
+    int mapping_tried;
+#endif
+} vertex_ring_t;
+
+
+/**
+ * Creates an empty vertex ring.
+ *
+ * @param  format     a string describing vertex format.
+ * @param  vcapacity  number of vertices the ring holds
+ * @param  icapacity  number of indices the ring holds
+ * @return            an empty vertex ring or NULL on error.
+ */
+  vertex_ring_t *
+  vertex_ring_new( const char *format,
+                   const size_t vcapacity, const size_t icapacity );
+
+
+/**
+ * Deletes vertex ring and releases GPU memory.
+ *
+ * @param  self  a vertex ring
+ */
+  void
+  vertex_ring_delete( vertex_ring_t * self );
+
+
+/**
+ * Returns the number of live items in the vertex ring
+ *
+ * @param  self  a vertex ring
+ * @return       number of items
+ */
+  size_t
+  vertex_ring_size( const vertex_ring_t *self );
+
+
+/**
+ * Returns a live item, 0 being the oldest.
+ *
+ * @param  self   a vertex ring
+ * @param  index  index of the item
+ * @return        the item, as vstart, vcount, istart, icount in the ring
+ */
+  const ivec4 *
+  vertex_ring_get( const vertex_ring_t *self, const size_t index );
+
+
+/**
+ * Append a new item at the head of the ring. The oldest items expire as
+ * needed to make room for it.
+ *
+ * @param  self      a vertex ring
+ * @param  vertices  raw vertices data
+ * @param  vcount    number of vertices
+ * @param  indices   raw indices data, relative to the item vertices
+ * @param  icount    number of indices
+ * @return           1 if the item was added, 0 if it cannot fit in the
+ *                   ring
+ */
+  int
+  vertex_ring_push_back( vertex_ring_t * self,
+                         const void * vertices, const size_t vcount,
+                         const GLuint * indices, const size_t icount );
+
+
+/**
+ * Expire the oldest items.
+ *
+ * @param  self   a vertex ring
+ * @param  count  number of items to expire, at most the number of items
+ */
+  void
+  vertex_ring_expire( vertex_ring_t * self, const size_t count );
+
+
+/**
+ * Expire all items.
+ *
+ * @param  self  a vertex ring
+ */
+  void
+  vertex_ring_clear( vertex_ring_t * self );
+
+
+/**
+ * Render live items, uploading what was written since the last render.
+ *
+ * When built with FREETYPE_GL_USE_PERSISTENT_MAPPING and the context
+ * supports buffer storage (OpenGL 4.4), new data is copied to persistently
+ * mapped GPU memory. Up to VERTEX_RING_FENCES renders are fenced with the
+ * ranges they read, and writing waits only for the renders still reading
+ * the expired data it overwrites.
+ *
+ * @param  self  a vertex ring
+ * @param  mode  render mode
+ */
+  void
+  vertex_ring_render( vertex_ring_t * self, GLenum mode );
+
+/** @} */
+
+#ifdef __cplusplus
+}
+}
+#endif
+
+#endif /* __VERTEX_RING_H__ */